@@ -0,0 +1,374 @@
+#include "batched.h"
+#include "gemv.h"
+#include "matrix.h"
+#include "mixed-precision.h"
+#include "test-helpers.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+// Benchmarks of the basic matrix operations on square n x n matrices.
+//
+// Every benchmark reports GB per second, counting each element read or
+// written once (what the operation has to move at minimum), and products
+// also report GFLOP per second for 2 n^3 operations. Build in Release and
+// run e.g.
+//
+//   ./bench --benchmark_filter='multiply<double>'
+//
+// Products stop at 2048 (512 for the non-arithmetic test element type, which
+// takes the unpacked kernel); at 8192 a single int product is minutes long.
+//
+// small_multiply and batched_multiply compare multiplying 4096 N x N
+// matrices one static_matrix at a time against one batched_matrix product;
+// the batch is small enough to stay in L2, so the kernels are what is timed.
+//
+// col_major_iteration and col_major_multiply repeat col_iteration and
+// multiply on column-major matrices, where columns are the contiguous lines.
+//
+// wide_multiply<T, Acc> times multiply<Acc> (see mixed-precision.h) and
+// compensated_multiply times Kahan-summed float products; GB counts elements
+// of T read and of Acc written.
+
+namespace {
+
+template <class T>
+matrix<T> make_matrix(size_t n) {
+  matrix<T> m(n, n);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      m(i, j) = static_cast<T>((i * 7 + j * 3) % 11);
+    }
+  }
+  return m;
+}
+
+template <class T>
+void report(benchmark::State& state, double elements_moved, double flops = 0) {
+  state.counters["GB"] =
+      benchmark::Counter(elements_moved * sizeof(T) * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+  if (flops != 0) {
+    state.counters["GFLOP"] = benchmark::Counter(flops * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+  }
+}
+
+template <class T>
+void elementwise_sizes(benchmark::internal::Benchmark* b) {
+  b->RangeMultiplier(8)->Range(8, 8192);
+}
+
+template <class T>
+void product_sizes(benchmark::internal::Benchmark* b) {
+  b->RangeMultiplier(4)->Range(8, std::is_arithmetic_v<T> ? 2048 : 512);
+}
+
+template <class T>
+void construct(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  for (auto _ : state) {
+    matrix<T> m(n, n);
+    benchmark::DoNotOptimize(m.data());
+  }
+  report<T>(state, double(n) * n);
+}
+
+template <class T>
+void copy(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  for (auto _ : state) {
+    matrix<T> m(a);
+    benchmark::DoNotOptimize(m.data());
+  }
+  report<T>(state, 2.0 * n * n);
+}
+
+template <class T>
+void assign(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> m(n, n);
+  for (auto _ : state) {
+    m = a;
+    benchmark::ClobberMemory();
+  }
+  report<T>(state, 2.0 * n * n);
+}
+
+template <class T>
+void compare(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> b = a;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a == b);
+  }
+  report<T>(state, 2.0 * n * n);
+}
+
+template <class T>
+void add(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> b = make_matrix<T>(n);
+  for (auto _ : state) {
+    matrix<T> c = a + b;
+    benchmark::DoNotOptimize(c.data());
+  }
+  report<T>(state, 3.0 * n * n);
+}
+
+template <class T>
+void sub_assign(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> b = make_matrix<T>(n);
+  for (auto _ : state) {
+    a -= b;
+    benchmark::ClobberMemory();
+  }
+  report<T>(state, 3.0 * n * n);
+}
+
+template <class T>
+void scale(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  for (auto _ : state) {
+    a *= T(1);
+    benchmark::ClobberMemory();
+  }
+  report<T>(state, 2.0 * n * n);
+}
+
+template <class T>
+void multiply(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> b = make_matrix<T>(n);
+  for (auto _ : state) {
+    matrix<T> c = a * b;
+    benchmark::DoNotOptimize(c.data());
+  }
+  report<T>(state, 3.0 * n * n, 2.0 * n * n * n);
+}
+
+template <class T>
+void addmul(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> b = make_matrix<T>(n);
+  matrix<T> c(n, n);
+  for (auto _ : state) {
+    addmul(c, a, b);
+    benchmark::DoNotOptimize(c.data());
+  }
+  report<T>(state, 4.0 * n * n, 2.0 * n * n * n);
+}
+
+template <class T>
+void row_iteration(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  const matrix<T> a = make_matrix<T>(n);
+  for (auto _ : state) {
+    T sum = T();
+    for (size_t i = 0; i < n; ++i) {
+      for (auto it = a.row_begin(i); it != a.row_end(i); ++it) {
+        sum += *it;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  report<T>(state, double(n) * n);
+}
+
+template <class T>
+void col_iteration(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  const matrix<T> a = make_matrix<T>(n);
+  for (auto _ : state) {
+    T sum = T();
+    for (size_t j = 0; j < n; ++j) {
+      for (auto it = a.col_begin(j); it != a.col_end(j); ++it) {
+        sum += *it;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  report<T>(state, double(n) * n);
+}
+
+template <class T>
+void col_major_iteration(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  const col_major_matrix<T> a = make_matrix<T>(n);
+  for (auto _ : state) {
+    T sum = T();
+    for (size_t j = 0; j < n; ++j) {
+      for (auto it = a.col_begin(j); it != a.col_end(j); ++it) {
+        sum += *it;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  report<T>(state, double(n) * n);
+}
+
+template <class T>
+void col_major_multiply(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  col_major_matrix<T> a = make_matrix<T>(n);
+  col_major_matrix<T> b = make_matrix<T>(n);
+  for (auto _ : state) {
+    col_major_matrix<T> c = a * b;
+    benchmark::DoNotOptimize(c.data());
+  }
+  report<T>(state, 3.0 * n * n, 2.0 * n * n * n);
+}
+
+template <class T>
+void gemv(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  std::unique_ptr<T[]> x(new T[n]());
+  std::unique_ptr<T[]> y(new T[n]);
+  for (auto _ : state) {
+    multiply(a, std::span<const T>(x.get(), n), std::span<T>(y.get(), n));
+    benchmark::DoNotOptimize(y.get());
+  }
+  report<T>(state, double(n) * n + 2.0 * n, 2.0 * n * n);
+}
+
+template <class T>
+void gemv_transposed(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  std::unique_ptr<T[]> x(new T[n]());
+  std::unique_ptr<T[]> y(new T[n]);
+  for (auto _ : state) {
+    multiply_transposed(a, std::span<const T>(x.get(), n), std::span<T>(y.get(), n));
+    benchmark::DoNotOptimize(y.get());
+  }
+  report<T>(state, double(n) * n + 2.0 * n, 2.0 * n * n);
+}
+
+// The same product through operator* with x as an n x 1 matrix.
+template <class T>
+void gemv_matrix(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> x(n, 1);
+  for (auto _ : state) {
+    matrix<T> y = a * x;
+    benchmark::DoNotOptimize(y.data());
+  }
+  report<T>(state, double(n) * n + 2.0 * n, 2.0 * n * n);
+}
+
+template <class T, class Acc>
+void wide_multiply(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> b = make_matrix<T>(n);
+  for (auto _ : state) {
+    matrix<Acc> c = multiply<Acc>(a, b);
+    benchmark::DoNotOptimize(c.data());
+  }
+  report<T>(state, 2.0 * n * n + double(n) * n * sizeof(Acc) / sizeof(T), 2.0 * n * n * n);
+}
+
+template <class T>
+void compensated_multiply(benchmark::State& state) {
+  size_t n = static_cast<size_t>(state.range(0));
+  matrix<T> a = make_matrix<T>(n);
+  matrix<T> b = make_matrix<T>(n);
+  for (auto _ : state) {
+    matrix<T> c = multiply_compensated(a, b);
+    benchmark::DoNotOptimize(c.data());
+  }
+  report<T>(state, 3.0 * n * n, 2.0 * n * n * n);
+}
+
+constexpr size_t SMALL_BATCH = 1 << 12;
+
+template <class T, size_t N>
+void small_multiply(benchmark::State& state) {
+  std::unique_ptr<static_matrix<T, N, N>[]> a(new static_matrix<T, N, N>[SMALL_BATCH]);
+  std::unique_ptr<static_matrix<T, N, N>[]> b(new static_matrix<T, N, N>[SMALL_BATCH]);
+  std::unique_ptr<static_matrix<T, N, N>[]> c(new static_matrix<T, N, N>[SMALL_BATCH]);
+  for (size_t l = 0; l < SMALL_BATCH; ++l) {
+    a[l](0, 0) = static_cast<T>(l % 11);
+    b[l](N - 1, N - 1) = static_cast<T>(l % 7);
+  }
+  for (auto _ : state) {
+    for (size_t l = 0; l < SMALL_BATCH; ++l) {
+      c[l] = a[l] * b[l];
+    }
+    benchmark::DoNotOptimize(c.get());
+  }
+  report<T>(state, 3.0 * N * N * SMALL_BATCH, 2.0 * N * N * N * SMALL_BATCH);
+}
+
+template <class T, size_t N>
+void batched_multiply(benchmark::State& state) {
+  batched_matrix<T, N, N> a(SMALL_BATCH);
+  batched_matrix<T, N, N> b(SMALL_BATCH);
+  batched_matrix<T, N, N> c(SMALL_BATCH);
+  for (size_t l = 0; l < SMALL_BATCH; ++l) {
+    a(l, 0, 0) = static_cast<T>(l % 11);
+    b(l, N - 1, N - 1) = static_cast<T>(l % 7);
+  }
+  for (auto _ : state) {
+    multiply(a, b, c);
+    benchmark::DoNotOptimize(c.data());
+  }
+  report<T>(state, 3.0 * N * N * SMALL_BATCH, 2.0 * N * N * N * SMALL_BATCH);
+}
+
+} // namespace
+
+#define MATRIX_BENCHMARK(name, sizes)                                                                                  \
+  BENCHMARK_TEMPLATE(name, int)->Apply(sizes<int>);                                                                    \
+  BENCHMARK_TEMPLATE(name, std::int64_t)->Apply(sizes<std::int64_t>);                                                  \
+  BENCHMARK_TEMPLATE(name, float)->Apply(sizes<float>);                                                                \
+  BENCHMARK_TEMPLATE(name, double)->Apply(sizes<double>);                                                              \
+  BENCHMARK_TEMPLATE(name, element)->Apply(sizes<element>)
+
+MATRIX_BENCHMARK(construct, elementwise_sizes);
+MATRIX_BENCHMARK(copy, elementwise_sizes);
+MATRIX_BENCHMARK(assign, elementwise_sizes);
+MATRIX_BENCHMARK(compare, elementwise_sizes);
+MATRIX_BENCHMARK(add, elementwise_sizes);
+MATRIX_BENCHMARK(sub_assign, elementwise_sizes);
+MATRIX_BENCHMARK(scale, elementwise_sizes);
+MATRIX_BENCHMARK(multiply, product_sizes);
+MATRIX_BENCHMARK(addmul, product_sizes);
+MATRIX_BENCHMARK(row_iteration, elementwise_sizes);
+MATRIX_BENCHMARK(col_iteration, elementwise_sizes);
+MATRIX_BENCHMARK(col_major_iteration, elementwise_sizes);
+MATRIX_BENCHMARK(col_major_multiply, product_sizes);
+MATRIX_BENCHMARK(gemv, elementwise_sizes);
+MATRIX_BENCHMARK(gemv_transposed, elementwise_sizes);
+MATRIX_BENCHMARK(gemv_matrix, elementwise_sizes);
+
+BENCHMARK_TEMPLATE(wide_multiply, std::int8_t, std::int32_t)->Apply(product_sizes<int>);
+BENCHMARK_TEMPLATE(wide_multiply, std::int16_t, std::int32_t)->Apply(product_sizes<int>);
+BENCHMARK_TEMPLATE(wide_multiply, float, double)->Apply(product_sizes<float>);
+BENCHMARK_TEMPLATE(compensated_multiply, float)->Apply(product_sizes<float>);
+
+#define MATRIX_SMALL_BENCHMARK(name)                                                                                   \
+  BENCHMARK_TEMPLATE(name, float, 2);                                                                                  \
+  BENCHMARK_TEMPLATE(name, float, 4);                                                                                  \
+  BENCHMARK_TEMPLATE(name, float, 8);                                                                                  \
+  BENCHMARK_TEMPLATE(name, double, 4);                                                                                 \
+  BENCHMARK_TEMPLATE(name, int, 4)
+
+MATRIX_SMALL_BENCHMARK(small_multiply);
+MATRIX_SMALL_BENCHMARK(batched_multiply);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+// Allocators for matrix storage.
+//
+// default_allocator is what matrix<T> uses unless told otherwise. The pool
+// and arena allocators draw from a pool_resource / arena_resource shared by
+// every allocator copy that refers to it:
+//
+//   arena_resource arena;
+//   matrix<double, arena_allocator<double>> tmp(rows, cols, arena_allocator<double>(arena));
+//   ...
+//   arena.release(); // frees every matrix carved from the arena at once
+
+namespace matrix_detail {
+
+template <class T>
+concept has_class_array_new = requires(size_t n) { T::operator new[](n); };
+
+template <class T>
+concept has_class_array_delete = requires(void* p) { T::operator delete[](p); };
+
+} // namespace matrix_detail
+
+// Allocates through T's class-specific operator new[] / operator delete[]
+// when it declares them, like new T[] would, and through the global ones
+// with cache-line (ALIGNMENT) alignment otherwise.
+template <class T>
+class default_allocator {
+public:
+  using value_type = T;
+
+  static constexpr size_t ALIGNMENT = 64;
+
+  default_allocator() = default;
+
+  template <class U>
+  default_allocator(const default_allocator<U>&) {}
+
+  T* allocate(size_t n) {
+    if constexpr (matrix_detail::has_class_array_new<T>) {
+      return static_cast<T*>(T::operator new[](n * sizeof(T)));
+    } else {
+      return static_cast<T*>(::operator new[](n * sizeof(T), std::align_val_t(ALIGNMENT)));
+    }
+  }
+
+  void deallocate(T* p, size_t) {
+    if constexpr (matrix_detail::has_class_array_delete<T>) {
+      T::operator delete[](p);
+    } else if constexpr (matrix_detail::has_class_array_new<T>) {
+      ::operator delete[](p);
+    } else {
+      ::operator delete[](p, std::align_val_t(ALIGNMENT));
+    }
+  }
+
+  friend bool operator==(const default_allocator&, const default_allocator&) = default;
+};
+
+// Size-class pool: requests are rounded up to a power of two between
+// MIN_BLOCK and MAX_BLOCK bytes and served from per-class free lists, which
+// are refilled by carving larger chunks. Freed blocks go back to their list
+// instead of to the heap, so long-running processes stop fragmenting it.
+// Larger requests go straight to the global operator new. Thread-safe.
+class pool_resource {
+public:
+  static constexpr size_t MIN_BLOCK = 64;
+  static constexpr size_t MAX_BLOCK = size_t(1) << 20;
+  static constexpr size_t CHUNK_SIZE = size_t(1) << 16;
+  static constexpr size_t ALIGNMENT = 64;
+
+  pool_resource() = default;
+
+  pool_resource(const pool_resource&) = delete;
+  pool_resource& operator=(const pool_resource&) = delete;
+
+  ~pool_resource() {
+    release();
+  }
+
+  void* allocate(size_t bytes) {
+    if (bytes > MAX_BLOCK) {
+      return ::operator new(bytes, std::align_val_t(ALIGNMENT));
+    }
+    size_t cls = size_class(bytes);
+
+    std::lock_guard lock(_mutex);
+    if (_free[cls] == nullptr) {
+      refill(cls);
+    }
+    free_block* block = _free[cls];
+    _free[cls] = block->next;
+    return block;
+  }
+
+  void deallocate(void* p, size_t bytes) {
+    if (bytes > MAX_BLOCK) {
+      ::operator delete(p, std::align_val_t(ALIGNMENT));
+      return;
+    }
+    size_t cls = size_class(bytes);
+
+    std::lock_guard lock(_mutex);
+    _free[cls] = new (p) free_block{_free[cls]};
+  }
+
+  // Returns every chunk to the heap. Outstanding blocks become invalid.
+  void release() {
+    std::lock_guard lock(_mutex);
+    while (_chunks != nullptr) {
+      chunk* next = _chunks->next;
+      ::operator delete(_chunks, std::align_val_t(ALIGNMENT));
+      _chunks = next;
+    }
+    for (free_block*& head : _free) {
+      head = nullptr;
+    }
+  }
+
+  // Process-wide pool used by default-constructed pool allocators.
+  static pool_resource& shared() {
+    static pool_resource pool;
+    return pool;
+  }
+
+private:
+  static constexpr size_t CLASSES = 15;
+  static_assert(MIN_BLOCK << (CLASSES - 1) == MAX_BLOCK);
+
+  struct free_block {
+    free_block* next;
+  };
+
+  struct alignas(ALIGNMENT) chunk {
+    chunk* next;
+  };
+
+  static size_t size_class(size_t bytes) {
+    size_t cls = 0;
+    while ((MIN_BLOCK << cls) < bytes) {
+      ++cls;
+    }
+    return cls;
+  }
+
+  void refill(size_t cls) {
+    size_t block = MIN_BLOCK << cls;
+    size_t count = block >= CHUNK_SIZE ? 1 : CHUNK_SIZE / block;
+
+    void* raw = ::operator new(sizeof(chunk) + block * count, std::align_val_t(ALIGNMENT));
+    _chunks = new (raw) chunk{_chunks};
+
+    char* first = static_cast<char*>(raw) + sizeof(chunk);
+    for (size_t i = count; i-- > 0;) {
+      _free[cls] = new (first + i * block) free_block{_free[cls]};
+    }
+  }
+
+  std::mutex _mutex;
+  free_block* _free[CLASSES] = {};
+  chunk* _chunks = nullptr;
+};
+
+template <class T>
+class pool_allocator {
+public:
+  using value_type = T;
+
+  pool_allocator() : _pool(&pool_resource::shared()) {}
+
+  explicit pool_allocator(pool_resource& pool) : _pool(&pool) {}
+
+  template <class U>
+  pool_allocator(const pool_allocator<U>& other) : _pool(other.resource()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(_pool->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) {
+    _pool->deallocate(p, n * sizeof(T));
+  }
+
+  pool_resource* resource() const {
+    return _pool;
+  }
+
+  friend bool operator==(const pool_allocator& left, const pool_allocator& right) {
+    return left._pool == right._pool;
+  }
+
+private:
+  pool_resource* _pool;
+};
+
+// Monotonic arena: allocation bumps a pointer through a list of chunks and
+// deallocation does nothing; release() frees everything at once. Meant for
+// short-lived temporaries scoped to one request. Not thread-safe.
+class arena_resource {
+public:
+  static constexpr size_t ALIGNMENT = 64;
+
+  explicit arena_resource(size_t chunk_size = size_t(1) << 16) : _chunk_size(chunk_size) {}
+
+  arena_resource(const arena_resource&) = delete;
+  arena_resource& operator=(const arena_resource&) = delete;
+
+  ~arena_resource() {
+    release();
+  }
+
+  void* allocate(size_t bytes) {
+    bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    if (bytes > _left) {
+      grow(bytes);
+    }
+    void* p = _next;
+    _next += bytes;
+    _left -= bytes;
+    _allocated += bytes;
+    return p;
+  }
+
+  void deallocate(void*, size_t) {}
+
+  // Frees every chunk; all memory handed out by the arena becomes invalid.
+  void release() {
+    while (_chunks != nullptr) {
+      chunk* next = _chunks->next;
+      ::operator delete(_chunks, std::align_val_t(ALIGNMENT));
+      _chunks = next;
+    }
+    _next = nullptr;
+    _left = 0;
+    _allocated = 0;
+  }
+
+  // Bytes handed out since construction or the last release().
+  size_t allocated() const {
+    return _allocated;
+  }
+
+private:
+  struct alignas(ALIGNMENT) chunk {
+    chunk* next;
+  };
+
+  void grow(size_t bytes) {
+    size_t size = bytes > _chunk_size ? bytes : _chunk_size;
+    void* raw = ::operator new(sizeof(chunk) + size, std::align_val_t(ALIGNMENT));
+    _chunks = new (raw) chunk{_chunks};
+    _next = static_cast<char*>(raw) + sizeof(chunk);
+    _left = size;
+    // Geometric growth keeps the number of chunks logarithmic.
+    _chunk_size *= 2;
+  }
+
+  size_t _chunk_size;
+  chunk* _chunks = nullptr;
+  char* _next = nullptr;
+  size_t _left = 0;
+  size_t _allocated = 0;
+};
+
+template <class T>
+class arena_allocator {
+public:
+  using value_type = T;
+
+  explicit arena_allocator(arena_resource& arena) : _arena(&arena) {}
+
+  template <class U>
+  arena_allocator(const arena_allocator<U>& other) : _arena(other.resource()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(_arena->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) {
+    _arena->deallocate(p, n * sizeof(T));
+  }
+
+  arena_resource* resource() const {
+    return _arena;
+  }
+
+  friend bool operator==(const arena_allocator& left, const arena_allocator& right) {
+    return left._arena == right._arena;
+  }
+
+private:
+  arena_resource* _arena;
+};
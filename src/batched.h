@@ -0,0 +1,332 @@
+#pragma once
+
+#include "simd.h"
+#include "static-matrix.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Batches of many small matrices of the same shape, multiplied all at once.
+//
+// Multiplying millions of 4x4 matrices one static_matrix (or worse, one
+// matrix) at a time leaves the vector units mostly idle: a 4x4 product is a
+// handful of dot products, each too short to fill a register. A batch stores
+// its matrices interleaved instead (structure of arrays), so lane l of a
+// vector register holds element (i, j) of matrix l, and the product of two
+// batches is the scalar small-matrix product with every operation applied to
+// whole registers.
+//
+//   batched_matrix<float, 4, 4> a(count), b(count);
+//   for (size_t l = 0; l < count; ++l) {
+//     a.set(l, transforms[l]);
+//     b.set(l, points[l]);
+//   }
+//   batched_matrix<float, 4, 4> c = a * b; // c.get(l) == transforms[l] * points[l]
+//
+// The interleaving is done in groups of one cache line worth of matrices
+// (16 floats, 8 doubles): a group stores element (0, 0) of its matrices in
+// one line, then element (0, 1), and so on, and the groups follow each other.
+// A product then streams through all three batches sequentially, rather than
+// through Rows * Cols arrays a power of two apart that would fight over the
+// same cache sets. The last group is padded with zeros, so the kernels never
+// need a scalar tail.
+//
+// Like the element-wise kernels in simd.h, products of 32- and 64-bit
+// arithmetic types are compiled for SSE2, AVX2 and AVX-512 and dispatched at
+// run time; other arithmetic types go through a plain loop over the batch.
+// Large batches are split across the thread pool (see thread-pool.h).
+
+namespace matrix_detail {
+
+// Matrices in an interleaved group: as many elements as fit in 64 bytes.
+template <class T>
+inline constexpr size_t batched_group = 64 / sizeof(T);
+
+// Groups handled by one parallel task.
+inline constexpr size_t batched_chunk = 64;
+
+// Computes out = a * b for the groups [begin, end), where a is a batch of
+// Rows x Inner and b of Inner x Cols matrices.
+template <class T, size_t Rows, size_t Inner, size_t Cols>
+using batched_kernel = void (*)(const T* a, const T* b, T* out, size_t begin, size_t end);
+
+#if MATRIX_SIMD_X86
+
+// The body is written once with GCC vector extensions and inlined into the
+// per-ISA entry points below, as in simd.h. Each row of A is kept in
+// registers while it is multiplied by every column of B.
+template <class T, size_t Rows, size_t Inner, size_t Cols, size_t Bytes>
+struct batched_body {
+  typedef T vec __attribute__((vector_size(Bytes)));
+  typedef T unaligned_vec __attribute__((vector_size(Bytes), aligned(alignof(T)), may_alias));
+  static constexpr size_t LANES = Bytes / sizeof(T);
+
+  static inline __attribute__((always_inline)) const unaligned_vec& load(const T* p) {
+    return *reinterpret_cast<const unaligned_vec*>(p);
+  }
+
+  static inline __attribute__((always_inline)) void store(T* p, const vec& v) {
+    *reinterpret_cast<unaligned_vec*>(p) = v;
+  }
+
+  static inline __attribute__((always_inline)) void multiply(const T* a, const T* b, T* out, size_t begin,
+                                                              size_t end) {
+    constexpr size_t G = batched_group<T>;
+    for (size_t g = begin; g < end; ++g) {
+      const T* x = a + g * Rows * Inner * G;
+      const T* y = b + g * Inner * Cols * G;
+      T* z = out + g * Rows * Cols * G;
+      for (size_t l = 0; l < G; l += LANES) {
+        for (size_t i = 0; i < Rows; ++i) {
+          vec row[Inner];
+          for (size_t p = 0; p < Inner; ++p) {
+            row[p] = load(x + (i * Inner + p) * G + l);
+          }
+          for (size_t j = 0; j < Cols; ++j) {
+            vec sum = row[0] * load(y + j * G + l);
+            for (size_t p = 1; p < Inner; ++p) {
+              sum += row[p] * load(y + (p * Cols + j) * G + l);
+            }
+            store(z + (i * Cols + j) * G + l, sum);
+          }
+        }
+      }
+    }
+  }
+};
+
+#define MATRIX_BATCHED_VARIANT(NAME, TARGET, BYTES)                                                                    \
+  template <class T, size_t Rows, size_t Inner, size_t Cols>                                                           \
+  struct batched_##NAME {                                                                                              \
+    __attribute__((target(TARGET))) static void multiply(const T* a, const T* b, T* out, size_t begin, size_t end) {   \
+      batched_body<T, Rows, Inner, Cols, BYTES>::multiply(a, b, out, begin, end);                                      \
+    }                                                                                                                  \
+  };
+
+MATRIX_BATCHED_VARIANT(sse2, "sse2", 16)
+MATRIX_BATCHED_VARIANT(avx2, "avx2", 32)
+MATRIX_BATCHED_VARIANT(avx512, "avx512f", 64)
+
+#undef MATRIX_BATCHED_VARIANT
+
+#endif
+
+template <class T, size_t Rows, size_t Inner, size_t Cols>
+struct batched_generic {
+  static void multiply(const T* a, const T* b, T* out, size_t begin, size_t end) {
+    constexpr size_t G = batched_group<T>;
+    for (size_t g = begin; g < end; ++g) {
+      for (size_t i = 0; i < Rows; ++i) {
+        for (size_t j = 0; j < Cols; ++j) {
+          T* sum = out + (g * Rows * Cols + i * Cols + j) * G;
+          std::fill_n(sum, G, T(0));
+          for (size_t p = 0; p < Inner; ++p) {
+            const T* x = a + (g * Rows * Inner + i * Inner + p) * G;
+            const T* y = b + (g * Inner * Cols + p * Cols + j) * G;
+            for (size_t l = 0; l < G; ++l) {
+              sum[l] += x[l] * y[l];
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+template <class T, size_t Rows, size_t Inner, size_t Cols>
+batched_kernel<T, Rows, Inner, Cols> select_batched_kernel(simd_level level) {
+#if MATRIX_SIMD_X86
+  if constexpr (simd_vectorizable<T>) {
+    switch (level) {
+    case simd_level::avx512:
+      return &batched_avx512<T, Rows, Inner, Cols>::multiply;
+    case simd_level::avx2:
+      return &batched_avx2<T, Rows, Inner, Cols>::multiply;
+    case simd_level::sse2:
+      return &batched_sse2<T, Rows, Inner, Cols>::multiply;
+    case simd_level::generic:
+      break;
+    }
+  }
+#endif
+  (void)level;
+  return &batched_generic<T, Rows, Inner, Cols>::multiply;
+}
+
+template <class T, size_t Rows, size_t Inner, size_t Cols>
+batched_kernel<T, Rows, Inner, Cols> dispatched_batched_kernel() {
+  static const batched_kernel<T, Rows, Inner, Cols> kernel =
+      select_batched_kernel<T, Rows, Inner, Cols>(cpu_simd_level());
+  return kernel;
+}
+
+} // namespace matrix_detail
+
+template <class T, size_t Rows, size_t Cols>
+  requires std::is_arithmetic_v<T>
+class batched_matrix {
+  static_assert(Rows > 0 && Cols > 0, "batched_matrix dimensions must be positive");
+
+  static constexpr size_t GROUP = matrix_detail::batched_group<T>;
+
+public:
+  using value_type = T;
+
+  // count matrices of zeros.
+  explicit batched_matrix(size_t count = 0)
+      : _count(count), _groups((count + GROUP - 1) / GROUP), _data(allocate(storage_size())) {
+    std::fill_n(_data, storage_size(), T(0));
+  }
+
+  batched_matrix(const batched_matrix& other)
+      : _count(other._count), _groups(other._groups), _data(allocate(storage_size())) {
+    std::copy_n(other._data, storage_size(), _data);
+  }
+
+  batched_matrix(batched_matrix&& other) noexcept
+      : _count(std::exchange(other._count, 0)), _groups(std::exchange(other._groups, 0)),
+        _data(std::exchange(other._data, nullptr)) {}
+
+  batched_matrix& operator=(batched_matrix other) noexcept {
+    swap(*this, other);
+    return *this;
+  }
+
+  ~batched_matrix() {
+    ::operator delete(_data, std::align_val_t(64));
+  }
+
+  friend void swap(batched_matrix& left, batched_matrix& right) noexcept {
+    std::swap(left._count, right._count);
+    std::swap(left._groups, right._groups);
+    std::swap(left._data, right._data);
+  }
+
+  // Size
+
+  // Number of matrices in the batch.
+  size_t count() const {
+    return _count;
+  }
+  static constexpr size_t rows() {
+    return Rows;
+  }
+  static constexpr size_t cols() {
+    return Cols;
+  }
+  bool empty() const {
+    return _count == 0;
+  }
+
+  // Number of matrices interleaved in a group, and number of groups.
+  static constexpr size_t group_size() {
+    return GROUP;
+  }
+  size_t groups() const {
+    return _groups;
+  }
+
+  // Elements access
+
+  // Element (row, col) of matrix index.
+  T& operator()(size_t index, size_t row, size_t col) {
+    return _data[offset(index, row, col)];
+  }
+  const T& operator()(size_t index, size_t row, size_t col) const {
+    return _data[offset(index, row, col)];
+  }
+
+  // groups() * Rows * Cols * group_size() values, cache-line aligned.
+  T* data() {
+    return _data;
+  }
+  const T* data() const {
+    return _data;
+  }
+
+  static_matrix<T, Rows, Cols> get(size_t index) const {
+    static_matrix<T, Rows, Cols> m;
+    for (size_t i = 0; i < Rows; ++i) {
+      for (size_t j = 0; j < Cols; ++j) {
+        m(i, j) = (*this)(index, i, j);
+      }
+    }
+    return m;
+  }
+
+  void set(size_t index, const static_matrix<T, Rows, Cols>& m) {
+    for (size_t i = 0; i < Rows; ++i) {
+      for (size_t j = 0; j < Cols; ++j) {
+        (*this)(index, i, j) = m(i, j);
+      }
+    }
+  }
+
+  // Comparison
+
+  friend bool operator==(const batched_matrix& left, const batched_matrix& right) {
+    if (left._count != right._count) {
+      return false;
+    }
+    // The padding of the last group is always zero, so whole groups compare.
+    return std::equal(left._data, left._data + left.storage_size(), right._data);
+  }
+
+  friend bool operator!=(const batched_matrix& left, const batched_matrix& right) {
+    return !(left == right);
+  }
+
+private:
+  static T* allocate(size_t n) {
+    if (n == 0) {
+      return nullptr;
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(64)));
+  }
+
+  static size_t offset(size_t index, size_t row, size_t col) {
+    return (index / GROUP * Rows * Cols + row * Cols + col) * GROUP + index % GROUP;
+  }
+
+  size_t storage_size() const {
+    return _groups * Rows * Cols * GROUP;
+  }
+
+  size_t _count;
+  size_t _groups;
+  T* _data;
+};
+
+// Stores the product of every pair of matrices of a and b in out. The
+// batches must have the same count (std::invalid_argument is thrown
+// otherwise), and out must not be a or b.
+template <class T, size_t Rows, size_t Inner, size_t Cols>
+void multiply(const batched_matrix<T, Rows, Inner>& a, const batched_matrix<T, Inner, Cols>& b,
+              batched_matrix<T, Rows, Cols>& out) {
+  if (a.count() != out.count() || b.count() != out.count()) {
+    throw std::invalid_argument("batched multiply: batch counts differ");
+  }
+  // The zero padding of the last group is multiplied too and stays zero.
+  size_t groups = out.groups();
+  auto kernel = matrix_detail::dispatched_batched_kernel<T, Rows, Inner, Cols>();
+  size_t chunks = (groups + matrix_detail::batched_chunk - 1) / matrix_detail::batched_chunk;
+  size_t work = groups * out.group_size() * Rows * Inner * Cols;
+  matrix_detail::parallel_for(chunks, work, [&](size_t c) {
+    size_t begin = c * matrix_detail::batched_chunk;
+    size_t end = std::min(groups, begin + matrix_detail::batched_chunk);
+    kernel(a.data(), b.data(), out.data(), begin, end);
+  });
+}
+
+template <class T, size_t Rows, size_t Inner, size_t Cols>
+batched_matrix<T, Rows, Cols> operator*(const batched_matrix<T, Rows, Inner>& a,
+                                        const batched_matrix<T, Inner, Cols>& b) {
+  batched_matrix<T, Rows, Cols> out(a.count());
+  multiply(a, b, out);
+  return out;
+}
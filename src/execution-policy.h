@@ -0,0 +1,210 @@
+#pragma once
+
+#include "matrix.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<execution>) && !defined(MATRIX_NO_STD_EXECUTION)
+#include <execution>
+#define MATRIX_STD_EXECUTION 1
+#else
+#define MATRIX_STD_EXECUTION 0
+#endif
+
+// Per-call parallelism.
+//
+// The global settings in thread-pool.h decide for every operation whether it
+// is split across the thread pool. The functions here take an execution
+// policy as their first argument and decide for a single call instead:
+//
+//   matrix<double> c = add(std::execution::par, a, b);       // a + b
+//   matrix<double> p = multiply(matrix_parallel::par, a, c); // a * c
+//   bool same = equal(std::execution::par, p, c);
+//
+// A parallel policy (std::execution::par and par_unseq, matrix_parallel::par)
+// runs the operation on the pool however little work it is, with
+// matrix_parallel::num_threads() threads, or all hardware threads while that
+// is 1. A sequenced one (std::execution::seq and unseq, matrix_parallel::seq)
+// keeps it on the calling thread. The kernels are vectorized either way, so
+// the unsequenced policies behave like their sequenced counterparts. Work
+// nested in the call, such as evaluating an expression operand, follows the
+// same policy.
+//
+// The std::execution policies are accepted when <execution> is available.
+// libstdc++'s <execution> needs TBB linked when the TBB headers are
+// installed; define MATRIX_NO_STD_EXECUTION to leave it out and use the
+// library policies only.
+
+namespace matrix_parallel {
+
+struct sequenced_policy {
+  explicit sequenced_policy() = default;
+};
+
+struct parallel_policy {
+  explicit parallel_policy() = default;
+};
+
+inline constexpr sequenced_policy seq{};
+inline constexpr parallel_policy par{};
+
+} // namespace matrix_parallel
+
+namespace matrix_detail {
+
+// The parallel_mode an execution policy selects; empty for other types.
+template <class P>
+struct policy_mode {};
+
+template <>
+struct policy_mode<matrix_parallel::sequenced_policy> {
+  static constexpr parallel_mode value = parallel_mode::serial;
+};
+
+template <>
+struct policy_mode<matrix_parallel::parallel_policy> {
+  static constexpr parallel_mode value = parallel_mode::parallel;
+};
+
+#if MATRIX_STD_EXECUTION
+template <>
+struct policy_mode<std::execution::sequenced_policy> {
+  static constexpr parallel_mode value = parallel_mode::serial;
+};
+
+template <>
+struct policy_mode<std::execution::parallel_policy> {
+  static constexpr parallel_mode value = parallel_mode::parallel;
+};
+
+template <>
+struct policy_mode<std::execution::parallel_unsequenced_policy> {
+  static constexpr parallel_mode value = parallel_mode::parallel;
+};
+
+#if defined(__cpp_lib_execution) && __cpp_lib_execution >= 201902L
+template <>
+struct policy_mode<std::execution::unsequenced_policy> {
+  static constexpr parallel_mode value = parallel_mode::serial;
+};
+#endif
+#endif
+
+template <class P>
+concept execution_policy = requires { policy_mode<std::remove_cvref_t<P>>::value; };
+
+template <class P>
+inline constexpr parallel_mode policy_mode_v = policy_mode<std::remove_cvref_t<P>>::value;
+
+// Matrix type an element-wise result is built as: the left operand's type
+// if it is a matrix, keeping its allocator and layout, matrix<T> otherwise.
+template <class X>
+using policy_result_t = std::conditional_t<is_matrix_v<X>, std::remove_cvref_t<X>, matrix<operand_value_t<X>>>;
+
+// Whether two materialized operands of the same shape hold equal elements,
+// compared line by line in the left operand's storage order.
+template <class L, class R>
+bool equal_elements(const L& left, const R& right) {
+  constexpr bool by_cols = std::is_same_v<layout_of_t<L>, col_major>;
+  size_t lines = by_cols ? left.cols() : left.rows();
+  std::atomic<bool> same{true};
+  parallel_for(lines, left.size(), [&](size_t line) {
+    if (!same.load(std::memory_order_relaxed)) {
+      return;
+    }
+    bool equal_line;
+    if constexpr (by_cols) {
+      equal_line = std::equal(left.col_begin(line), left.col_end(line), right.col_begin(line));
+    } else {
+      equal_line = std::equal(left.row_begin(line), left.row_end(line), right.row_begin(line));
+    }
+    if (!equal_line) {
+      same.store(false, std::memory_order_relaxed);
+    }
+  });
+  return same.load();
+}
+
+} // namespace matrix_detail
+
+// left + right.
+template <class P, class L, class R>
+  requires(matrix_detail::execution_policy<P> && matrix_detail::matrix_operand<L> &&
+           matrix_detail::matrix_operand<R> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<R>>)
+matrix_detail::policy_result_t<L> add(P&&, L&& left, R&& right) {
+  matrix_detail::parallel_mode_scope scope(matrix_detail::policy_mode_v<P>);
+  return matrix_detail::policy_result_t<L>(std::forward<L>(left) + std::forward<R>(right));
+}
+
+// left - right.
+template <class P, class L, class R>
+  requires(matrix_detail::execution_policy<P> && matrix_detail::matrix_operand<L> &&
+           matrix_detail::matrix_operand<R> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<R>>)
+matrix_detail::policy_result_t<L> subtract(P&&, L&& left, R&& right) {
+  matrix_detail::parallel_mode_scope scope(matrix_detail::policy_mode_v<P>);
+  return matrix_detail::policy_result_t<L>(std::forward<L>(left) - std::forward<R>(right));
+}
+
+// x * factor.
+template <class P, class X>
+  requires(matrix_detail::execution_policy<P> && matrix_detail::matrix_operand<X>)
+matrix_detail::policy_result_t<X> scale(P&&, X&& x, const matrix_detail::operand_value_t<X>& factor) {
+  matrix_detail::parallel_mode_scope scope(matrix_detail::policy_mode_v<P>);
+  return matrix_detail::policy_result_t<X>(std::forward<X>(x) * factor);
+}
+
+// left * right, the matrix product.
+template <class P, class L, class R>
+  requires(matrix_detail::execution_policy<P> && matrix_detail::matrix_operand<L> &&
+           matrix_detail::matrix_operand<R> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<R>>)
+auto multiply(P&&, L&& left, R&& right) {
+  matrix_detail::parallel_mode_scope scope(matrix_detail::policy_mode_v<P>);
+  return std::forward<L>(left) * std::forward<R>(right);
+}
+
+// Whether left and right have the same shape and elements, whatever their
+// layouts.
+template <class P, class L, class R>
+  requires(matrix_detail::execution_policy<P> && matrix_detail::matrix_operand<L> &&
+           matrix_detail::matrix_operand<R> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<R>>)
+bool equal(P&&, L&& left, R&& right) {
+  matrix_detail::parallel_mode_scope scope(matrix_detail::policy_mode_v<P>);
+  decltype(auto) a = matrix_detail::materialize(std::forward<L>(left));
+  decltype(auto) b = matrix_detail::materialize(std::forward<R>(right));
+  MATRIX_STATS_SCOPE(compare);
+  if (a.rows() != b.rows() || a.cols() != b.cols()) {
+    return false;
+  }
+  return matrix_detail::equal_elements(a, b);
+}
+
+// dest += x, dest -= x and dest *= factor, for a matrix or a mutable view.
+template <class P, class C, class X>
+  requires(matrix_detail::execution_policy<P> && requires(C& c, X&& x) { c += std::forward<X>(x); })
+void add_assign(P&&, C&& dest, X&& x) {
+  matrix_detail::parallel_mode_scope scope(matrix_detail::policy_mode_v<P>);
+  dest += std::forward<X>(x);
+}
+
+template <class P, class C, class X>
+  requires(matrix_detail::execution_policy<P> && requires(C& c, X&& x) { c -= std::forward<X>(x); })
+void sub_assign(P&&, C&& dest, X&& x) {
+  matrix_detail::parallel_mode_scope scope(matrix_detail::policy_mode_v<P>);
+  dest -= std::forward<X>(x);
+}
+
+template <class P, class C>
+  requires(matrix_detail::execution_policy<P> && matrix_detail::gemm_output<C>)
+void scale_assign(P&&, C&& dest, const matrix_detail::operand_value_t<C>& factor) {
+  matrix_detail::parallel_mode_scope scope(matrix_detail::policy_mode_v<P>);
+  dest *= factor;
+}
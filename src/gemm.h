@@ -0,0 +1,300 @@
+#pragma once
+
+#include "layout.h"
+#include "matrix-stats.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+// General matrix multiply kernels used by matrix::operator* and operator*=.
+//
+// All kernels compute C += alpha * A * B, where A is m x k, B is k x n and C
+// is m x n, and alpha is gemm_unit (no scaling, the default) or a value of T.
+// C is stored row by row with leading dimension ldc (distance between the
+// starts of two consecutive rows). A and B are read through their layout
+// (see layout.h), so a transposed operand is just a column-major one and is
+// never copied out: packing absorbs the access pattern, and the unpacked
+// kernel switches to row dot products for A * B^T.
+
+namespace matrix_detail {
+
+// Blocking parameters for the packed kernel.
+//
+// The micro-kernel keeps an MR x NR block of C in registers. KC is chosen so
+// that a KC x NR micro-panel of B stays in L1 while it is reused for every
+// micro-panel of A, MC so that the packed MC x KC block of A stays in L2, and
+// NC so that the packed KC x NC block of B stays in L3.
+template <class T>
+struct gemm_blocking {
+  static constexpr size_t MR = 4;
+  static constexpr size_t NR = 64 / sizeof(T) < 4 ? 4 : 64 / sizeof(T);
+  static constexpr size_t KC = 256;
+  static constexpr size_t MC = 96 / MR * MR;
+  static constexpr size_t NC = (2048 * 1024 / sizeof(T) / KC) / NR * NR;
+};
+
+// Products smaller than this (in multiply-adds) skip packing entirely.
+inline constexpr size_t gemm_packing_threshold = 32 * 32 * 32;
+
+template <class T>
+inline constexpr bool gemm_packable = std::is_arithmetic_v<T>;
+
+// Scale factor of 1, which compiles to nothing.
+struct gemm_unit {};
+
+template <class T>
+const T& gemm_scale(gemm_unit, const T& x) {
+  return x;
+}
+
+template <class T>
+T gemm_scale(const T& alpha, const T& x) {
+  return alpha * x;
+}
+
+// Uninitialized, cache-line aligned scratch storage for packed panels (and
+// the Strassen workspace). Counted as an allocation of the running operation.
+template <class T>
+class gemm_buffer {
+public:
+  explicit gemm_buffer(size_t count)
+      : _data(static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(64)))) {
+    MATRIX_STATS_ALLOCATION(count * sizeof(T));
+  }
+
+  gemm_buffer(const gemm_buffer&) = delete;
+  gemm_buffer& operator=(const gemm_buffer&) = delete;
+
+  ~gemm_buffer() {
+    ::operator delete(_data, std::align_val_t(64));
+  }
+
+  T* data() const {
+    return _data;
+  }
+
+private:
+  T* _data;
+};
+
+// Copies an mc x kc block of A, times alpha, into micro-panels of MR rows,
+// each stored column by column, padding the last panel with zeros.
+template <class Layout, class T, class Alpha>
+void gemm_pack_a(size_t mc, size_t kc, const T* a, size_t lda, T* out, const Alpha& alpha) {
+  constexpr size_t MR = gemm_blocking<T>::MR;
+
+  for (size_t ir = 0; ir < mc; ir += MR) {
+    size_t mr = std::min(MR, mc - ir);
+    for (size_t p = 0; p < kc; ++p) {
+      for (size_t i = 0; i < mr; ++i) {
+        out[i] = gemm_scale(alpha, a[Layout::offset(ir + i, p, lda)]);
+      }
+      for (size_t i = mr; i < MR; ++i) {
+        out[i] = T(0);
+      }
+      out += MR;
+    }
+  }
+}
+
+// Copies a kc x nc block of B into micro-panels of NR columns, each stored
+// row by row, padding the last panel with zeros. A column-major B is read
+// column by column, so the reads stay contiguous and the strided writes land
+// in the panel, which is small enough to stay in L1.
+template <class Layout, class T>
+void gemm_pack_b(size_t kc, size_t nc, const T* b, size_t ldb, T* out) {
+  constexpr size_t NR = gemm_blocking<T>::NR;
+
+  for (size_t jr = 0; jr < nc; jr += NR) {
+    size_t nr = std::min(NR, nc - jr);
+    if constexpr (std::is_same_v<Layout, col_major>) {
+      for (size_t j = 0; j < nr; ++j) {
+        const T* col = b + (jr + j) * ldb;
+        for (size_t p = 0; p < kc; ++p) {
+          out[p * NR + j] = col[p];
+        }
+      }
+      for (size_t j = nr; j < NR; ++j) {
+        for (size_t p = 0; p < kc; ++p) {
+          out[p * NR + j] = T(0);
+        }
+      }
+      out += kc * NR;
+    } else {
+      for (size_t p = 0; p < kc; ++p) {
+        const T* row = b + p * ldb + jr;
+        for (size_t j = 0; j < nr; ++j) {
+          out[j] = row[j];
+        }
+        for (size_t j = nr; j < NR; ++j) {
+          out[j] = T(0);
+        }
+        out += NR;
+      }
+    }
+  }
+}
+
+// C[0..mr, 0..nr) += packed A micro-panel * packed B micro-panel.
+//
+// The accumulator block has compile-time extents, so the compiler keeps it in
+// vector registers and fully unrolls the inner loops.
+template <class T>
+void gemm_micro_kernel(size_t kc, const T* a, const T* b, T* c, size_t ldc, size_t mr, size_t nr) {
+  constexpr size_t MR = gemm_blocking<T>::MR;
+  constexpr size_t NR = gemm_blocking<T>::NR;
+
+  T acc[MR][NR] = {};
+  for (size_t p = 0; p < kc; ++p) {
+    for (size_t i = 0; i < MR; ++i) {
+      T ai = a[i];
+      for (size_t j = 0; j < NR; ++j) {
+        acc[i][j] += ai * b[j];
+      }
+    }
+    a += MR;
+    b += NR;
+  }
+
+  for (size_t i = 0; i < mr; ++i) {
+    for (size_t j = 0; j < nr; ++j) {
+      c[i * ldc + j] += acc[i][j];
+    }
+  }
+}
+
+// Goto-style blocked multiply with packed panels of A and B.
+template <class LayoutA, class LayoutB, class T, class Alpha>
+void gemm_packed(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+                 const Alpha& alpha) {
+  using blocking = gemm_blocking<T>;
+  constexpr size_t MR = blocking::MR;
+  constexpr size_t NR = blocking::NR;
+
+  size_t kc_max = std::min(blocking::KC, k);
+  size_t mc_max = std::min(blocking::MC, (m + MR - 1) / MR * MR);
+  size_t nc_max = std::min(blocking::NC, (n + NR - 1) / NR * NR);
+
+  gemm_buffer<T> packed_a(mc_max * kc_max);
+  gemm_buffer<T> packed_b(kc_max * nc_max);
+
+  for (size_t jc = 0; jc < n; jc += blocking::NC) {
+    size_t nc = std::min(blocking::NC, n - jc);
+    for (size_t pc = 0; pc < k; pc += blocking::KC) {
+      size_t kc = std::min(blocking::KC, k - pc);
+      gemm_pack_b<LayoutB>(kc, nc, b + LayoutB::offset(pc, jc, ldb), ldb, packed_b.data());
+
+      for (size_t ic = 0; ic < m; ic += blocking::MC) {
+        size_t mc = std::min(blocking::MC, m - ic);
+        gemm_pack_a<LayoutA>(mc, kc, a + LayoutA::offset(ic, pc, lda), lda, packed_a.data(), alpha);
+
+        for (size_t jr = 0; jr < nc; jr += NR) {
+          const T* bp = packed_b.data() + jr * kc;
+          for (size_t ir = 0; ir < mc; ir += MR) {
+            const T* ap = packed_a.data() + ir * kc;
+            gemm_micro_kernel(kc, ap, bp, c + (ic + ir) * ldc + jc + jr, ldc, std::min(MR, mc - ir),
+                              std::min(NR, nc - jr));
+          }
+        }
+      }
+    }
+  }
+}
+
+// Cache-friendly i-k-j multiply for element types that cannot be packed
+// (or products too small to amortize packing): the innermost loop walks rows
+// of B and C contiguously instead of striding down a column of B. For a
+// column-major B (A * B^T) the columns of B are contiguous instead, so every
+// element of C is a dot product of a row of A with a column of B.
+template <class LayoutA, class LayoutB, class T, class Alpha>
+void gemm_simple(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+                 const Alpha& alpha) {
+  constexpr size_t KB = 128;
+  constexpr size_t NB = 512;
+
+  if constexpr (std::is_same_v<LayoutB, col_major>) {
+    for (size_t pb = 0; pb < k; pb += KB) {
+      size_t pe = std::min(k, pb + KB);
+      for (size_t i = 0; i < m; ++i) {
+        T* c_row = c + i * ldc;
+        for (size_t j = 0; j < n; ++j) {
+          const T* b_col = b + j * ldb;
+          T acc = c_row[j];
+          for (size_t p = pb; p < pe; ++p) {
+            acc += gemm_scale(alpha, a[LayoutA::offset(i, p, lda)]) * b_col[p];
+          }
+          c_row[j] = acc;
+        }
+      }
+    }
+  } else {
+    for (size_t jb = 0; jb < n; jb += NB) {
+      size_t je = std::min(n, jb + NB);
+      for (size_t pb = 0; pb < k; pb += KB) {
+        size_t pe = std::min(k, pb + KB);
+        for (size_t i = 0; i < m; ++i) {
+          T* c_row = c + i * ldc;
+          for (size_t p = pb; p < pe; ++p) {
+            decltype(auto) aip = gemm_scale(alpha, a[LayoutA::offset(i, p, lda)]);
+            const T* b_row = b + p * ldb;
+            for (size_t j = jb; j < je; ++j) {
+              c_row[j] += aip * b_row[j];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <class LayoutA = row_major, class LayoutB = row_major, class T, class Alpha = gemm_unit>
+void gemm(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+          const Alpha& alpha = {}) {
+  if (m == 0 || n == 0 || k == 0) {
+    return;
+  }
+  if constexpr (gemm_packable<T>) {
+    if (m * n * k >= gemm_packing_threshold) {
+      gemm_packed<LayoutA, LayoutB>(m, n, k, a, lda, b, ldb, c, ldc, alpha);
+      return;
+    }
+  }
+  gemm_simple<LayoutA, LayoutB>(m, n, k, a, lda, b, ldb, c, ldc, alpha);
+}
+
+// Splits C into 2D tiles and multiplies them independently on the thread
+// pool. Row tiles are preferred, so tall-skinny products still get enough
+// tasks; columns are split only when there are too few rows to go around.
+template <class LayoutA = row_major, class LayoutB = row_major, class T, class Alpha = gemm_unit>
+void gemm_parallel(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+                   const Alpha& alpha = {}) {
+  constexpr size_t MIN_TILE_ROWS = 16;
+  constexpr size_t MIN_TILE_COLS = 64;
+
+  if (m == 0 || n == 0 || k == 0) {
+    return;
+  }
+  if (!should_parallelize(m * n * k)) {
+    gemm<LayoutA, LayoutB>(m, n, k, a, lda, b, ldb, c, ldc, alpha);
+    return;
+  }
+
+  size_t target = 4 * parallel_threads();
+  size_t tile_m = std::max(MIN_TILE_ROWS, (m + target - 1) / target);
+  size_t row_tiles = (m + tile_m - 1) / tile_m;
+  size_t col_split = (target + row_tiles - 1) / row_tiles;
+  size_t tile_n = std::max(MIN_TILE_COLS, (n + col_split - 1) / col_split);
+  size_t col_tiles = (n + tile_n - 1) / tile_n;
+
+  parallel_for(row_tiles * col_tiles, m * n * k, [&](size_t tile) {
+    size_t i0 = tile / col_tiles * tile_m;
+    size_t j0 = tile % col_tiles * tile_n;
+    gemm<LayoutA, LayoutB>(std::min(tile_m, m - i0), std::min(tile_n, n - j0), k, a + LayoutA::offset(i0, 0, lda), lda,
+                           b + LayoutB::offset(0, j0, ldb), ldb, c + i0 * ldc + j0, ldc, alpha);
+  });
+}
+
+} // namespace matrix_detail
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "matrix.h"
+#include "simd.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+// Matrix-vector products (GEMV):
+//
+//   multiply(a, x, y);            // y = A x
+//   multiply_transposed(a, x, y); // y = A^T x
+//
+// a is a matrix or a view, x and y are spans (a std::vector, std::array or
+// plain array converts implicitly). No N x 1 matrix is built and nothing is
+// allocated.
+//
+// A GEMV reads every element of A once and does one multiply-add with it, so
+// it is bound by memory bandwidth; the kernels are shaped to read A exactly
+// once, in storage order:
+//
+// - A x on row-major storage is a dot product per row. Four rows are done at
+//   a time, so every load of x is shared by four rows.
+// - A^T x on row-major storage adds x[i] times row i to y for every row.
+//   Four rows are folded in per pass over y, and y is processed in blocks
+//   that stay in L1 while all the rows stream past.
+//
+// A column-major view (a transpose) swaps the two. For 32- and 64-bit
+// arithmetic types the kernels are compiled for SSE2, AVX2 and AVX-512 and
+// dispatched at run time like the ones in simd.h; other types use plain
+// loops. Large products are split across the thread pool (see
+// thread-pool.h), by rows for the dot products and by blocks of y for the
+// row updates, so no two threads write the same element.
+//
+// y must not overlap A or x.
+
+namespace matrix_detail {
+
+// Element type of a matrix or view, without the const of a read-only view.
+template <class M>
+using gemv_value_t = std::remove_const_t<typename M::value_type>;
+
+// Rows per parallel task of the dot-product kernel.
+inline constexpr size_t gemv_row_block = 64;
+
+// Elements of y updated together by the row-update kernel, and per task.
+inline constexpr size_t gemv_col_block = 1024;
+
+template <class T>
+struct gemv_kernels {
+  // y[i] = row i of A . x, for the m rows of A.
+  void (*dot_rows)(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y);
+  // y[j] = sum over i of x[i] * A(i, j), for j in [begin, end).
+  void (*update_rows)(size_t m, size_t begin, size_t end, const T* a, size_t lda, const T* x, T* y);
+};
+
+#if MATRIX_SIMD_X86
+
+// Bodies written once with GCC vector extensions, as in simd.h.
+template <class T, size_t Bytes>
+struct gemv_body {
+  typedef T vec __attribute__((vector_size(Bytes)));
+  typedef T unaligned_vec __attribute__((vector_size(Bytes), aligned(alignof(T)), may_alias));
+  static constexpr size_t LANES = Bytes / sizeof(T);
+
+  static inline __attribute__((always_inline)) const unaligned_vec& load(const T* p) {
+    return *reinterpret_cast<const unaligned_vec*>(p);
+  }
+
+  static inline __attribute__((always_inline)) void store(T* p, const vec& v) {
+    *reinterpret_cast<unaligned_vec*>(p) = v;
+  }
+
+  static inline __attribute__((always_inline)) T reduce(const vec& v) {
+    T sum = v[0];
+    for (size_t l = 1; l < LANES; ++l) {
+      sum += v[l];
+    }
+    return sum;
+  }
+
+  static inline __attribute__((always_inline)) void dot_rows(size_t m, size_t n, const T* a, size_t lda, const T* x,
+                                                              T* y) {
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4) {
+      const T* a0 = a + i * lda;
+      const T* a1 = a0 + lda;
+      const T* a2 = a1 + lda;
+      const T* a3 = a2 + lda;
+      vec s0 = {};
+      vec s1 = {};
+      vec s2 = {};
+      vec s3 = {};
+      size_t j = 0;
+      for (; j + LANES <= n; j += LANES) {
+        vec v = load(x + j);
+        s0 += load(a0 + j) * v;
+        s1 += load(a1 + j) * v;
+        s2 += load(a2 + j) * v;
+        s3 += load(a3 + j) * v;
+      }
+      T t0 = reduce(s0);
+      T t1 = reduce(s1);
+      T t2 = reduce(s2);
+      T t3 = reduce(s3);
+      for (; j < n; ++j) {
+        t0 += a0[j] * x[j];
+        t1 += a1[j] * x[j];
+        t2 += a2[j] * x[j];
+        t3 += a3[j] * x[j];
+      }
+      y[i] = t0;
+      y[i + 1] = t1;
+      y[i + 2] = t2;
+      y[i + 3] = t3;
+    }
+    for (; i < m; ++i) {
+      const T* row = a + i * lda;
+      vec s = {};
+      size_t j = 0;
+      for (; j + LANES <= n; j += LANES) {
+        s += load(row + j) * load(x + j);
+      }
+      T t = reduce(s);
+      for (; j < n; ++j) {
+        t += row[j] * x[j];
+      }
+      y[i] = t;
+    }
+  }
+
+  static inline __attribute__((always_inline)) void update_rows(size_t m, size_t begin, size_t end, const T* a,
+                                                                 size_t lda, const T* x, T* y) {
+    std::fill(y + begin, y + end, T(0));
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4) {
+      const T* a0 = a + i * lda;
+      const T* a1 = a0 + lda;
+      const T* a2 = a1 + lda;
+      const T* a3 = a2 + lda;
+      vec x0 = vec{} + x[i];
+      vec x1 = vec{} + x[i + 1];
+      vec x2 = vec{} + x[i + 2];
+      vec x3 = vec{} + x[i + 3];
+      size_t j = begin;
+      for (; j + LANES <= end; j += LANES) {
+        store(y + j, load(y + j) + x0 * load(a0 + j) + x1 * load(a1 + j) + x2 * load(a2 + j) + x3 * load(a3 + j));
+      }
+      for (; j < end; ++j) {
+        y[j] += x[i] * a0[j] + x[i + 1] * a1[j] + x[i + 2] * a2[j] + x[i + 3] * a3[j];
+      }
+    }
+    for (; i < m; ++i) {
+      const T* row = a + i * lda;
+      vec xi = vec{} + x[i];
+      size_t j = begin;
+      for (; j + LANES <= end; j += LANES) {
+        store(y + j, load(y + j) + xi * load(row + j));
+      }
+      for (; j < end; ++j) {
+        y[j] += x[i] * row[j];
+      }
+    }
+  }
+};
+
+#define MATRIX_GEMV_VARIANT(NAME, TARGET, BYTES)                                                                       \
+  template <class T>                                                                                                   \
+  struct gemv_##NAME {                                                                                                 \
+    __attribute__((target(TARGET))) static void dot_rows(size_t m, size_t n, const T* a, size_t lda, const T* x,       \
+                                                         T* y) {                                                       \
+      gemv_body<T, BYTES>::dot_rows(m, n, a, lda, x, y);                                                               \
+    }                                                                                                                  \
+    __attribute__((target(TARGET))) static void update_rows(size_t m, size_t begin, size_t end, const T* a,            \
+                                                            size_t lda, const T* x, T* y) {                            \
+      gemv_body<T, BYTES>::update_rows(m, begin, end, a, lda, x, y);                                                   \
+    }                                                                                                                  \
+  };
+
+MATRIX_GEMV_VARIANT(sse2, "sse2", 16)
+MATRIX_GEMV_VARIANT(avx2, "avx2", 32)
+MATRIX_GEMV_VARIANT(avx512, "avx512f", 64)
+
+#undef MATRIX_GEMV_VARIANT
+
+#endif
+
+template <class T>
+struct gemv_generic {
+  static void dot_rows(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y) {
+    for (size_t i = 0; i < m; ++i) {
+      const T* row = a + i * lda;
+      T sum = T();
+      for (size_t j = 0; j < n; ++j) {
+        sum += row[j] * x[j];
+      }
+      y[i] = sum;
+    }
+  }
+
+  static void update_rows(size_t m, size_t begin, size_t end, const T* a, size_t lda, const T* x, T* y) {
+    std::fill(y + begin, y + end, T());
+    for (size_t i = 0; i < m; ++i) {
+      const T* row = a + i * lda;
+      for (size_t j = begin; j < end; ++j) {
+        y[j] += x[i] * row[j];
+      }
+    }
+  }
+};
+
+template <template <class> class Variant, class T>
+constexpr gemv_kernels<T> make_gemv_kernels() {
+  return {&Variant<T>::dot_rows, &Variant<T>::update_rows};
+}
+
+template <class T>
+gemv_kernels<T> select_gemv_kernels(simd_level level) {
+#if MATRIX_SIMD_X86
+  switch (level) {
+  case simd_level::avx512:
+    return make_gemv_kernels<gemv_avx512, T>();
+  case simd_level::avx2:
+    return make_gemv_kernels<gemv_avx2, T>();
+  case simd_level::sse2:
+    return make_gemv_kernels<gemv_sse2, T>();
+  case simd_level::generic:
+    break;
+  }
+#else
+  (void)level;
+#endif
+  return make_gemv_kernels<gemv_generic, T>();
+}
+
+template <class T>
+gemv_kernels<T> dispatched_gemv_kernels() {
+  if constexpr (simd_vectorizable<T>) {
+    static const gemv_kernels<T> kernels = select_gemv_kernels<T>(cpu_simd_level());
+    return kernels;
+  } else {
+    return make_gemv_kernels<gemv_generic, T>();
+  }
+}
+
+// y = A x, where A is m x n, read through Layout with leading dimension lda.
+template <class Layout, class T>
+void gemv(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y) {
+  gemv_kernels<T> kernels = dispatched_gemv_kernels<T>();
+  if constexpr (std::is_same_v<Layout, row_major>) {
+    size_t blocks = (m + gemv_row_block - 1) / gemv_row_block;
+    parallel_for(blocks, m * n, [&](size_t b) {
+      size_t begin = b * gemv_row_block;
+      size_t rows = std::min(gemv_row_block, m - begin);
+      kernels.dot_rows(rows, n, a + begin * lda, lda, x, y + begin);
+    });
+  } else {
+    // The storage holds A^T row by row: n rows of m elements.
+    size_t blocks = (m + gemv_col_block - 1) / gemv_col_block;
+    parallel_for(blocks, m * n, [&](size_t b) {
+      size_t begin = b * gemv_col_block;
+      kernels.update_rows(n, begin, std::min(m, begin + gemv_col_block), a, lda, x, y);
+    });
+  }
+}
+
+} // namespace matrix_detail
+
+// y = A x. x must have a.cols() and y a.rows() elements (std::invalid_argument
+// is thrown otherwise).
+template <class M>
+  requires(matrix_detail::is_matrix_v<M> || matrix_detail::is_view_v<M>)
+void multiply(const M& a, std::span<const matrix_detail::gemv_value_t<M>> x,
+              std::span<matrix_detail::gemv_value_t<M>> y) {
+  if (x.size() != a.cols() || y.size() != a.rows()) {
+    throw std::invalid_argument("gemv: vector sizes do not match the matrix");
+  }
+  MATRIX_STATS_SCOPE(multiply);
+  MATRIX_STATS_FLOPS(2 * a.rows() * a.cols());
+  if (a.rows() == 0 || a.cols() == 0) {
+    return;
+  }
+  matrix_detail::gemv<matrix_detail::layout_of_t<M>>(a.rows(), a.cols(), a.data(), a.stride(), x.data(), y.data());
+}
+
+// y = A^T x. x must have a.rows() and y a.cols() elements (std::invalid_argument
+// is thrown otherwise).
+template <class M>
+  requires(matrix_detail::is_matrix_v<M> || matrix_detail::is_view_v<M>)
+void multiply_transposed(const M& a, std::span<const matrix_detail::gemv_value_t<M>> x,
+                         std::span<matrix_detail::gemv_value_t<M>> y) {
+  if (x.size() != a.rows() || y.size() != a.cols()) {
+    throw std::invalid_argument("gemv: vector sizes do not match the matrix");
+  }
+  MATRIX_STATS_SCOPE(multiply);
+  MATRIX_STATS_FLOPS(2 * a.rows() * a.cols());
+  if (a.rows() == 0 || a.cols() == 0) {
+    return;
+  }
+  matrix_detail::gemv<typename matrix_detail::layout_of_t<M>::transposed>(a.cols(), a.rows(), a.data(), a.stride(),
+                                                                          x.data(), y.data());
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+// Storage orders. In a row-major region with leading dimension ld, element
+// (row, col) is at row * ld + col; in a column-major one the roles of rows
+// and columns are swapped, so a column-major view of row-major storage is its
+// transpose.
+
+struct col_major;
+
+struct row_major {
+  using transposed = col_major;
+
+  static constexpr size_t offset(size_t row, size_t col, size_t ld) {
+    return row * ld + col;
+  }
+};
+
+struct col_major {
+  using transposed = row_major;
+
+  static constexpr size_t offset(size_t row, size_t col, size_t ld) {
+    return col * ld + row;
+  }
+};
@@ -0,0 +1,661 @@
+#pragma once
+
+#include "allocators.h"
+#include "gemm.h"
+#include "layout.h"
+#include "matrix-stats.h"
+#include "simd.h"
+#include "thread-pool.h"
+#include "transpose.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+// Expression templates for element-wise matrix arithmetic.
+//
+// operator+, operator- and scalar operator* do not compute anything: they
+// return lightweight nodes describing the expression, and the whole tree is
+// evaluated in a single fused pass when it is assigned to or used to
+// construct a matrix. Every node produces element (i, j) from element (i, j)
+// of its operands only, so evaluating into a matrix that also appears as an
+// operand is safe.
+//
+// Nodes are evaluated one row segment at a time. When every operand and the
+// destination are stored without padding, the whole matrix is treated as a
+// single row of rows() * cols() elements, so a segment spans row boundaries.
+//
+// Lvalue matrices and views (see matrix-view.h) are captured by pointer;
+// expiring matrices are moved into the node, so an expression may outlive the
+// full-expression that built it only if all its matrix operands were rvalues.
+// When the result is built from an expression that owns one of its operands,
+// that operand's buffer is reused for the result.
+//
+// An operand that overlaps the destination at a different position (say, two
+// overlapping blocks of one matrix) would be read after it was overwritten;
+// destinations check aliases() and evaluate through a temporary instead.
+//
+// Every node can also produce its transpose, a tree over the same operands
+// with rows and columns swapped. A column-major destination evaluates the
+// transposed tree into its storage as if it were row-major, so column-major
+// operands of a column-major result take the vectorized leaf kernels.
+
+template <class T, class Allocator = default_allocator<T>, class Layout = row_major>
+class matrix;
+
+template <class T, class Layout = row_major>
+class matrix_view;
+
+namespace matrix_detail {
+
+template <class X>
+struct is_matrix : std::false_type {};
+
+template <class T, class Allocator, class Layout>
+struct is_matrix<matrix<T, Allocator, Layout>> : std::true_type {};
+
+template <class X>
+inline constexpr bool is_matrix_v = is_matrix<std::remove_cvref_t<X>>::value;
+
+template <class X>
+struct is_view : std::false_type {};
+
+template <class T, class Layout>
+struct is_view<matrix_view<T, Layout>> : std::true_type {};
+
+template <class X>
+inline constexpr bool is_view_v = is_view<std::remove_cvref_t<X>>::value;
+
+// Storage order of a matrix or view operand.
+template <class X>
+struct layout_of {
+  using type = row_major;
+};
+
+template <class T, class Allocator, class Layout>
+struct layout_of<matrix<T, Allocator, Layout>> {
+  using type = Layout;
+};
+
+template <class T, class Layout>
+struct layout_of<matrix_view<T, Layout>> {
+  using type = Layout;
+};
+
+template <class X>
+using layout_of_t = typename layout_of<std::remove_cvref_t<X>>::type;
+
+struct expression_tag {};
+
+template <class X>
+inline constexpr bool is_expression_v = std::is_base_of_v<expression_tag, std::remove_cvref_t<X>>;
+
+template <class X>
+concept matrix_operand = is_matrix_v<X> || is_view_v<X> || is_expression_v<X>;
+
+// Whether the rows x cols regions starting at a and b, with the given row
+// strides, share an element. Exact for equal strides, conservative otherwise.
+template <class T>
+bool regions_overlap(const T* a, size_t a_rows, size_t a_cols, size_t a_stride, const T* b, size_t b_rows,
+                     size_t b_cols, size_t b_stride) {
+  if (a_rows == 0 || a_cols == 0 || b_rows == 0 || b_cols == 0) {
+    return false;
+  }
+  const T* a_end = a + (a_rows - 1) * a_stride + a_cols;
+  const T* b_end = b + (b_rows - 1) * b_stride + b_cols;
+  if (std::less_equal<const T*>()(a_end, b) || std::less_equal<const T*>()(b_end, a)) {
+    return false;
+  }
+  if (a_stride != b_stride) {
+    return true;
+  }
+  if (std::less<const T*>()(b, a)) {
+    std::swap(a, b);
+    std::swap(a_rows, b_rows);
+    std::swap(a_cols, b_cols);
+  }
+  // b starts row_offset rows and col_offset columns after a; its columns
+  // either line up with a's in the same row or wrap into the next one.
+  size_t offset = static_cast<size_t>(b - a);
+  size_t row_offset = offset / a_stride;
+  size_t col_offset = offset % a_stride;
+  return (col_offset < a_cols && row_offset < a_rows) ||
+         (b_cols > a_stride - col_offset && row_offset + 1 < a_rows);
+}
+
+template <class X>
+using operand_value_t = typename std::remove_cvref_t<X>::value_type;
+
+// Leaf referring to a matrix or view that outlives the expression. Only
+// row-major leaves expose rows as contiguous arrays (is_leaf) for the
+// vectorized kernels; column-major ones (transposes) are read element-wise.
+template <class T, class Layout = row_major>
+class ref_leaf : public expression_tag {
+public:
+  using value_type = T;
+  static constexpr bool is_leaf = std::is_same_v<Layout, row_major>;
+  // Arithmetic operations per element of the result.
+  static constexpr size_t operations = 0;
+
+  // From a matrix or a view.
+  template <class M>
+  explicit ref_leaf(const M& m) : _data(m.data()), _rows(m.rows()), _cols(m.cols()), _stride(m.stride()) {}
+
+  ref_leaf(const T* data, size_t rows, size_t cols, size_t stride)
+      : _data(data), _rows(rows), _cols(cols), _stride(stride) {}
+
+  size_t rows() const {
+    return _rows;
+  }
+
+  size_t cols() const {
+    return _cols;
+  }
+
+  bool contiguous() const {
+    return is_leaf && _stride == _cols;
+  }
+
+  const T* data() const {
+    return _data;
+  }
+
+  size_t stride() const {
+    return _stride;
+  }
+
+  const T& at(size_t row, size_t col) const {
+    return _data[Layout::offset(row, col, _stride)];
+  }
+
+  const T* row_data(size_t row) const
+    requires is_leaf
+  {
+    return _data + row * _stride;
+  }
+
+  void evaluate(T* out_row, size_t row, size_t begin, size_t end) const {
+    if constexpr (is_leaf) {
+      std::copy(row_data(row) + begin, row_data(row) + end, out_row + begin);
+    } else {
+      for (size_t col = begin; col < end; ++col) {
+        out_row[col] = at(row, col);
+      }
+    }
+  }
+
+  // Whether evaluating into the given region could overwrite an element of
+  // this operand before it is read. Reading the same position is fine.
+  bool aliases(const T* out, size_t rows, size_t cols, size_t stride) const {
+    if constexpr (is_leaf) {
+      if (out == _data && stride == _stride) {
+        return false;
+      }
+      return regions_overlap(_data, _rows, _cols, _stride, out, rows, cols, stride);
+    } else {
+      return regions_overlap(_data, _cols, _rows, _stride, out, rows, cols, stride);
+    }
+  }
+
+  template <class M>
+  M* reusable() {
+    return nullptr;
+  }
+
+  ref_leaf<T, typename Layout::transposed> transposed() const {
+    return ref_leaf<T, typename Layout::transposed>(_data, _cols, _rows, _stride);
+  }
+
+private:
+  const T* _data;
+  size_t _rows;
+  size_t _cols;
+  size_t _stride;
+};
+
+// Leaf owning an expiring matrix. Its transpose refers to the owned matrix,
+// so it must not outlive this node.
+template <class M>
+class owned_leaf : public expression_tag {
+  using layout = layout_of_t<M>;
+
+public:
+  using value_type = typename M::value_type;
+  static constexpr bool is_leaf = std::is_same_v<layout, row_major>;
+  static constexpr size_t operations = 0;
+
+  explicit owned_leaf(M&& m) : _m(std::move(m)) {}
+
+  size_t rows() const {
+    return _m.rows();
+  }
+
+  size_t cols() const {
+    return _m.cols();
+  }
+
+  bool contiguous() const {
+    return is_leaf && _m.contiguous();
+  }
+
+  const value_type& at(size_t row, size_t col) const {
+    return _m.data()[layout::offset(row, col, _m.stride())];
+  }
+
+  const value_type* row_data(size_t row) const
+    requires is_leaf
+  {
+    return _m.data() + row * _m.stride();
+  }
+
+  void evaluate(value_type* out_row, size_t row, size_t begin, size_t end) const {
+    if constexpr (is_leaf) {
+      std::copy(row_data(row) + begin, row_data(row) + end, out_row + begin);
+    } else {
+      for (size_t col = begin; col < end; ++col) {
+        out_row[col] = at(row, col);
+      }
+    }
+  }
+
+  bool aliases(const value_type*, size_t, size_t, size_t) const {
+    return false;
+  }
+
+  // The owned matrix, if the result being built is of the same type.
+  template <class Result>
+  Result* reusable() {
+    if constexpr (std::is_same_v<Result, M>) {
+      return &_m;
+    } else {
+      return nullptr;
+    }
+  }
+
+  ref_leaf<value_type, typename layout::transposed> transposed() const {
+    return ref_leaf<value_type, typename layout::transposed>(_m.data(), _m.cols(), _m.rows(), _m.stride());
+  }
+
+private:
+  M _m;
+};
+
+struct add_op {
+  template <class A, class B>
+  static auto apply(const A& a, const B& b) {
+    return a + b;
+  }
+
+  template <class T>
+  static void kernel(const T* a, const T* b, T* out, size_t n) {
+    elementwise_add(a, b, out, n);
+  }
+};
+
+struct sub_op {
+  template <class A, class B>
+  static auto apply(const A& a, const B& b) {
+    return a - b;
+  }
+
+  template <class T>
+  static void kernel(const T* a, const T* b, T* out, size_t n) {
+    elementwise_sub(a, b, out, n);
+  }
+};
+
+template <class Op, class L, class R>
+class binary_expr : public expression_tag {
+public:
+  using value_type = typename L::value_type;
+  static constexpr bool is_leaf = false;
+  static constexpr size_t operations = L::operations + R::operations + 1;
+
+  binary_expr(L left, R right) : _left(std::move(left)), _right(std::move(right)) {}
+
+  size_t rows() const {
+    return _left.rows();
+  }
+
+  size_t cols() const {
+    return _left.cols();
+  }
+
+  bool contiguous() const {
+    return _left.contiguous() && _right.contiguous();
+  }
+
+  value_type at(size_t row, size_t col) const {
+    return Op::apply(_left.at(row, col), _right.at(row, col));
+  }
+
+  // Writes columns [begin, end) of the given row to out_row. A single
+  // operation on two leaves goes straight to the vectorized kernel.
+  void evaluate(value_type* out_row, size_t row, size_t begin, size_t end) const {
+    if constexpr (L::is_leaf && R::is_leaf) {
+      Op::kernel(_left.row_data(row) + begin, _right.row_data(row) + begin, out_row + begin, end - begin);
+    } else {
+      for (size_t col = begin; col < end; ++col) {
+        out_row[col] = at(row, col);
+      }
+    }
+  }
+
+  bool aliases(const value_type* out, size_t rows, size_t cols, size_t stride) const {
+    return _left.aliases(out, rows, cols, stride) || _right.aliases(out, rows, cols, stride);
+  }
+
+  template <class M>
+  M* reusable() {
+    M* m = _left.template reusable<M>();
+    return m != nullptr ? m : _right.template reusable<M>();
+  }
+
+  auto transposed() const {
+    return binary_expr<Op, decltype(_left.transposed()), decltype(_right.transposed())>(_left.transposed(),
+                                                                                        _right.transposed());
+  }
+
+private:
+  L _left;
+  R _right;
+};
+
+template <class E>
+class scale_expr : public expression_tag {
+public:
+  using value_type = typename E::value_type;
+  static constexpr bool is_leaf = false;
+  static constexpr size_t operations = E::operations + 1;
+
+  scale_expr(E operand, const value_type& factor) : _operand(std::move(operand)), _factor(factor) {}
+
+  size_t rows() const {
+    return _operand.rows();
+  }
+
+  size_t cols() const {
+    return _operand.cols();
+  }
+
+  bool contiguous() const {
+    return _operand.contiguous();
+  }
+
+  value_type at(size_t row, size_t col) const {
+    return _operand.at(row, col) * _factor;
+  }
+
+  void evaluate(value_type* out_row, size_t row, size_t begin, size_t end) const {
+    if constexpr (E::is_leaf) {
+      elementwise_scale(_operand.row_data(row) + begin, _factor, out_row + begin, end - begin);
+    } else {
+      for (size_t col = begin; col < end; ++col) {
+        out_row[col] = at(row, col);
+      }
+    }
+  }
+
+  bool aliases(const value_type* out, size_t rows, size_t cols, size_t stride) const {
+    return _operand.aliases(out, rows, cols, stride);
+  }
+
+  template <class M>
+  M* reusable() {
+    return _operand.template reusable<M>();
+  }
+
+  auto transposed() const {
+    return scale_expr<decltype(_operand.transposed())>(_operand.transposed(), _factor);
+  }
+
+private:
+  E _operand;
+  value_type _factor;
+};
+
+// Node type an operand is stored as: lvalue matrices and views by reference,
+// rvalue matrices and nested expressions by value.
+template <class X>
+auto make_operand(X&& x) {
+  if constexpr (is_view_v<X>) {
+    return ref_leaf<operand_value_t<X>, layout_of_t<X>>(x);
+  } else if constexpr (is_matrix_v<X>) {
+    using T = operand_value_t<X>;
+    if constexpr (std::is_lvalue_reference_v<X>) {
+      return ref_leaf<T, layout_of_t<X>>(x);
+    } else {
+      return owned_leaf<std::remove_cvref_t<X>>(std::move(x));
+    }
+  } else {
+    return std::remove_cvref_t<X>(std::forward<X>(x));
+  }
+}
+
+template <class X>
+using operand_t = decltype(make_operand(std::declval<X>()));
+
+// Calls body(row, begin, end) for segments covering a rows x cols index
+// space; when flat, the space is treated as a single row.
+template <class F>
+void for_each_segment(size_t rows, size_t cols, bool flat, F&& body) {
+  if (flat) {
+    parallel_chunks(rows * cols, [&](size_t begin, size_t end) { body(size_t(0), begin, end); });
+  } else {
+    parallel_for(rows, rows * cols, [&](size_t row) { body(row, size_t(0), cols); });
+  }
+}
+
+// Evaluates e into out, whose rows start out_stride elements apart. A bare
+// transpose goes through the cache-oblivious kernel instead of row segments.
+template <class E>
+void evaluate(const E& e, typename E::value_type* out, size_t out_stride) {
+  if constexpr (std::is_same_v<E, ref_leaf<typename E::value_type, col_major>>) {
+    transpose_copy(e.cols(), e.rows(), e.data(), e.stride(), out, out_stride);
+  } else {
+    for_each_segment(e.rows(), e.cols(), e.contiguous() && out_stride == e.cols(),
+                     [&](size_t row, size_t begin, size_t end) {
+                       e.evaluate(out + row * out_stride, row, begin, end);
+                     });
+  }
+}
+
+// Passes matrices and views through and evaluates expressions into a
+// temporary.
+template <class X>
+decltype(auto) materialize(X&& x) {
+  if constexpr (is_matrix_v<X> || is_view_v<X>) {
+    return std::forward<X>(x);
+  } else {
+    return matrix<operand_value_t<X>>(std::forward<X>(x));
+  }
+}
+
+// Product of two materialized operands. Two matrices of the same type go
+// through matrix::operator*, which keeps the left operand's allocator and
+// layout; any other pair is read in place, whatever the layouts, and the
+// product returned as a matrix<T>.
+template <class L, class R>
+auto multiply_operands(const L& left, const R& right) {
+  if constexpr (is_matrix_v<L> && std::is_same_v<L, R>) {
+    return left * right;
+  } else {
+    MATRIX_STATS_SCOPE(multiply);
+    MATRIX_STATS_FLOPS(2 * left.rows() * right.cols() * left.cols());
+    matrix<operand_value_t<L>> m(left.rows(), right.cols());
+    gemm_parallel<layout_of_t<L>, layout_of_t<R>>(m.rows(), m.cols(), left.cols(), left.data(), left.stride(),
+                                                   right.data(), right.stride(), m.data(), m.stride());
+    return m;
+  }
+}
+
+// Destination of gemm, addmul and submul: a matrix or a mutable view, of
+// either layout.
+template <class X>
+concept gemm_output = (is_matrix_v<X> && !std::is_const_v<std::remove_reference_t<X>>) ||
+                      (is_view_v<X> && !std::is_const_v<typename std::remove_cvref_t<X>::element_type>);
+
+// Whether a materialized operand shares an element with the rows x cols
+// region at c.
+template <class X, class T>
+bool operand_overlaps(const X& x, const T* c, size_t rows, size_t cols, size_t ldc) {
+  if constexpr (std::is_same_v<layout_of_t<X>, row_major>) {
+    return regions_overlap<T>(x.data(), x.rows(), x.cols(), x.stride(), c, rows, cols, ldc);
+  } else {
+    return regions_overlap<T>(x.data(), x.cols(), x.rows(), x.stride(), c, rows, cols, ldc);
+  }
+}
+
+// C = beta * C for the rows x cols region at c. A beta of 0 clears C without
+// reading it, so NaNs in C do not survive.
+template <class T>
+void gemm_scale_output(T beta, T* c, size_t rows, size_t cols, size_t ldc) {
+  if (beta == T(1)) {
+    return;
+  }
+  for_each_segment(rows, cols, ldc == cols, [&](size_t row, size_t begin, size_t end) {
+    T* out = c + row * ldc;
+    if (beta == T(0)) {
+      std::fill(out + begin, out + end, T(0));
+    } else {
+      elementwise_scale_assign(out + begin, beta, end - begin);
+    }
+  });
+}
+
+inline void gemm_scale_output(gemm_unit, const void*, size_t, size_t, size_t) {}
+
+// A packed copy of a materialized operand, in its layout and whatever its
+// allocator.
+template <class X>
+auto copy_operand(const X& x) {
+  using T = operand_value_t<X>;
+  return matrix<T, default_allocator<T>, layout_of_t<X>>(make_operand(x));
+}
+
+// C = beta * C + alpha * A * B on materialized operands, where alpha and
+// beta are values of T or gemm_unit. An operand that shares storage with C
+// is copied first; otherwise nothing is allocated.
+template <class Alpha, class L, class R, class Beta, class T>
+void gemm_update(const Alpha& alpha, const L& left, const R& right, const Beta& beta, T* c, size_t ldc) {
+  size_t m = left.rows();
+  size_t n = right.cols();
+  if (operand_overlaps(left, c, m, n, ldc)) {
+    gemm_update(alpha, copy_operand(left), right, beta, c, ldc);
+    return;
+  }
+  if (operand_overlaps(right, c, m, n, ldc)) {
+    gemm_update(alpha, left, copy_operand(right), beta, c, ldc);
+    return;
+  }
+  gemm_scale_output(beta, c, m, n, ldc);
+  gemm_parallel<layout_of_t<L>, layout_of_t<R>>(m, n, left.cols(), left.data(), left.stride(), right.data(),
+                                                 right.stride(), c, ldc, alpha);
+}
+
+} // namespace matrix_detail
+
+template <class L, class R>
+  requires(matrix_detail::matrix_operand<L> && matrix_detail::matrix_operand<R> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<R>>)
+auto operator+(L&& left, R&& right) {
+  return matrix_detail::binary_expr<matrix_detail::add_op, matrix_detail::operand_t<L>, matrix_detail::operand_t<R>>(
+      matrix_detail::make_operand(std::forward<L>(left)), matrix_detail::make_operand(std::forward<R>(right)));
+}
+
+template <class L, class R>
+  requires(matrix_detail::matrix_operand<L> && matrix_detail::matrix_operand<R> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<R>>)
+auto operator-(L&& left, R&& right) {
+  return matrix_detail::binary_expr<matrix_detail::sub_op, matrix_detail::operand_t<L>, matrix_detail::operand_t<R>>(
+      matrix_detail::make_operand(std::forward<L>(left)), matrix_detail::make_operand(std::forward<R>(right)));
+}
+
+template <class E>
+  requires matrix_detail::matrix_operand<E>
+auto operator*(E&& e, const matrix_detail::operand_value_t<E>& factor) {
+  return matrix_detail::scale_expr<matrix_detail::operand_t<E>>(matrix_detail::make_operand(std::forward<E>(e)),
+                                                                  factor);
+}
+
+template <class E>
+  requires matrix_detail::matrix_operand<E>
+auto operator*(const matrix_detail::operand_value_t<E>& factor, E&& e) {
+  return std::forward<E>(e) * factor;
+}
+
+// A product needs its operands materialized; expressions are evaluated first.
+template <class L, class R>
+  requires(matrix_detail::matrix_operand<L> && matrix_detail::matrix_operand<R> &&
+           !(matrix_detail::is_matrix_v<L> && std::is_same_v<std::remove_cvref_t<L>, std::remove_cvref_t<R>>) &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<R>>)
+auto operator*(L&& left, R&& right) {
+  return matrix_detail::multiply_operands(matrix_detail::materialize(std::forward<L>(left)),
+                                          matrix_detail::materialize(std::forward<R>(right)));
+}
+
+// C = alpha * A * B + beta * C, accumulated in C's storage: no temporary is
+// built for the product or the scaled terms, unlike c = a * b * alpha + c *
+// beta. C must already be A.rows() x B.cols(); it may be a matrix or a
+// mutable view of either layout. A beta of 0 overwrites C without reading it.
+template <class L, class R, class C>
+  requires(matrix_detail::matrix_operand<L> && matrix_detail::matrix_operand<R> && matrix_detail::gemm_output<C> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<C>> &&
+           std::is_same_v<matrix_detail::operand_value_t<R>, matrix_detail::operand_value_t<C>>)
+void gemm(matrix_detail::operand_value_t<C> alpha, L&& a, R&& b, matrix_detail::operand_value_t<C> beta, C&& c) {
+  using T = matrix_detail::operand_value_t<C>;
+  decltype(auto) left = matrix_detail::materialize(std::forward<L>(a));
+  decltype(auto) right = matrix_detail::materialize(std::forward<R>(b));
+  if constexpr (std::is_same_v<matrix_detail::layout_of_t<C>, col_major>) {
+    // The storage of a column-major C is C^T = B^T A^T, row by row.
+    gemm(alpha, right.transpose(), left.transpose(), beta, c.transpose());
+  } else {
+    MATRIX_STATS_SCOPE(multiply);
+    MATRIX_STATS_FLOPS(2 * left.rows() * right.cols() * left.cols());
+    if (alpha == T(0)) {
+      matrix_detail::gemm_scale_output(beta, c.data(), c.rows(), c.cols(), c.stride());
+    } else if (alpha == T(1)) {
+      matrix_detail::gemm_update(matrix_detail::gemm_unit(), left, right, beta, c.data(), c.stride());
+    } else {
+      matrix_detail::gemm_update(alpha, left, right, beta, c.data(), c.stride());
+    }
+  }
+}
+
+// C += A * B, in place.
+template <class C, class L, class R>
+  requires(matrix_detail::matrix_operand<L> && matrix_detail::matrix_operand<R> && matrix_detail::gemm_output<C> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<C>> &&
+           std::is_same_v<matrix_detail::operand_value_t<R>, matrix_detail::operand_value_t<C>>)
+void addmul(C&& c, L&& a, R&& b) {
+  decltype(auto) left = matrix_detail::materialize(std::forward<L>(a));
+  decltype(auto) right = matrix_detail::materialize(std::forward<R>(b));
+  if constexpr (std::is_same_v<matrix_detail::layout_of_t<C>, col_major>) {
+    addmul(c.transpose(), right.transpose(), left.transpose());
+  } else {
+    MATRIX_STATS_SCOPE(multiply);
+    MATRIX_STATS_FLOPS(2 * left.rows() * right.cols() * left.cols());
+    matrix_detail::gemm_update(matrix_detail::gemm_unit(), left, right, matrix_detail::gemm_unit(), c.data(),
+                               c.stride());
+  }
+}
+
+// C -= A * B, in place.
+template <class C, class L, class R>
+  requires(matrix_detail::matrix_operand<L> && matrix_detail::matrix_operand<R> && matrix_detail::gemm_output<C> &&
+           std::is_same_v<matrix_detail::operand_value_t<L>, matrix_detail::operand_value_t<C>> &&
+           std::is_same_v<matrix_detail::operand_value_t<R>, matrix_detail::operand_value_t<C>>)
+void submul(C&& c, L&& a, R&& b) {
+  using T = matrix_detail::operand_value_t<C>;
+  decltype(auto) left = matrix_detail::materialize(std::forward<L>(a));
+  decltype(auto) right = matrix_detail::materialize(std::forward<R>(b));
+  if constexpr (std::is_same_v<matrix_detail::layout_of_t<C>, col_major>) {
+    submul(c.transpose(), right.transpose(), left.transpose());
+  } else {
+    MATRIX_STATS_SCOPE(multiply);
+    MATRIX_STATS_FLOPS(2 * left.rows() * right.cols() * left.cols());
+    matrix_detail::gemm_update(T(0) - T(1), left, right, matrix_detail::gemm_unit(), c.data(), c.stride());
+  }
+}
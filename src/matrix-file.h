@@ -0,0 +1,700 @@
+#pragma once
+
+#include "layout.h"
+#include "matrix-expr.h"
+#include "matrix-view.h"
+#include "transpose.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary matrix files.
+//
+// Matrices are stored in the NumPy .npy format, so files written here load
+// with numpy.load and the other way round. A file is
+//
+//   "\x93NUMPY", major and minor version bytes,
+//   header length (little-endian uint16 for version 1, uint32 for 2 and 3),
+//   header: a Python dict literal such as
+//     {'descr': '<i4', 'fortran_order': False, 'shape': (3, 4), }
+//   padded with spaces and a final '\n' so the data starts 64-byte aligned,
+//   rows * cols elements.
+//
+// 'descr' holds the byte order ('<' little, '>' big, '|' not applicable) and
+// the element kind and size: b1 for bool, i/u for signed and unsigned
+// integers, f for floating point. 'fortran_order' selects column-major
+// element order. The format has no stride, so padded matrices are written
+// packed; matrix::save always writes native byte order in the matrix's own
+// element order, and matrix::load accepts either byte and element order.
+//
+// mapped_matrix maps such a file read-only instead of reading it: opening
+// costs a page table update however large the file is, the contents are
+// paged in on first access, and processes mapping the same file share the
+// pages. Its element order must match the Layout parameter and its byte order
+// the machine's.
+//
+// Malformed files, element types not matching T and I/O failures throw
+// std::runtime_error.
+
+namespace matrix_detail {
+
+inline constexpr char npy_magic[] = "\x93NUMPY";
+inline constexpr size_t npy_magic_size = 6;
+inline constexpr size_t npy_alignment = 64;
+
+// Element kind ('b', 'i', 'u' or 'f') and size of T in the .npy format.
+template <class T>
+constexpr char npy_kind() {
+  static_assert(std::is_arithmetic_v<T>, "only arithmetic types can be stored in .npy files");
+  if constexpr (std::is_same_v<T, bool>) {
+    return 'b';
+  } else if constexpr (std::is_floating_point_v<T>) {
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "only float and double are supported");
+    return 'f';
+  } else {
+    return std::is_signed_v<T> ? 'i' : 'u';
+  }
+}
+
+inline char npy_native_order() {
+  return std::endian::native == std::endian::little ? '<' : '>';
+}
+
+struct npy_header {
+  char order = '|';
+  char kind = 0;
+  size_t item_size = 0;
+  bool fortran_order = false;
+  size_t rows = 0;
+  size_t cols = 0;
+  // Offset of the first element from the start of the file.
+  size_t data_offset = 0;
+
+  // Whether the elements are stored in the opposite byte order.
+  bool swapped() const {
+    return item_size > 1 && order != '|' && order != npy_native_order();
+  }
+
+  template <class T>
+  void check_type() const {
+    if (kind != npy_kind<T>() || item_size != sizeof(T)) {
+      throw std::runtime_error("matrix file: element type does not match");
+    }
+  }
+};
+
+[[noreturn]] inline void npy_malformed() {
+  throw std::runtime_error("matrix file: not a valid .npy file");
+}
+
+// Finds the value of 'key' in the header dict and returns the rest of it.
+inline std::string_view npy_value(std::string_view dict, std::string_view key) {
+  size_t pos = dict.find(key);
+  if (pos == std::string_view::npos) {
+    npy_malformed();
+  }
+  dict.remove_prefix(pos + key.size());
+  size_t colon = dict.find(':');
+  if (colon == std::string_view::npos) {
+    npy_malformed();
+  }
+  dict.remove_prefix(colon + 1);
+  while (!dict.empty() && dict.front() == ' ') {
+    dict.remove_prefix(1);
+  }
+  return dict;
+}
+
+inline size_t npy_parse_size(std::string_view& s) {
+  while (!s.empty() && s.front() == ' ') {
+    s.remove_prefix(1);
+  }
+  size_t value = 0;
+  auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), value);
+  if (error != std::errc()) {
+    npy_malformed();
+  }
+  s.remove_prefix(static_cast<size_t>(end - s.data()));
+  while (!s.empty() && s.front() == ' ') {
+    s.remove_prefix(1);
+  }
+  return value;
+}
+
+// Parses the preamble and header dict at the start of a file. `size` is the
+// number of bytes available; returns the number needed if it is too few.
+inline size_t npy_parse_header(const char* data, size_t size, npy_header& header) {
+  constexpr size_t PREAMBLE = npy_magic_size + 2;
+  if (size < PREAMBLE + 4) {
+    return PREAMBLE + 4;
+  }
+  if (std::memcmp(data, npy_magic, npy_magic_size) != 0) {
+    npy_malformed();
+  }
+  unsigned char major = static_cast<unsigned char>(data[npy_magic_size]);
+  auto byte = [&](size_t i) { return static_cast<size_t>(static_cast<unsigned char>(data[PREAMBLE + i])); };
+  size_t length;
+  size_t start;
+  if (major == 1) {
+    length = byte(0) | byte(1) << 8;
+    start = PREAMBLE + 2;
+  } else if (major == 2 || major == 3) {
+    length = byte(0) | byte(1) << 8 | byte(2) << 16 | byte(3) << 24;
+    start = PREAMBLE + 4;
+  } else {
+    throw std::runtime_error("matrix file: unsupported .npy version");
+  }
+  if (size < start + length) {
+    return start + length;
+  }
+
+  std::string_view dict(data + start, length);
+  std::string_view descr = npy_value(dict, "'descr'");
+  if (descr.size() < 4 || descr.front() != '\'') {
+    npy_malformed();
+  }
+  header.order = descr[1];
+  header.kind = descr[2];
+  descr.remove_prefix(3);
+  header.item_size = npy_parse_size(descr);
+  if (descr.empty() || descr.front() != '\'' || (header.order != '<' && header.order != '>' && header.order != '|')) {
+    throw std::runtime_error("matrix file: unsupported element type");
+  }
+
+  std::string_view order = npy_value(dict, "'fortran_order'");
+  if (order.starts_with("True")) {
+    header.fortran_order = true;
+  } else if (order.starts_with("False")) {
+    header.fortran_order = false;
+  } else {
+    npy_malformed();
+  }
+
+  std::string_view shape = npy_value(dict, "'shape'");
+  if (shape.empty() || shape.front() != '(') {
+    npy_malformed();
+  }
+  shape.remove_prefix(1);
+  header.rows = npy_parse_size(shape);
+  if (shape.empty() || shape.front() != ',') {
+    npy_malformed();
+  }
+  shape.remove_prefix(1);
+  header.cols = npy_parse_size(shape);
+  if (shape.empty() || shape.front() != ')') {
+    throw std::runtime_error("matrix file: only two-dimensional arrays are supported");
+  }
+
+  header.data_offset = start + length;
+  if (header.item_size == 0) {
+    npy_malformed();
+  }
+  size_t max_elements = (std::numeric_limits<size_t>::max() - header.data_offset) / header.item_size;
+  if (header.cols != 0 && header.rows > max_elements / header.cols) {
+    throw std::runtime_error("matrix file: array is too large");
+  }
+  return 0;
+}
+
+// Preamble and header of a file being written.
+struct npy_header_text {
+  char data[192];
+  size_t size = 0;
+
+  void append(std::string_view s) {
+    std::memcpy(data + size, s.data(), s.size());
+    size += s.size();
+  }
+
+  void append(size_t value) {
+    size = static_cast<size_t>(std::to_chars(data + size, data + sizeof(data), value).ptr - data);
+  }
+};
+
+// Builds the preamble and header for a rows x cols matrix of T, stored
+// row-major unless fortran_order.
+template <class T>
+npy_header_text npy_make_header(size_t rows, size_t cols, bool fortran_order = false) {
+  constexpr size_t PREAMBLE = npy_magic_size + 4;
+
+  npy_header_text text;
+  text.append(std::string_view(npy_magic, npy_magic_size));
+  text.append(std::string_view("\x01\x00\x00\x00", 4));
+  text.append("{'descr': '");
+  text.data[text.size++] = sizeof(T) == 1 ? '|' : npy_native_order();
+  text.data[text.size++] = npy_kind<T>();
+  text.append(sizeof(T));
+  text.append(fortran_order ? "', 'fortran_order': True, 'shape': (" : "', 'fortran_order': False, 'shape': (");
+  text.append(rows);
+  text.append(", ");
+  text.append(cols);
+  text.append("), }");
+
+  size_t total = (text.size + 1 + npy_alignment - 1) / npy_alignment * npy_alignment;
+  std::fill(text.data + text.size, text.data + total - 1, ' ');
+  text.data[total - 1] = '\n';
+  text.size = total;
+
+  size_t length = total - PREAMBLE;
+  text.data[npy_magic_size + 2] = static_cast<char>(length & 0xff);
+  text.data[npy_magic_size + 3] = static_cast<char>(length >> 8);
+  return text;
+}
+
+template <class T>
+void npy_byteswap(T* data, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    auto* bytes = reinterpret_cast<unsigned char*>(data + i);
+    std::reverse(bytes, bytes + sizeof(T));
+  }
+}
+
+// Files are written next to their destination and renamed over it when
+// complete, so an existing file that is mapped (see mapped_matrix) is
+// replaced rather than truncated under the mapping. The temporary name
+// carries the process id and a counter, so concurrent saves to the same
+// path, from threads or processes, each write their own file.
+inline std::filesystem::path npy_temp_path(const std::filesystem::path& path) {
+  static std::atomic<unsigned long long> counter{0};
+#ifdef _WIN32
+  unsigned long long process = GetCurrentProcessId();
+#else
+  unsigned long long process = static_cast<unsigned long long>(getpid());
+#endif
+  std::filesystem::path temp = path;
+  temp += "." + std::to_string(process) + "." + std::to_string(counter.fetch_add(1)) + ".tmp";
+  return temp;
+}
+
+inline void npy_discard(const std::filesystem::path& temp) {
+  std::error_code ignored;
+  std::filesystem::remove(temp, ignored);
+}
+
+// Writes rows x cols elements stored in Layout order with the given stride;
+// column-major storage is written as is, in Fortran order.
+template <class Layout = row_major, class T>
+void npy_save(const std::filesystem::path& path, const T* data, size_t rows, size_t cols, size_t stride) {
+  constexpr bool fortran_order = std::is_same_v<Layout, col_major>;
+  size_t lines = fortran_order ? cols : rows;
+  size_t length = fortran_order ? rows : cols;
+  std::filesystem::path temp = npy_temp_path(path);
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    npy_header_text header = npy_make_header<T>(rows, cols, fortran_order);
+    out.write(header.data, static_cast<std::streamsize>(header.size));
+    if (stride == length) {
+      out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(rows * cols * sizeof(T)));
+    } else {
+      for (size_t i = 0; i < lines; ++i) {
+        out.write(reinterpret_cast<const char*>(data + i * stride), static_cast<std::streamsize>(length * sizeof(T)));
+      }
+    }
+    out.close();
+    if (!out) {
+      npy_discard(temp);
+      throw std::runtime_error("matrix file: cannot write " + path.string());
+    }
+  }
+  std::filesystem::rename(temp, path);
+}
+
+// Reads an .npy file: the header on construction, the elements by read().
+class npy_reader {
+public:
+  explicit npy_reader(const std::filesystem::path& path) : _in(path, std::ios::binary) {
+    if (!_in) {
+      throw std::runtime_error("matrix file: cannot open " + path.string());
+    }
+    char preamble[12];
+    _in.read(preamble, sizeof(preamble));
+    if (!_in) {
+      npy_malformed();
+    }
+    size_t size = npy_parse_header(preamble, sizeof(preamble), _header);
+    std::unique_ptr<char[]> header(new char[size]);
+    std::memcpy(header.get(), preamble, sizeof(preamble));
+    _in.read(header.get() + sizeof(preamble), static_cast<std::streamsize>(size - sizeof(preamble)));
+    if (!_in || npy_parse_header(header.get(), size, _header) != 0) {
+      npy_malformed();
+    }
+  }
+
+  const npy_header& header() const {
+    return _header;
+  }
+
+  size_t rows() const {
+    return _header.rows;
+  }
+  size_t cols() const {
+    return _header.cols;
+  }
+
+  // Reads the rows x cols elements into out, a destination in Layout order
+  // with the given stride. Data in the other order is transposed on the way.
+  template <class Layout = row_major, class T>
+  void read(T* out, size_t stride) {
+    _header.check_type<T>();
+    size_t rows = _header.rows;
+    size_t cols = _header.cols;
+    if (rows == 0 || cols == 0) {
+      return;
+    }
+
+    // Lines of the destination, and their length.
+    constexpr bool by_cols = std::is_same_v<Layout, col_major>;
+    size_t lines = by_cols ? cols : rows;
+    size_t length = by_cols ? rows : cols;
+    if (_header.fortran_order == by_cols && stride == length) {
+      read_elements(out, rows * cols);
+    } else if (_header.fortran_order == by_cols) {
+      for (size_t i = 0; i < lines; ++i) {
+        read_elements(out + i * stride, length);
+      }
+    } else {
+      // The file holds the transpose of the destination's storage.
+      std::unique_ptr<T[]> buffer(new T[rows * cols]);
+      read_elements(buffer.get(), rows * cols);
+      transpose_copy(length, lines, buffer.get(), lines, out, stride);
+    }
+  }
+
+  // Reads the rows x cols block at (row, col) of a row-major file into out,
+  // seeking to each of its rows.
+  template <class T>
+  void read_block(size_t row, size_t col, size_t rows, size_t cols, T* out, size_t stride) {
+    _header.check_type<T>();
+    if (_header.fortran_order) {
+      throw std::runtime_error("matrix file: blocks can only be read from row-major files");
+    }
+    for (size_t i = 0; i < rows; ++i) {
+      _in.seekg(static_cast<std::streamoff>(_header.data_offset + ((row + i) * _header.cols + col) * sizeof(T)));
+      read_elements(out + i * stride, cols);
+    }
+  }
+
+private:
+  template <class T>
+  void read_elements(T* out, size_t count) {
+    _in.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(count * sizeof(T)));
+    if (!_in) {
+      throw std::runtime_error("matrix file: unexpected end of file");
+    }
+    if (_header.swapped()) {
+      npy_byteswap(out, count);
+    }
+  }
+
+  std::ifstream _in;
+  npy_header _header;
+};
+
+// Creates a zero-filled .npy file of rows x cols elements and writes it
+// block by block, in any order. The file appears at `path` on close(); until
+// then any existing file there is left untouched.
+template <class T>
+class npy_block_writer {
+public:
+  npy_block_writer(const std::filesystem::path& path, size_t rows, size_t cols)
+      : _path(path), _temp(npy_temp_path(path)), _cols(cols) {
+    npy_header_text header = npy_make_header<T>(rows, cols);
+    _data_offset = header.size;
+    {
+      std::ofstream out(_temp, std::ios::binary | std::ios::trunc);
+      out.write(header.data, static_cast<std::streamsize>(header.size));
+      if (!out) {
+        throw std::runtime_error("matrix file: cannot write " + path.string());
+      }
+    }
+    std::filesystem::resize_file(_temp, _data_offset + rows * cols * sizeof(T));
+    _out.open(_temp, std::ios::binary | std::ios::in | std::ios::out);
+    if (!_out) {
+      npy_discard(_temp);
+      throw std::runtime_error("matrix file: cannot write " + path.string());
+    }
+  }
+
+  npy_block_writer(const npy_block_writer&) = delete;
+  npy_block_writer& operator=(const npy_block_writer&) = delete;
+
+  // An unfinished file is removed.
+  ~npy_block_writer() {
+    if (_out.is_open()) {
+      _out.close();
+      npy_discard(_temp);
+    }
+  }
+
+  // Writes the rows x cols block at (row, col) from in.
+  void write_block(size_t row, size_t col, size_t rows, size_t cols, const T* in, size_t stride) {
+    for (size_t i = 0; i < rows; ++i) {
+      _out.seekp(static_cast<std::streamoff>(_data_offset + ((row + i) * _cols + col) * sizeof(T)));
+      _out.write(reinterpret_cast<const char*>(in + i * stride), static_cast<std::streamsize>(cols * sizeof(T)));
+    }
+    if (!_out) {
+      throw std::runtime_error("matrix file: write failed");
+    }
+  }
+
+  void close() {
+    _out.close();
+    if (!_out) {
+      npy_discard(_temp);
+      throw std::runtime_error("matrix file: write failed");
+    }
+    std::filesystem::rename(_temp, _path);
+  }
+
+private:
+  std::filesystem::path _path;
+  std::filesystem::path _temp;
+  std::fstream _out;
+  size_t _cols;
+  size_t _data_offset;
+};
+
+// A whole file mapped read-only into memory.
+class mapped_file {
+public:
+  mapped_file() = default;
+
+  explicit mapped_file(const std::filesystem::path& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      throw std::runtime_error("matrix file: cannot open " + path.string());
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+      CloseHandle(file);
+      throw std::runtime_error("matrix file: cannot open " + path.string());
+    }
+    _size = static_cast<size_t>(size.QuadPart);
+    if (_size != 0) {
+      HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping != nullptr) {
+        _data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(file);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("matrix file: cannot open " + path.string());
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("matrix file: cannot open " + path.string());
+    }
+    _size = static_cast<size_t>(st.st_size);
+    if (_size != 0) {
+      void* data = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+      _data = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+    }
+    ::close(fd);
+#endif
+    if (_size != 0 && _data == nullptr) {
+      throw std::runtime_error("matrix file: cannot map " + path.string());
+    }
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  mapped_file(mapped_file&& other) noexcept
+      : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)) {}
+
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      _data = std::exchange(other._data, nullptr);
+      _size = std::exchange(other._size, 0);
+    }
+    return *this;
+  }
+
+  ~mapped_file() {
+    unmap();
+  }
+
+  const char* data() const {
+    return _data;
+  }
+  size_t size() const {
+    return _size;
+  }
+
+private:
+  void unmap() {
+    if (_data == nullptr) {
+      return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+#else
+    ::munmap(const_cast<char*>(_data), _size);
+#endif
+    _data = nullptr;
+  }
+
+  const char* _data = nullptr;
+  size_t _size = 0;
+};
+
+} // namespace matrix_detail
+
+// Read-only matrix whose elements are the contents of a mapped .npy file.
+// Stays valid while the object lives, even if the file is replaced by a
+// rename, as save() and multiply_files do. Rewriting the file in place by
+// other means truncates it under the mapping.
+template <class T, class Layout = row_major>
+class mapped_matrix {
+  using view_type = const_matrix_view<T, Layout>;
+
+public:
+  using value_type = T;
+  using layout_type = Layout;
+
+  using const_reference = const T&;
+  using const_pointer = const T*;
+
+  using const_row_iterator = typename view_type::row_iterator;
+  using const_col_iterator = typename view_type::col_iterator;
+
+  mapped_matrix() = default;
+
+  explicit mapped_matrix(const std::filesystem::path& path) : _file(path) {
+    matrix_detail::npy_header header;
+    if (matrix_detail::npy_parse_header(_file.data(), _file.size(), header) != 0) {
+      matrix_detail::npy_malformed();
+    }
+    header.check_type<T>();
+    if (header.fortran_order != std::is_same_v<Layout, col_major>) {
+      throw std::runtime_error("matrix file: element order does not match the layout");
+    }
+    if (header.swapped()) {
+      throw std::runtime_error("matrix file: byte order does not match the machine");
+    }
+    if (header.data_offset % alignof(T) != 0) {
+      throw std::runtime_error("matrix file: elements are misaligned");
+    }
+    size_t available = (_file.size() - header.data_offset) / sizeof(T);
+    if (header.cols != 0 && header.rows > available / header.cols) {
+      throw std::runtime_error("matrix file: unexpected end of file");
+    }
+    _rows = header.rows;
+    _cols = header.cols;
+    _data = _rows == 0 || _cols == 0 ? nullptr : reinterpret_cast<const T*>(_file.data() + header.data_offset);
+  }
+
+  mapped_matrix(mapped_matrix&& other) noexcept
+      : _file(std::move(other._file)), _data(std::exchange(other._data, nullptr)),
+        _rows(std::exchange(other._rows, 0)), _cols(std::exchange(other._cols, 0)) {}
+
+  mapped_matrix& operator=(mapped_matrix&& other) noexcept {
+    if (this != &other) {
+      _file = std::move(other._file);
+      _data = std::exchange(other._data, nullptr);
+      _rows = std::exchange(other._rows, 0);
+      _cols = std::exchange(other._cols, 0);
+    }
+    return *this;
+  }
+
+  // Size
+
+  size_t rows() const {
+    return _rows;
+  }
+  size_t cols() const {
+    return _cols;
+  }
+  size_t size() const {
+    return _rows * _cols;
+  }
+  bool empty() const {
+    return _rows == 0 || _cols == 0;
+  }
+  size_t stride() const {
+    return std::is_same_v<Layout, row_major> ? _cols : _rows;
+  }
+
+  // Elements access
+
+  const_reference operator()(size_t row, size_t col) const {
+    return _data[Layout::offset(row, col, stride())];
+  }
+
+  const_pointer data() const {
+    return _data;
+  }
+
+  // The mapped elements as a view, usable as an operand of any matrix
+  // operation; matrix<T>(m.view()) copies them into memory.
+  view_type view() const {
+    return view_type(_data, _rows, _cols, stride());
+  }
+
+  // Iterators
+
+  const_pointer begin() const {
+    return _data;
+  }
+  const_pointer end() const {
+    return _data + size();
+  }
+
+  const_row_iterator row_begin(size_t row) const {
+    return view().row_begin(row);
+  }
+  const_row_iterator row_end(size_t row) const {
+    return view().row_end(row);
+  }
+
+  const_col_iterator col_begin(size_t col) const {
+    return view().col_begin(col);
+  }
+  const_col_iterator col_end(size_t col) const {
+    return view().col_end(col);
+  }
+
+private:
+  matrix_detail::mapped_file _file;
+  const T* _data = nullptr;
+  size_t _rows = 0;
+  size_t _cols = 0;
+};
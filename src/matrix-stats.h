@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Optional instrumentation of the public matrix operations.
+//
+// Compiled out unless MATRIX_ENABLE_STATS is defined (for the whole program,
+// e.g. -DMATRIX_ENABLE_STATS or the CMake option of the same name), in which
+// case every call of an operation in matrix.h is counted with its heap
+// allocations, bytes allocated and copied, arithmetic operations and wall
+// time:
+//
+//   matrix_stats::reset();
+//   run_workload();
+//   matrix_stats::report(std::cerr);
+//
+// Allocations, copies and FLOPs are charged to the outermost operation
+// running on the thread, the one the caller wrote: the result allocated
+// inside a product shows up under multiply, not construct. Nested operations
+// still count as calls, and wall time is inclusive of them. Counters are
+// atomic, so operations may run on any thread.
+//
+// Without MATRIX_ENABLE_STATS the API is still there but every counter
+// stays zero, and the hooks in matrix.h expand to nothing.
+
+namespace matrix_stats {
+
+#ifdef MATRIX_ENABLE_STATS
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+enum class op : unsigned char {
+  construct,  // Construction from a shape or an initializer
+  copy,       // Copy construction and copy assignment
+  move,       // Move construction and move assignment
+  evaluate,   // Construction from or assignment of an expression or a view
+  add_assign, // operator+=
+  sub_assign, // operator-=
+  scale,      // operator*= with a scalar
+  multiply,   // Matrix products, including operator*=, and GEMV
+  compare,    // operator== and operator!=
+  transpose,  // transpose_in_place
+  file,       // save and load
+};
+
+inline constexpr size_t op_count = 11;
+
+struct op_stats {
+  std::uint64_t calls = 0;
+  std::uint64_t allocations = 0;
+  std::uint64_t bytes_allocated = 0;
+  std::uint64_t bytes_copied = 0;
+  std::uint64_t flops = 0;
+  std::uint64_t nanoseconds = 0;
+};
+
+inline const char* name(op o) {
+  constexpr const char* NAMES[op_count] = {"construct", "copy",     "move",    "evaluate",  "add_assign", "sub_assign",
+                                           "scale",     "multiply", "compare", "transpose", "file"};
+  return NAMES[static_cast<size_t>(o)];
+}
+
+} // namespace matrix_stats
+
+namespace matrix_detail {
+
+struct stats_counters {
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> allocations{0};
+  std::atomic<std::uint64_t> bytes_allocated{0};
+  std::atomic<std::uint64_t> bytes_copied{0};
+  std::atomic<std::uint64_t> flops{0};
+  std::atomic<std::uint64_t> nanoseconds{0};
+};
+
+inline stats_counters* stats_table() {
+  static stats_counters table[matrix_stats::op_count];
+  return table;
+}
+
+// Counters of the outermost operation running on this thread, if any.
+inline stats_counters*& stats_current() {
+  static thread_local stats_counters* current = nullptr;
+  return current;
+}
+
+// Marks the extent of one call of an operation.
+class stats_scope {
+public:
+  explicit stats_scope(matrix_stats::op o)
+      : _counters(stats_table() + static_cast<size_t>(o)), _outermost(stats_current() == nullptr),
+        _start(std::chrono::steady_clock::now()) {
+    _counters->calls.fetch_add(1, std::memory_order_relaxed);
+    if (_outermost) {
+      stats_current() = _counters;
+    }
+  }
+
+  stats_scope(const stats_scope&) = delete;
+  stats_scope& operator=(const stats_scope&) = delete;
+
+  ~stats_scope() {
+    auto elapsed = std::chrono::steady_clock::now() - _start;
+    _counters->nanoseconds.fetch_add(
+        static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+        std::memory_order_relaxed);
+    if (_outermost) {
+      stats_current() = nullptr;
+    }
+  }
+
+private:
+  stats_counters* _counters;
+  bool _outermost;
+  std::chrono::steady_clock::time_point _start;
+};
+
+inline void stats_add(std::atomic<std::uint64_t> stats_counters::*counter, std::uint64_t value) {
+  if (stats_counters* current = stats_current()) {
+    (current->*counter).fetch_add(value, std::memory_order_relaxed);
+  }
+}
+
+} // namespace matrix_detail
+
+#ifdef MATRIX_ENABLE_STATS
+#define MATRIX_STATS_SCOPE(o) ::matrix_detail::stats_scope matrix_stats_scope_(::matrix_stats::op::o)
+#define MATRIX_STATS_ALLOCATION(bytes)                                                                                 \
+  (::matrix_detail::stats_add(&::matrix_detail::stats_counters::allocations, 1),                                       \
+   ::matrix_detail::stats_add(&::matrix_detail::stats_counters::bytes_allocated, (bytes)))
+#define MATRIX_STATS_COPY(bytes) ::matrix_detail::stats_add(&::matrix_detail::stats_counters::bytes_copied, (bytes))
+#define MATRIX_STATS_FLOPS(count) ::matrix_detail::stats_add(&::matrix_detail::stats_counters::flops, (count))
+#else
+#define MATRIX_STATS_SCOPE(o) static_cast<void>(0)
+#define MATRIX_STATS_ALLOCATION(bytes) static_cast<void>(0)
+#define MATRIX_STATS_COPY(bytes) static_cast<void>(0)
+#define MATRIX_STATS_FLOPS(count) static_cast<void>(0)
+#endif
+
+namespace matrix_stats {
+
+// Totals for one operation since the last reset().
+inline op_stats get(op o) {
+  const matrix_detail::stats_counters& c = matrix_detail::stats_table()[static_cast<size_t>(o)];
+  op_stats s;
+  s.calls = c.calls.load(std::memory_order_relaxed);
+  s.allocations = c.allocations.load(std::memory_order_relaxed);
+  s.bytes_allocated = c.bytes_allocated.load(std::memory_order_relaxed);
+  s.bytes_copied = c.bytes_copied.load(std::memory_order_relaxed);
+  s.flops = c.flops.load(std::memory_order_relaxed);
+  s.nanoseconds = c.nanoseconds.load(std::memory_order_relaxed);
+  return s;
+}
+
+inline void reset() {
+  for (size_t i = 0; i < op_count; ++i) {
+    matrix_detail::stats_counters& c = matrix_detail::stats_table()[i];
+    c.calls.store(0, std::memory_order_relaxed);
+    c.allocations.store(0, std::memory_order_relaxed);
+    c.bytes_allocated.store(0, std::memory_order_relaxed);
+    c.bytes_copied.store(0, std::memory_order_relaxed);
+    c.flops.store(0, std::memory_order_relaxed);
+    c.nanoseconds.store(0, std::memory_order_relaxed);
+  }
+}
+
+// Writes one line per operation that was called.
+inline void report(std::ostream& out) {
+  for (size_t i = 0; i < op_count; ++i) {
+    op_stats s = get(static_cast<op>(i));
+    if (s.calls == 0) {
+      continue;
+    }
+    out << name(static_cast<op>(i)) << ": calls=" << s.calls << " allocations=" << s.allocations
+        << " bytes_allocated=" << s.bytes_allocated << " bytes_copied=" << s.bytes_copied << " flops=" << s.flops
+        << " ms=" << static_cast<double>(s.nanoseconds) * 1e-6 << '\n';
+  }
+}
+
+} // namespace matrix_stats
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "matrix-expr.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <type_traits>
+#include <vector>
+
+// Text input and output of matrices.
+//
+// A matrix is written as one line per row, elements separated by a
+// delimiter:
+//
+//   1 2 3
+//   4 5 6
+//
+// Numbers are formatted with std::to_chars (floating point in the shortest
+// form that reads back to the same value) into a local buffer that is handed
+// to the stream in large blocks, and parsed with std::from_chars straight off
+// the stream buffer, so neither direction goes through the formatted
+// iostream machinery or flushes per row.
+//
+// When reading, the number of columns is taken from the first row and the
+// matrix ends at an empty line or the end of the stream; leading empty lines
+// are skipped. Besides the delimiter, spaces, tabs and '\r' separate fields,
+// so files with CRLF line ends or padded CSV read fine. Rows of different
+// lengths or fields that are not numbers set failbit and leave the matrix
+// unchanged.
+//
+// operator<< and operator>> use text_format{} (space-delimited);
+// write_text and read_text take a text_format, e.g. text_format::csv().
+
+struct text_format {
+  char delimiter = ' ';
+
+  static constexpr text_format csv() {
+    return {','};
+  }
+  static constexpr text_format tsv() {
+    return {'\t'};
+  }
+};
+
+namespace matrix_detail {
+
+// Types formatted and parsed with to_chars and from_chars. Others are
+// written with their operator<< and cannot be read.
+template <class T>
+inline constexpr bool text_convertible = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+// Output buffer that writes to the stream whenever it fills up.
+class text_writer {
+public:
+  explicit text_writer(std::ostream& out) : _out(out) {}
+
+  text_writer(const text_writer&) = delete;
+  text_writer& operator=(const text_writer&) = delete;
+
+  ~text_writer() {
+    flush();
+  }
+
+  template <class T>
+  void write(const T& value) {
+    if constexpr (text_convertible<T>) {
+      if (_size + MAX_NUMBER > SIZE) {
+        flush();
+      }
+      _size = static_cast<size_t>(std::to_chars(_buffer + _size, _buffer + SIZE, value).ptr - _buffer);
+    } else {
+      flush();
+      _out << value;
+    }
+  }
+
+  void put(char c) {
+    if (_size == SIZE) {
+      flush();
+    }
+    _buffer[_size++] = c;
+  }
+
+  void flush() {
+    _out.write(_buffer, static_cast<std::streamsize>(_size));
+    _size = 0;
+  }
+
+private:
+  static constexpr size_t SIZE = 1 << 16;
+  // Longest output of to_chars for any supported type.
+  static constexpr size_t MAX_NUMBER = 64;
+
+  std::ostream& _out;
+  size_t _size = 0;
+  char _buffer[SIZE];
+};
+
+inline bool text_separator(int c, char delimiter) {
+  return c == delimiter || c == ' ' || c == '\t' || c == '\r';
+}
+
+// Parses rows of numbers from in until an empty line or the end of the
+// stream. Returns false on malformed input.
+template <class T>
+bool read_text_values(std::istream& in, char delimiter, std::vector<T>& values, size_t& rows, size_t& cols) {
+  constexpr int END = std::char_traits<char>::eof();
+  // Long enough for any number from_chars accepts in practice; longer
+  // tokens are rejected.
+  constexpr size_t TOKEN = 128;
+
+  std::streambuf* buffer = in.rdbuf();
+  char token[TOKEN];
+  size_t fields = 0;
+  rows = 0;
+  cols = 0;
+
+  while (true) {
+    int c = buffer->sgetc();
+    if (c == END || c == '\n') {
+      if (c == '\n') {
+        buffer->sbumpc();
+      }
+      if (fields != 0) {
+        if (rows == 0) {
+          cols = fields;
+        } else if (fields != cols) {
+          return false;
+        }
+        ++rows;
+        fields = 0;
+      } else if (rows != 0 || c == END) {
+        return true;
+      }
+      if (c == END) {
+        return true;
+      }
+      continue;
+    }
+    if (text_separator(c, delimiter)) {
+      buffer->sbumpc();
+      continue;
+    }
+
+    size_t length = 0;
+    while (c != END && c != '\n' && !text_separator(c, delimiter)) {
+      if (length == TOKEN) {
+        return false;
+      }
+      token[length++] = static_cast<char>(c);
+      c = buffer->snextc();
+    }
+    const char* begin = token;
+    // from_chars does not accept the leading '+' that other writers emit.
+    if (length > 1 && token[0] == '+') {
+      ++begin;
+    }
+    T value;
+    auto [end, error] = std::from_chars(begin, token + length, value);
+    if (error != std::errc() || end != token + length) {
+      return false;
+    }
+    values.push_back(value);
+    ++fields;
+  }
+}
+
+} // namespace matrix_detail
+
+// Writes m as text, one line per row.
+template <class M>
+  requires(matrix_detail::is_matrix_v<M> || matrix_detail::is_view_v<M>)
+std::ostream& write_text(std::ostream& out, const M& m, text_format format = {}) {
+  matrix_detail::text_writer writer(out);
+  for (size_t i = 0; i < m.rows(); ++i) {
+    auto it = m.row_begin(i);
+    for (size_t j = 0; j < m.cols(); ++j, ++it) {
+      if (j != 0) {
+        writer.put(format.delimiter);
+      }
+      writer.write(*it);
+    }
+    writer.put('\n');
+  }
+  return out;
+}
+
+// Reads a matrix written by write_text (or any delimited text) into m.
+template <class T, class Allocator, class Layout>
+  requires matrix_detail::text_convertible<T>
+std::istream& read_text(std::istream& in, matrix<T, Allocator, Layout>& m, text_format format = {}) {
+  std::istream::sentry sentry(in, true);
+  if (!sentry) {
+    return in;
+  }
+
+  std::vector<T> values;
+  values.reserve(256);
+  size_t rows;
+  size_t cols;
+  if (!matrix_detail::read_text_values(in, format.delimiter, values, rows, cols)) {
+    in.setstate(std::ios::failbit);
+    return in;
+  }
+  if (rows == 0) {
+    in.setstate(std::ios::failbit | std::ios::eofbit);
+    return in;
+  }
+
+  matrix<T, Allocator, Layout> result(rows, cols, m.get_allocator());
+  for (size_t i = 0; i < rows; ++i) {
+    std::copy_n(values.data() + i * cols, cols, result.row_begin(i));
+  }
+  m = std::move(result);
+  if (in.rdbuf()->sgetc() == std::char_traits<char>::eof()) {
+    in.setstate(std::ios::eofbit);
+  }
+  return in;
+}
+
+template <class T, class Allocator, class Layout>
+std::ostream& operator<<(std::ostream& out, const matrix<T, Allocator, Layout>& m) {
+  return write_text(out, m);
+}
+
+template <class T, class Layout>
+std::ostream& operator<<(std::ostream& out, const matrix_view<T, Layout>& v) {
+  return write_text(out, v);
+}
+
+template <class T, class Allocator, class Layout>
+  requires matrix_detail::text_convertible<T>
+std::istream& operator>>(std::istream& in, matrix<T, Allocator, Layout>& m) {
+  return read_text(in, m);
+}
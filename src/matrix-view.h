@@ -0,0 +1,216 @@
+#pragma once
+
+#include "layout.h"
+#include "matrix-expr.h"
+#include "simd.h"
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Non-owning strided views into matrix storage.
+//
+// A view is a pointer, a shape and a row stride, so taking a block, a row or
+// a column of a matrix copies nothing:
+//
+//   matrix<double> m(8, 8);
+//   m.block(0, 0, 4, 4) += m.block(4, 4, 4, 4);
+//   matrix<double> r = m.row(2) * 3.0;
+//
+// Views are usable wherever a matrix is as an operand. A view of mutable
+// elements can also be written through: assignment copies elements into the
+// viewed region rather than rebinding the view, like the compound operators
+// do. Sources overlapping the region at other positions are detected and go
+// through a temporary. A view must not outlive the matrix it refers to.
+//
+// transpose() is lazy as well: it flips the layout (see layout.h) of a view
+// over the same storage, and products recognize the column-major operand
+// instead of copying it. Writes through a column-major view evaluate the
+// transposed expression through the row-major view of the same storage.
+
+template <class T>
+class ColIterator;
+
+template <class T, class Layout>
+class matrix_view {
+  static constexpr bool by_rows = std::is_same_v<Layout, row_major>;
+
+public:
+  using value_type = std::remove_const_t<T>;
+  using element_type = T;
+  using layout_type = Layout;
+
+  using reference = T&;
+  using const_reference = const T&;
+
+  using pointer = T*;
+  using const_pointer = const T*;
+
+  // Whichever of rows and columns is contiguous in the layout is walked by
+  // pointer, the other one by a strided ColIterator.
+  using row_iterator = std::conditional_t<by_rows, pointer, ColIterator<T>>;
+  using const_row_iterator = row_iterator;
+
+  using col_iterator = std::conditional_t<by_rows, ColIterator<T>, pointer>;
+  using const_col_iterator = col_iterator;
+
+  matrix_view() = default;
+
+  matrix_view(pointer data, size_t rows, size_t cols, size_t stride)
+      : _data(rows > 0 && cols > 0 ? data : nullptr), _rows(rows > 0 && cols > 0 ? rows : 0),
+        _cols(rows > 0 && cols > 0 ? cols : 0), _stride(stride) {}
+
+  // Mutable views convert to views of const elements.
+  template <class U>
+    requires(std::is_same_v<const U, T> && !std::is_same_v<U, T>)
+  matrix_view(const matrix_view<U, Layout>& other)
+      : _data(other.data()), _rows(other.rows()), _cols(other.cols()), _stride(other.stride()) {}
+
+  matrix_view(const matrix_view&) = default;
+
+  // Copies the elements of other into the viewed region.
+  matrix_view& operator=(const matrix_view& other)
+    requires(!std::is_const_v<T>)
+  {
+    return assign(other);
+  }
+
+  template <class X>
+    requires(!std::is_const_v<T> && matrix_detail::matrix_operand<X> &&
+             std::is_same_v<matrix_detail::operand_value_t<X>, value_type>)
+  matrix_view& operator=(X&& x) {
+    return assign(std::forward<X>(x));
+  }
+
+  // Size
+
+  size_t rows() const {
+    return _rows;
+  }
+  size_t cols() const {
+    return _cols;
+  }
+  size_t size() const {
+    return _rows * _cols;
+  }
+  bool empty() const {
+    return _rows == 0 || _cols == 0;
+  }
+  size_t stride() const {
+    return _stride;
+  }
+  // Whether the elements are stored without gaps in layout order.
+  bool contiguous() const {
+    return _stride == (by_rows ? _cols : _rows);
+  }
+
+  // Elements access
+
+  reference operator()(size_t row, size_t col) const {
+    return _data[Layout::offset(row, col, _stride)];
+  }
+
+  pointer data() const {
+    return _data;
+  }
+
+  // Iterators
+
+  row_iterator row_begin(size_t row) const {
+    return make_iterator<row_iterator>(_data + Layout::offset(row, 0, _stride), _stride);
+  }
+  row_iterator row_end(size_t row) const {
+    return make_iterator<row_iterator>(_data + Layout::offset(row, _cols, _stride), _stride);
+  }
+
+  col_iterator col_begin(size_t col) const {
+    return make_iterator<col_iterator>(_data + Layout::offset(0, col, _stride), _stride);
+  }
+  col_iterator col_end(size_t col) const {
+    return make_iterator<col_iterator>(_data + Layout::offset(_rows, col, _stride), _stride);
+  }
+
+  // Subviews
+
+  matrix_view block(size_t row, size_t col, size_t rows, size_t cols) const {
+    return matrix_view(_data + Layout::offset(row, col, _stride), rows, cols, _stride);
+  }
+  matrix_view row(size_t row) const {
+    return block(row, 0, 1, _cols);
+  }
+  matrix_view col(size_t col) const {
+    return block(0, col, _rows, 1);
+  }
+
+  // The same elements with rows and columns swapped; nothing is copied.
+  matrix_view<T, typename Layout::transposed> transpose() const {
+    return matrix_view<T, typename Layout::transposed>(_data, _cols, _rows, _stride);
+  }
+
+  // Writing through the view
+
+  template <class X>
+    requires(!std::is_const_v<T> && matrix_detail::matrix_operand<X>)
+  matrix_view& assign(X&& x) {
+    evaluate_into(matrix_detail::make_operand(std::forward<X>(x)));
+    return *this;
+  }
+
+  template <class X>
+    requires(!std::is_const_v<T> && matrix_detail::matrix_operand<X>)
+  matrix_view& operator+=(X&& x) {
+    return assign(*this + std::forward<X>(x));
+  }
+
+  template <class X>
+    requires(!std::is_const_v<T> && matrix_detail::matrix_operand<X>)
+  matrix_view& operator-=(X&& x) {
+    return assign(*this - std::forward<X>(x));
+  }
+
+  matrix_view& operator*=(const value_type& factor)
+    requires(!std::is_const_v<T>)
+  {
+    if constexpr (by_rows) {
+      matrix_detail::parallel_for(_rows, size(), [&](size_t row) {
+        matrix_detail::elementwise_scale_assign(row_begin(row), factor, _cols);
+      });
+    } else {
+      transpose() *= factor;
+    }
+    return *this;
+  }
+
+private:
+  // Pointers ignore the extra argument; ColIterator steps by it.
+  template <class It>
+  static It make_iterator(pointer p, size_t stride) {
+    if constexpr (std::is_pointer_v<It>) {
+      return p;
+    } else {
+      return It(p, stride);
+    }
+  }
+
+  template <class E>
+  void evaluate_into(const E& e) {
+    if constexpr (!by_rows) {
+      transpose().assign(e.transposed());
+      return;
+    }
+    if (e.aliases(_data, _rows, _cols, _stride)) {
+      matrix<value_type> tmp(e);
+      evaluate_into(matrix_detail::ref_leaf<value_type>(tmp));
+      return;
+    }
+    matrix_detail::evaluate(e, _data, _stride);
+  }
+
+  pointer _data = nullptr;
+  size_t _rows = 0;
+  size_t _cols = 0;
+  size_t _stride = 0;
+};
+
+template <class T, class Layout = row_major>
+using const_matrix_view = matrix_view<const T, Layout>;
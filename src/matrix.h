@@ -1,8 +1,23 @@
 #pragma once
 
+#include "allocators.h"
+#include "gemm.h"
+#include "matrix-expr.h"
+#include "matrix-file.h"
+#include "matrix-stats.h"
+#include "matrix-text.h"
+#include "matrix-view.h"
+#include "simd.h"
+#include "strassen.h"
+
+#include <algorithm>
 #include <cstddef>
+#include <filesystem>
 #include <iterator>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <utility>
 
 template <class T>
 class ColIterator : public std::iterator<std::random_access_iterator_tag, T> {
@@ -132,10 +147,50 @@ public:
 
 // Matrix
 
+// Tag requesting a padded row stride, see matrix::stride().
+struct padded_t {
+  explicit padded_t() = default;
+};
+
+inline constexpr padded_t padded{};
+
+namespace matrix_detail {
+
+inline constexpr size_t cache_line = 64;
+
+// Row stride of a padded matrix: cols rounded up to whole cache lines, plus
+// one more line when rows would otherwise start a multiple of 4 KiB apart and
+// all map to the same cache sets.
 template <class T>
+size_t padded_stride(size_t cols) {
+  if constexpr (cache_line % sizeof(T) != 0) {
+    return cols;
+  } else {
+    constexpr size_t line = cache_line / sizeof(T);
+    size_t stride = (cols + line - 1) / line * line;
+    if (stride * sizeof(T) % 4096 == 0) {
+      stride += line;
+    }
+    return stride;
+  }
+}
+
+} // namespace matrix_detail
+
+// Elements are stored in Layout order (see layout.h): row by row by default,
+// column by column for col_major_matrix. Whichever of rows and columns is
+// contiguous is walked by pointer and the other by ColIterator, and stride()
+// is the distance between consecutive lines of that kind. transpose() views
+// the storage in the other order without copying, so a column-major matrix
+// is read as the row-major matrix of its transpose for free.
+template <class T, class Allocator, class Layout>
 class matrix {
+  static constexpr bool by_rows = std::is_same_v<Layout, row_major>;
+
 public:
   using value_type = T;
+  using allocator_type = Allocator;
+  using layout_type = Layout;
 
   using reference = T&;
   using const_reference = const T&;
@@ -146,30 +201,155 @@ public:
   using iterator = pointer;
   using const_iterator = const_pointer;
 
-  using row_iterator = pointer;
-  using const_row_iterator = const_pointer;
+  using row_iterator = std::conditional_t<by_rows, pointer, ColIterator<T>>;
+  using const_row_iterator = std::conditional_t<by_rows, const_pointer, ColIterator<T>>;
 
-  using col_iterator = ColIterator<T>;
-  using const_col_iterator = ColIterator<T>;
+  using col_iterator = std::conditional_t<by_rows, ColIterator<T>, pointer>;
+  using const_col_iterator = std::conditional_t<by_rows, ColIterator<T>, const_pointer>;
 
 private:
-  size_t _rows = 0, _cols = 0;
+  using alloc_traits = std::allocator_traits<Allocator>;
+
+  // Packed matrices of up to SMALL_CAPACITY elements keep them in an inline
+  // buffer instead of calling the allocator. Padded matrices always use the
+  // allocator, so their rows stay cache-line aligned.
+  static constexpr size_t SMALL_BYTES = 128;
+  static constexpr size_t SMALL_CAPACITY = std::clamp<size_t>(SMALL_BYTES / sizeof(T), 1, 16);
+
+  size_t _rows = 0, _cols = 0, _stride = 0;
   T* _data = nullptr;
+  [[no_unique_address]] Allocator _alloc;
+  alignas(T) unsigned char _small[SMALL_CAPACITY * sizeof(T)];
+
+  // Storage holds lines() lines (rows, or columns when column-major) of
+  // line_length() elements, each starting _stride elements after the last.
+  size_t lines() const {
+    return by_rows ? _rows : _cols;
+  }
+  size_t line_length() const {
+    return by_rows ? _cols : _rows;
+  }
+  size_t storage_size() const {
+    return lines() * _stride;
+  }
+
+  T* small_buffer() {
+    return std::launder(reinterpret_cast<T*>(_small));
+  }
+  bool is_small() const {
+    return _data != nullptr && static_cast<const void*>(_data) == static_cast<const void*>(_small);
+  }
+
+  // Uninitialized storage for n elements: the inline buffer if allowed and
+  // large enough, memory from the allocator otherwise.
+  T* acquire(size_t n, bool small_ok = true);
+  // Allocates storage for n elements and value-initializes them.
+  T* allocate_storage(size_t n, bool small_ok = true);
+  // Allocates storage for n elements copied from src.
+  T* allocate_copy(const T* src, size_t n, bool small_ok = true);
+  // Destroys the elements and frees the storage of this matrix.
+  void release_storage();
+  // Takes over the storage of other, which is left without any; elements in
+  // its inline buffer are moved over one by one. This matrix must have none.
+  void take_storage(matrix& other);
+
+  T* line_data(size_t line) {
+    return _data + line * _stride;
+  }
+  const T* line_data(size_t line) const {
+    return _data + line * _stride;
+  }
+
+  // Pointers ignore the extra argument; ColIterator steps by it.
+  template <class It>
+  static It make_iterator(T* p, size_t stride) {
+    if constexpr (std::is_pointer_v<It>) {
+      return p;
+    } else {
+      return It(p, stride);
+    }
+  }
+
+  // Runs body(line, begin, end) over this matrix's storage, flat when both
+  // this matrix and the operand are stored without padding. The operand must
+  // be in storage order, see storage_order().
+  template <class Operand, class F>
+  void for_each_segment(const Operand& operand, F&& body) {
+    matrix_detail::for_each_segment(lines(), line_length(), contiguous() && operand.contiguous(), body);
+  }
+
+  // An expression as it lines up with this matrix's storage: itself when
+  // row-major, its transpose when column-major.
+  template <class E>
+  static decltype(auto) storage_order(const E& e) {
+    if constexpr (by_rows) {
+      return (e);
+    } else {
+      return e.transposed();
+    }
+  }
+
+  template <class E>
+  bool aliased_by(const E& e) const {
+    return storage_order(e).aliases(_data, lines(), line_length(), _stride);
+  }
+
+  template <class E>
+  void evaluate_from(const E& e) {
+    matrix_detail::evaluate(storage_order(e), _data, _stride);
+  }
 
 public:
   matrix();
 
-  matrix(size_t rows, size_t cols);
+  explicit matrix(const Allocator& alloc);
+
+  matrix(size_t rows, size_t cols, const Allocator& alloc = Allocator());
+
+  // Rows are padded to padded_stride(cols) elements, see stride().
+  matrix(size_t rows, size_t cols, padded_t, const Allocator& alloc = Allocator());
 
   template <size_t Rows, size_t Cols>
   matrix(const T (&init)[Rows][Cols]);
 
   matrix(const matrix& other);
 
+  matrix(matrix&& other) noexcept;
+
+  // Evaluates an element-wise expression (see matrix-expr.h) in one pass,
+  // into storage obtained from alloc.
+  template <class E>
+    requires matrix_detail::is_expression_v<E>
+  matrix(E&& e, const Allocator& alloc = Allocator());
+
+  // Copies the elements of a view into a new, packed matrix.
+  template <class V>
+    requires matrix_detail::is_view_v<V>
+  matrix(const V& view, const Allocator& alloc = Allocator())
+      : matrix(matrix_detail::make_operand(view), alloc) {}
+
+  // Copies a matrix stored in the other order. For a view with no copy, see
+  // transpose().
+  template <class OtherAllocator, class OtherLayout>
+    requires(!std::is_same_v<OtherLayout, Layout>)
+  matrix(const matrix<T, OtherAllocator, OtherLayout>& other, const Allocator& alloc = Allocator())
+      : matrix(matrix_detail::make_operand(other), alloc) {}
+
   matrix& operator=(const matrix& other);
 
+  matrix& operator=(matrix&& other) noexcept(alloc_traits::propagate_on_container_move_assignment::value ||
+                                              alloc_traits::is_always_equal::value);
+
+  template <class E>
+    requires matrix_detail::is_expression_v<E>
+  matrix& operator=(E&& e);
+
   ~matrix();
 
+  allocator_type get_allocator() const {
+    return _alloc;
+  }
+
   // Iterators
 
   iterator begin();
@@ -202,13 +382,24 @@ public:
     return _rows == 0 || _cols == 0;
   }
 
+  // Distance in elements between the starts of consecutive rows (columns
+  // when column-major). Equal to cols() (rows()) unless the matrix was
+  // created with padded lines; padding elements are value-initialized, never
+  // read by operations, and included in the flat begin()/end() range.
+  size_t stride() const {
+    return _stride;
+  }
+  bool contiguous() const {
+    return _stride == line_length();
+  }
+
   // Elements access
 
   reference operator()(size_t row, size_t col) {
-    return *(_data + row * _cols + col);
+    return _data[Layout::offset(row, col, _stride)];
   }
   const_reference operator()(size_t row, size_t col) const {
-    return *(_data + row * _cols + col);
+    return _data[Layout::offset(row, col, _stride)];
   }
 
   pointer data() {
@@ -218,18 +409,63 @@ public:
     return _data;
   }
 
+  // Views (see matrix-view.h)
+
+  matrix_view<T, Layout> block(size_t row, size_t col, size_t rows, size_t cols) {
+    return matrix_view<T, Layout>(_data + Layout::offset(row, col, _stride), rows, cols, _stride);
+  }
+  const_matrix_view<T, Layout> block(size_t row, size_t col, size_t rows, size_t cols) const {
+    return const_matrix_view<T, Layout>(_data + Layout::offset(row, col, _stride), rows, cols, _stride);
+  }
+  matrix_view<T, Layout> row(size_t row) {
+    return block(row, 0, 1, _cols);
+  }
+  const_matrix_view<T, Layout> row(size_t row) const {
+    return block(row, 0, 1, _cols);
+  }
+  matrix_view<T, Layout> col(size_t col) {
+    return block(0, col, _rows, 1);
+  }
+  const_matrix_view<T, Layout> col(size_t col) const {
+    return block(0, col, _rows, 1);
+  }
+
+  // Lazy transpose: a view of this matrix's storage in the other layout.
+  // Products with it pick a transpose-aware kernel instead of copying.
+  matrix_view<T, typename Layout::transposed> transpose() {
+    return matrix_view<T, typename Layout::transposed>(_data, _cols, _rows, _stride);
+  }
+  const_matrix_view<T, typename Layout::transposed> transpose() const {
+    return const_matrix_view<T, typename Layout::transposed>(_data, _cols, _rows, _stride);
+  }
+
+  // Transposes the matrix in its own storage, keeping its layout: square
+  // matrices by blocked swaps across the diagonal, packed rectangular ones by
+  // cycle-following. A padded rectangular matrix cannot keep its storage
+  // size, so it goes through a temporary.
+  matrix& transpose_in_place();
+
+  // Files (see matrix-file.h)
+
+  // Writes the matrix to an .npy file, replacing its contents. Column-major
+  // matrices are written in Fortran order.
+  void save(const std::filesystem::path& path) const;
+
+  // Reads a matrix from an .npy file of elements of type T.
+  static matrix load(const std::filesystem::path& path, const Allocator& alloc = Allocator());
+
   // Comparison
 
   friend bool operator==(const matrix& left, const matrix& right) {
-    if (left.rows() != right.rows() || left.cols() != right.cols())
-    {
+    MATRIX_STATS_SCOPE(compare);
+    if (left.rows() != right.rows() || left.cols() != right.cols()) {
       return false;
     }
-    
-    for (size_t i = 0; i < left.size(); i++)
-    {
-      if (left._data[i] != right._data[i])
-      {
+    if (left.contiguous() && right.contiguous()) {
+      return std::equal(left.begin(), left.end(), right.begin());
+    }
+    for (size_t i = 0; i < left.lines(); i++) {
+      if (!std::equal(left.line_data(i), left.line_data(i) + left.line_length(), right.line_data(i))) {
         return false;
       }
     }
@@ -237,279 +473,424 @@ public:
   }
 
   friend bool operator!=(const matrix& left, const matrix& right) {
-    if (left.rows() != right.rows() || left.cols() != right.cols())
-    {
-      return true;
-    }
-
-    for (size_t i = 0; i < left.size(); i++)
-    {
-      if (left._data[i] != right._data[i])
-      {
-        return true;
-      }
-    }
-    return false;
+    return !(left == right);
   }
 
   // Arithmetic operations
 
   matrix& operator+=(const matrix& other) {
-    for (size_t i = 0; i < other.rows(); i++)
-    {
-      for (size_t j = 0; j < other.cols(); j++) {
-        (*this)(i, j) += other(i, j);
-      }
-    }
+    MATRIX_STATS_SCOPE(add_assign);
+    MATRIX_STATS_FLOPS(size());
+    for_each_segment(other, [&](size_t line, size_t begin, size_t end) {
+      matrix_detail::elementwise_add_assign(line_data(line) + begin, other.line_data(line) + begin, end - begin);
+    });
     return *this;
   }
   matrix& operator-=(const matrix& other) {
-    for (size_t i = 0; i < other.rows(); i++)
-    {
-      for (size_t j = 0; j < other.cols(); j++) {
-        (*this)(i, j) -= other(i, j);
-      }
-    }
+    MATRIX_STATS_SCOPE(sub_assign);
+    MATRIX_STATS_FLOPS(size());
+    for_each_segment(other, [&](size_t line, size_t begin, size_t end) {
+      matrix_detail::elementwise_sub_assign(line_data(line) + begin, other.line_data(line) + begin, end - begin);
+    });
     return *this;
   }
-  matrix& operator*=(const matrix& other) {
-    matrix m(other);
-
-    for (size_t i = 0; i < m.rows(); i++)
-    {
-      for (size_t j = 0; j < m.cols(); j++) {
-        T sum = 0;
-        for (size_t k = 0; k < cols(); k++)
-        {
-          sum += operator()(i, k) * other(k, j);
-        }
-        m(i, j) = sum;
+  template <class E>
+    requires(matrix_detail::is_expression_v<E> || matrix_detail::is_view_v<E>)
+  matrix& operator+=(const E& e) {
+    if constexpr (matrix_detail::is_view_v<E>) {
+      return *this += matrix_detail::make_operand(e);
+    } else {
+      MATRIX_STATS_SCOPE(add_assign);
+      MATRIX_STATS_FLOPS(size() * (E::operations + 1));
+      if (aliased_by(e)) {
+        return *this += matrix(e);
       }
+      decltype(auto) s = storage_order(e);
+      for_each_segment(s, [&](size_t line, size_t begin, size_t end) {
+        T* out = line_data(line);
+        if constexpr (std::remove_cvref_t<decltype(s)>::is_leaf) {
+          matrix_detail::elementwise_add_assign(out + begin, s.row_data(line) + begin, end - begin);
+        } else {
+          for (size_t i = begin; i < end; ++i) {
+            out[i] += s.at(line, i);
+          }
+        }
+      });
+      return *this;
     }
-
-    delete[] _data;
-    _data = m._data;
-    _rows = m._rows;
-    _cols = m._cols;
-    m._data = nullptr;
-
-    return *this;
   }
-  matrix& operator*=(const_reference factor) {
-    for (size_t i = 0; i < rows(); i++)
-    {
-      for (size_t j = 0; j < cols(); j++) {
-        operator()(i, j) *= factor;
+  template <class E>
+    requires(matrix_detail::is_expression_v<E> || matrix_detail::is_view_v<E>)
+  matrix& operator-=(const E& e) {
+    if constexpr (matrix_detail::is_view_v<E>) {
+      return *this -= matrix_detail::make_operand(e);
+    } else {
+      MATRIX_STATS_SCOPE(sub_assign);
+      MATRIX_STATS_FLOPS(size() * (E::operations + 1));
+      if (aliased_by(e)) {
+        return *this -= matrix(e);
       }
+      decltype(auto) s = storage_order(e);
+      for_each_segment(s, [&](size_t line, size_t begin, size_t end) {
+        T* out = line_data(line);
+        if constexpr (std::remove_cvref_t<decltype(s)>::is_leaf) {
+          matrix_detail::elementwise_sub_assign(out + begin, s.row_data(line) + begin, end - begin);
+        } else {
+          for (size_t i = begin; i < end; ++i) {
+            out[i] -= s.at(line, i);
+          }
+        }
+      });
+      return *this;
     }
-    return *this;
   }
-
-  friend matrix operator+(const matrix& left, const matrix& right) {
-    matrix m(left);
-    for (size_t i = 0; i < left.rows(); i++)
-    {
-      for (size_t j = 0; j < left.cols(); j++) {
-        m(i, j) = left(i, j) + right(i, j);
-      }
-    }
-    return m;
+  matrix& operator*=(const matrix& other) {
+    return *this = (*this) * other;
   }
-  friend matrix operator-(const matrix& left, const matrix& right) {
-    matrix m(left);
-    for (size_t i = 0; i < left.rows(); i++)
-    {
-      for (size_t j = 0; j < left.cols(); j++) {
-        m(i, j) = left(i, j) - right(i, j);
-      }
-    }
-    return m;
+  matrix& operator*=(const_reference factor) {
+    MATRIX_STATS_SCOPE(scale);
+    MATRIX_STATS_FLOPS(size());
+    for_each_segment(*this, [&](size_t line, size_t begin, size_t end) {
+      matrix_detail::elementwise_scale_assign(line_data(line) + begin, factor, end - begin);
+    });
+    return *this;
   }
+
+  // Column-major products are computed as the row-major C^T = B^T A^T, so
+  // the kernels read both operands' storage row by row either way.
   friend matrix operator*(const matrix& left, const matrix& right) {
-    matrix m(right);
-    for (size_t i = 0; i < m.rows(); i++)
-    {
-      for (size_t j = 0; j < m.cols(); j++) {
-        T sum = 0;
-        for (size_t k = 0; k < left.cols(); k++)
-        {
-          sum += left(i, k) * right(k, j);
-        }
-        m(i, j) = sum;
-      }
-    }
+    MATRIX_STATS_SCOPE(multiply);
+    MATRIX_STATS_FLOPS(2 * left.rows() * right.cols() * left.cols());
+    matrix m(left.rows(), right.cols(), alloc_traits::select_on_container_copy_construction(left._alloc));
+    const matrix& a = by_rows ? left : right;
+    const matrix& b = by_rows ? right : left;
+    size_t n = left.rows();
+    if (left.cols() == n && right.cols() == n && matrix_detail::use_strassen<T>(n)) {
+      matrix_detail::strassen_multiply(n, a.data(), a.stride(), b.data(), b.stride(), m.data(), m.stride());
+      return m;
+    }
+    matrix_detail::gemm_parallel(m.lines(), m.line_length(), left.cols(), a.data(), a.stride(), b.data(), b.stride(),
+                                 m.data(), m.stride());
     return m;
   }
-  friend matrix operator*(const matrix& left, const_reference right) {
-    matrix m(left.rows(), left.cols());
-    for (size_t i = 0; i < m.rows(); i++)
-    {
-      for (size_t j = 0; j < m.cols(); j++) {
-        m(i, j) = left(i, j) * right;
-      }
-    }
-    return m;
-  }
-  friend matrix operator*(const_reference left, const matrix& right) {
-    return right * left;
-  }
 
-  
 };
 
-template <class T>
-std::ostream& operator<<(std::ostream& out, const matrix<T>& m) {
-  for (size_t i = 0; i < m.rows(); i++)
-  {
-    for (size_t j = 0; j < m.cols(); j++) {
-      out << m(i, j) << "  ";
-    }
-    out << std::endl;
+template <class T, class Allocator = default_allocator<T>>
+using col_major_matrix = matrix<T, Allocator, col_major>;
+
+template <class T, class Allocator, class Layout>
+T* matrix<T, Allocator, Layout>::acquire(size_t n, bool small_ok) {
+  if (small_ok && n <= SMALL_CAPACITY) {
+    return small_buffer();
   }
+  MATRIX_STATS_ALLOCATION(n * sizeof(T));
+  return alloc_traits::allocate(_alloc, n);
 }
 
-template <class T>
-matrix<T>::matrix() : _rows(0), _cols(0), _data(nullptr) {
+template <class T, class Allocator, class Layout>
+T* matrix<T, Allocator, Layout>::allocate_storage(size_t n, bool small_ok) {
+  T* p = acquire(n, small_ok);
+  for (size_t i = 0; i < n; ++i) {
+    alloc_traits::construct(_alloc, p + i);
+  }
+  return p;
+}
 
+template <class T, class Allocator, class Layout>
+T* matrix<T, Allocator, Layout>::allocate_copy(const T* src, size_t n, bool small_ok) {
+  MATRIX_STATS_COPY(n * sizeof(T));
+  T* p = acquire(n, small_ok);
+  for (size_t i = 0; i < n; ++i) {
+    alloc_traits::construct(_alloc, p + i, src[i]);
+  }
+  return p;
 }
 
-template <class T>
-matrix<T>::matrix(size_t rows, size_t cols) 
-  : 
-  _rows(rows > 0 && cols > 0 ? rows : 0), 
-  _cols(rows > 0 && cols > 0 ? cols : 0), 
-  _data((rows > 0 && cols > 0) ? (new T[rows * cols]) : nullptr) {
+template <class T, class Allocator, class Layout>
+void matrix<T, Allocator, Layout>::release_storage() {
+  if (_data != nullptr) {
+    for (size_t i = 0; i < storage_size(); ++i) {
+      alloc_traits::destroy(_alloc, _data + i);
+    }
+    if (!is_small()) {
+      alloc_traits::deallocate(_alloc, _data, storage_size());
+    }
+    _data = nullptr;
+  }
+}
 
+template <class T, class Allocator, class Layout>
+void matrix<T, Allocator, Layout>::take_storage(matrix& other) {
+  if (other.is_small()) {
+    _data = small_buffer();
+    for (size_t i = 0; i < other.storage_size(); ++i) {
+      alloc_traits::construct(_alloc, _data + i, std::move(other._data[i]));
+    }
+    other.release_storage();
+  } else {
+    _data = std::exchange(other._data, nullptr);
   }
+  _rows = std::exchange(other._rows, 0);
+  _cols = std::exchange(other._cols, 0);
+  _stride = std::exchange(other._stride, 0);
+}
 
-template <class T>
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::matrix() : _rows(0), _cols(0), _stride(0), _data(nullptr) {}
+
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::matrix(const Allocator& alloc)
+    : _rows(0), _cols(0), _stride(0), _data(nullptr), _alloc(alloc) {}
+
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::matrix(size_t rows, size_t cols, const Allocator& alloc)
+    : _rows(rows > 0 && cols > 0 ? rows : 0), _cols(rows > 0 && cols > 0 ? cols : 0), _stride(line_length()),
+      _alloc(alloc) {
+  MATRIX_STATS_SCOPE(construct);
+  _data = size() > 0 ? allocate_storage(storage_size()) : nullptr;
+}
+
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::matrix(size_t rows, size_t cols, padded_t, const Allocator& alloc)
+    : _rows(rows > 0 && cols > 0 ? rows : 0), _cols(rows > 0 && cols > 0 ? cols : 0),
+      _stride(matrix_detail::padded_stride<T>(line_length())), _alloc(alloc) {
+  MATRIX_STATS_SCOPE(construct);
+  _data = size() > 0 ? allocate_storage(storage_size(), false) : nullptr;
+}
+
+template <class T, class Allocator, class Layout>
 template <size_t Rows, size_t Cols>
-matrix<T>::matrix(const T (&init)[Rows][Cols]) : matrix(Rows, Cols) {
-  for (size_t i = 0; i < Rows; i++)
-  {
-    for (size_t j = 0; j < Cols; j++)
-    {
-      operator()(i, j) = init[i][j];
+matrix<T, Allocator, Layout>::matrix(const T (&init)[Rows][Cols])
+    : _rows(Rows), _cols(Cols), _stride(line_length()) {
+  MATRIX_STATS_SCOPE(construct);
+  _data = acquire(Rows * Cols);
+  for (size_t i = 0; i < Rows; i++) {
+    for (size_t j = 0; j < Cols; j++) {
+      alloc_traits::construct(_alloc, _data + Layout::offset(i, j, _stride), init[i][j]);
     }
   }
 }
 
-template <class T>
-matrix<T>::matrix(const matrix& other) : matrix(other._rows, other._cols) {
-  for (size_t i = 0; i < _rows; i++)
-  {
-    for (size_t j = 0; j < _cols; j++)
-    {
-      operator()(i, j) = other(i, j);
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::matrix(const matrix& other)
+    : _rows(other._rows), _cols(other._cols), _stride(other._stride),
+      _alloc(alloc_traits::select_on_container_copy_construction(other._alloc)) {
+  MATRIX_STATS_SCOPE(copy);
+  _data = other.empty() ? nullptr : allocate_copy(other._data, other.storage_size(), other.is_small());
+}
+
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::matrix(matrix&& other) noexcept : _alloc(std::move(other._alloc)) {
+  MATRIX_STATS_SCOPE(move);
+  take_storage(other);
+}
+
+template <class T, class Allocator, class Layout>
+template <class E>
+  requires matrix_detail::is_expression_v<E>
+matrix<T, Allocator, Layout>::matrix(E&& e, const Allocator& alloc) : _alloc(alloc) {
+  MATRIX_STATS_SCOPE(evaluate);
+  MATRIX_STATS_FLOPS(e.rows() * e.cols() * std::remove_cvref_t<E>::operations);
+  if constexpr (std::remove_cvref_t<E>::operations == 0) {
+    MATRIX_STATS_COPY(e.rows() * e.cols() * sizeof(T));
+  }
+  if constexpr (!std::is_reference_v<E> && !std::is_const_v<E>) {
+    // The expression owns an expiring matrix of the right shape and type:
+    // compute the result in its buffer, keeping its stride, and take it over.
+    matrix* reusable = e.template reusable<matrix>();
+    if (reusable != nullptr && !reusable->aliased_by(e)) {
+      reusable->evaluate_from(e);
+      *this = std::move(*reusable);
+      return;
     }
   }
+
+  if (e.rows() > 0 && e.cols() > 0) {
+    _rows = e.rows();
+    _cols = e.cols();
+    _stride = line_length();
+    _data = allocate_storage(storage_size());
+    evaluate_from(e);
+  }
 }
 
-template <class T>
-matrix<T>& matrix<T>::operator=(const matrix& other) {
-  if (*this == other) {
+template <class T, class Allocator, class Layout>
+template <class E>
+  requires matrix_detail::is_expression_v<E>
+matrix<T, Allocator, Layout>& matrix<T, Allocator, Layout>::operator=(E&& e) {
+  MATRIX_STATS_SCOPE(evaluate);
+  MATRIX_STATS_FLOPS(e.rows() * e.cols() * std::remove_cvref_t<E>::operations);
+  if (_data != nullptr && _rows == e.rows() && _cols == e.cols() && !aliased_by(e)) {
+    evaluate_from(e);
     return *this;
   }
-  
-  if (_data != nullptr)
-  {
-    delete[] _data;
+  // A packed buffer holding the same number of elements can be reshaped.
+  size_t length = by_rows ? e.cols() : e.rows();
+  if (_data != nullptr && contiguous() && size() == e.rows() * e.cols() &&
+      !storage_order(e).aliases(_data, size() / length, length, length)) {
+    _rows = e.rows();
+    _cols = e.cols();
+    _stride = length;
+    evaluate_from(e);
+    return *this;
   }
+  return *this = matrix(std::forward<E>(e), _alloc);
+}
 
-  _data = nullptr;
-  _rows = other.rows();
-  _cols = other.cols();
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>& matrix<T, Allocator, Layout>::operator=(const matrix& other) {
+  MATRIX_STATS_SCOPE(copy);
+  if (this == &other) {
+    return *this;
+  }
 
-  if (!other.empty())
-  {
-    _data = new T[other.rows() * other.cols()];
+  if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+    if (_alloc != other._alloc) {
+      release_storage();
+    }
+    _alloc = other._alloc;
+  }
 
-    for (size_t i = 0; i < other.rows(); i++)
-    {
-      for (size_t j = 0; j < other.cols(); j++)
-      {
-        operator()(i, j) = other(i, j);
-      }
+  // Same amount of storage of the same kind: the existing buffer is reused as
+  // is. Inline and heap storage are never swapped for one another, so padded
+  // rows never end up in the inline buffer.
+  if (_data != nullptr && storage_size() == other.storage_size() && is_small() == other.is_small()) {
+    MATRIX_STATS_COPY(storage_size() * sizeof(T));
+    std::copy(other._data, other._data + other.storage_size(), _data);
+  } else {
+    release_storage();
+    _data = other.empty() ? nullptr : allocate_copy(other._data, other.storage_size(), other.is_small());
+  }
+  _rows = other._rows;
+  _cols = other._cols;
+  _stride = other._stride;
+
+  return *this;
+}
+
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>& matrix<T, Allocator, Layout>::operator=(matrix&& other) noexcept(
+    alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value) {
+  MATRIX_STATS_SCOPE(move);
+  if (this == &other) {
+    return *this;
+  }
+
+  if constexpr (!alloc_traits::propagate_on_container_move_assignment::value &&
+                !alloc_traits::is_always_equal::value) {
+    // The buffer belongs to a different allocator and cannot be adopted.
+    if (_alloc != other._alloc) {
+      return *this = static_cast<const matrix&>(other);
     }
   }
 
+  release_storage();
+  if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+    _alloc = std::move(other._alloc);
+  }
+  take_storage(other);
   return *this;
 }
 
-template <class T>
-matrix<T>::~matrix() {
-  if (_data != nullptr)
-  {
-    delete[] _data;
+template <class T, class Allocator, class Layout>
+void matrix<T, Allocator, Layout>::save(const std::filesystem::path& path) const {
+  MATRIX_STATS_SCOPE(file);
+  matrix_detail::npy_save<Layout>(path, _data, _rows, _cols, _stride);
+}
+
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout> matrix<T, Allocator, Layout>::load(const std::filesystem::path& path,
+                                                          const Allocator& alloc) {
+  MATRIX_STATS_SCOPE(file);
+  matrix_detail::npy_reader reader(path);
+  reader.header().check_type<T>();
+  matrix m(reader.rows(), reader.cols(), alloc);
+  reader.read<Layout>(m._data, m._stride);
+  return m;
+}
+
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>& matrix<T, Allocator, Layout>::transpose_in_place() {
+  MATRIX_STATS_SCOPE(transpose);
+  if (_rows == _cols) {
+    matrix_detail::transpose_square(_rows, _data, _stride);
+  } else if (contiguous()) {
+    matrix_detail::transpose_cycles(lines(), line_length(), _data);
+    std::swap(_rows, _cols);
+    _stride = line_length();
+  } else {
+    *this = matrix(transpose(), _alloc);
   }
-  
+  return *this;
+}
+
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::~matrix() {
+  release_storage();
 }
 
 // Iterator
 
-template <class T>
-matrix<T>::iterator matrix<T>::begin() {
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::iterator matrix<T, Allocator, Layout>::begin() {
   return _data;
 }
 
-template <class T>
-matrix<T>::const_iterator matrix<T>::begin() const {
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::const_iterator matrix<T, Allocator, Layout>::begin() const {
   return _data;
 }
 
-template <class T>
-matrix<T>::iterator matrix<T>::end() {
-  return _data + _rows * _cols;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::iterator matrix<T, Allocator, Layout>::end() {
+  return _data + storage_size();
 }
 
-template <class T>
-matrix<T>::const_iterator matrix<T>::end() const {
-  return _data + _rows * _cols;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::const_iterator matrix<T, Allocator, Layout>::end() const {
+  return _data + storage_size();
 }
 
 // Rows iter
-template <class T>
-matrix<T>::row_iterator matrix<T>::row_begin(size_t row) {
-  return _data + row * _cols;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::row_iterator matrix<T, Allocator, Layout>::row_begin(size_t row) {
+  return make_iterator<row_iterator>(_data + Layout::offset(row, 0, _stride), _stride);
 }
 
-template <class T>
-matrix<T>::const_row_iterator matrix<T>::row_begin(size_t row) const {
-  return _data + row * _cols;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::const_row_iterator matrix<T, Allocator, Layout>::row_begin(size_t row) const {
+  return make_iterator<const_row_iterator>(_data + Layout::offset(row, 0, _stride), _stride);
 }
 
-template <class T>
-matrix<T>::row_iterator matrix<T>::row_end(size_t row) {
-  return _data + row * _cols + _cols;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::row_iterator matrix<T, Allocator, Layout>::row_end(size_t row) {
+  return make_iterator<row_iterator>(_data + Layout::offset(row, _cols, _stride), _stride);
 }
 
-template <class T>
-matrix<T>::const_row_iterator matrix<T>::row_end(size_t row) const {
-  return _data + row * _cols + _cols;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::const_row_iterator matrix<T, Allocator, Layout>::row_end(size_t row) const {
+  return make_iterator<const_row_iterator>(_data + Layout::offset(row, _cols, _stride), _stride);
 }
 
 
 // Cols iter
-template <class T>
-matrix<T>::col_iterator matrix<T>::col_begin(size_t col) {
-  ColIterator it(_data + col, _cols);
-  return it;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::col_iterator matrix<T, Allocator, Layout>::col_begin(size_t col) {
+  return make_iterator<col_iterator>(_data + Layout::offset(0, col, _stride), _stride);
 }
 
-template <class T>
-matrix<T>::const_col_iterator matrix<T>::col_begin(size_t col) const {
-  ColIterator it(_data + col, _cols);
-  return it;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::const_col_iterator matrix<T, Allocator, Layout>::col_begin(size_t col) const {
+  return make_iterator<const_col_iterator>(_data + Layout::offset(0, col, _stride), _stride);
 }
 
-template <class T>
-matrix<T>::col_iterator matrix<T>::col_end(size_t col) {
-  ColIterator it(_data + col + _cols * _rows, _cols);
-  return it;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::col_iterator matrix<T, Allocator, Layout>::col_end(size_t col) {
+  return make_iterator<col_iterator>(_data + Layout::offset(_rows, col, _stride), _stride);
 }
 
-template <class T>
-matrix<T>::const_col_iterator matrix<T>::col_end(size_t col) const {
-  ColIterator it(_data + col + _cols * _rows, _cols);
-  return it;
+template <class T, class Allocator, class Layout>
+matrix<T, Allocator, Layout>::const_col_iterator matrix<T, Allocator, Layout>::col_end(size_t col) const {
+  return make_iterator<const_col_iterator>(_data + Layout::offset(_rows, col, _stride), _stride);
 }
@@ -0,0 +1,579 @@
+#pragma once
+
+#include "matrix.h"
+#include "simd.h"
+#include "thread-pool.h"
+#include "transpose.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#if MATRIX_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Matrix products with a wider accumulator than the element type.
+//
+// operator* accumulates in the element type, so a product of matrix<int8_t>
+// overflows after a few terms and a long float dot product loses precision.
+// multiply<Acc> widens every element to Acc before it is multiplied, sums in
+// Acc and returns a matrix<Acc>:
+//
+//   matrix<std::int32_t> c = multiply<std::int32_t>(a8, b8); // quantized weights
+//   matrix<double> d = multiply<double>(af, bf);
+//   matrix<float> e = multiply_compensated(af, bf);          // Kahan summation
+//
+// Every element of the result is the dot product of a row of A with a column
+// of B, and both are read as contiguous rows. Signed 8- and 16-bit elements
+// with 32-bit accumulators stay narrow and use the integer multiply-add
+// instructions that add pairs of 16-bit products straight into 32-bit lanes:
+// vpdpwssd with AVX-512 VNNI, vpmaddwd with AVX2 (8-bit elements are
+// sign-extended to 16 bits on load). Any other pair of types is converted to
+// Acc as the operands are laid out, which costs far less than the product
+// (and converting inside the kernel costs more shuffles than multiplies),
+// and summed by a kernel compiled for SSE2, AVX2 and AVX-512 like simd.h.
+// An operand that already has the right layout and type is read in place:
+// A when it is row-major, B when it is column-major (e.g. a transposed view).
+// The kernel is picked once, on first use.
+//
+// Four columns are done at a time so every load of A is shared, and they
+// stay in L1 while the rows of A stream past. The result is computed in
+// tiles on the thread pool.
+//
+// multiply_compensated keeps the element type but sums each dot product
+// with Kahan's compensated summation, a running correction per vector lane,
+// so the error does not grow with the length of the dot product.
+
+namespace matrix_detail {
+
+// c[i * ldc + j] = row i of a . row j of bt, over k elements, for an m x n
+// block.
+template <class T, class Acc>
+using mixed_kernel = void (*)(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* bt, size_t ldb, Acc* c,
+                              size_t ldc);
+
+// Element and accumulator types with an integer multiply-add kernel.
+template <class T, class Acc>
+inline constexpr bool mixed_madd = (std::is_same_v<T, std::int8_t> || std::is_same_v<T, std::int16_t>) &&
+                                   std::is_same_v<Acc, std::int32_t>;
+
+// Element type the operands are laid out in: narrow for the multiply-add
+// kernel, the accumulator otherwise.
+template <class T, class Acc>
+using mixed_packed_t = std::conditional_t<mixed_madd<T, Acc>, T, Acc>;
+
+template <class T, class Acc>
+struct mixed_generic {
+  static void dot_rows(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* bt, size_t ldb, Acc* c,
+                       size_t ldc) {
+    for (size_t i = 0; i < m; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        const T* x = a + i * lda;
+        const T* y = bt + j * ldb;
+        Acc sum = Acc();
+        for (size_t p = 0; p < k; ++p) {
+          sum += static_cast<Acc>(x[p]) * static_cast<Acc>(y[p]);
+        }
+        c[i * ldc + j] = sum;
+      }
+    }
+  }
+};
+
+// Kahan summation of one dot product at a time, for element types without
+// a vector kernel.
+template <class T>
+struct compensated_generic {
+  static void dot_rows(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* bt, size_t ldb, T* c,
+                       size_t ldc) {
+    for (size_t i = 0; i < m; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        const T* x = a + i * lda;
+        const T* y = bt + j * ldb;
+        T sum = T(0);
+        T error = T(0);
+        for (size_t p = 0; p < k; ++p) {
+          T term = x[p] * y[p] - error;
+          T next = sum + term;
+          error = (next - sum) - term;
+          sum = next;
+        }
+        c[i * ldc + j] = sum;
+      }
+    }
+  }
+};
+
+#if MATRIX_SIMD_X86
+
+// Plain and compensated bodies, written once with GCC vector extensions and
+// inlined into the per-ISA entry points below, as in simd.h.
+template <class T, size_t Bytes>
+struct mixed_body {
+  typedef T vec __attribute__((vector_size(Bytes)));
+  typedef T unaligned_vec __attribute__((vector_size(Bytes), aligned(alignof(T)), may_alias));
+  static constexpr size_t LANES = Bytes / sizeof(T);
+
+  static inline __attribute__((always_inline)) const unaligned_vec& load(const T* p) {
+    return *reinterpret_cast<const unaligned_vec*>(p);
+  }
+
+  static inline __attribute__((always_inline)) T reduce(const vec& v) {
+    T sum = v[0];
+    for (size_t l = 1; l < LANES; ++l) {
+      sum += v[l];
+    }
+    return sum;
+  }
+
+  static inline __attribute__((always_inline)) T tail(const T* x, const T* y, size_t begin, size_t k) {
+    T sum = T();
+    for (size_t p = begin; p < k; ++p) {
+      sum += x[p] * y[p];
+    }
+    return sum;
+  }
+
+  static inline __attribute__((always_inline)) void dot_rows(size_t m, size_t n, size_t k, const T* a, size_t lda,
+                                                              const T* bt, size_t ldb, T* c, size_t ldc) {
+    size_t body = k / LANES * LANES;
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+      const T* y0 = bt + j * ldb;
+      const T* y1 = y0 + ldb;
+      const T* y2 = y1 + ldb;
+      const T* y3 = y2 + ldb;
+      for (size_t i = 0; i < m; ++i) {
+        const T* x = a + i * lda;
+        T* out = c + i * ldc;
+        vec s0 = {};
+        vec s1 = {};
+        vec s2 = {};
+        vec s3 = {};
+        for (size_t p = 0; p < body; p += LANES) {
+          vec v = load(x + p);
+          s0 += v * load(y0 + p);
+          s1 += v * load(y1 + p);
+          s2 += v * load(y2 + p);
+          s3 += v * load(y3 + p);
+        }
+        out[j] = reduce(s0) + tail(x, y0, body, k);
+        out[j + 1] = reduce(s1) + tail(x, y1, body, k);
+        out[j + 2] = reduce(s2) + tail(x, y2, body, k);
+        out[j + 3] = reduce(s3) + tail(x, y3, body, k);
+      }
+    }
+    for (; j < n; ++j) {
+      const T* y = bt + j * ldb;
+      for (size_t i = 0; i < m; ++i) {
+        const T* x = a + i * lda;
+        T* out = c + i * ldc;
+        vec s = {};
+        for (size_t p = 0; p < body; p += LANES) {
+          s += load(x + p) * load(y + p);
+        }
+        out[j] = reduce(s) + tail(x, y, body, k);
+      }
+    }
+  }
+};
+
+template <class T, size_t Bytes>
+struct compensated_body {
+  typedef T vec __attribute__((vector_size(Bytes)));
+  typedef T unaligned_vec __attribute__((vector_size(Bytes), aligned(alignof(T)), may_alias));
+  static constexpr size_t LANES = Bytes / sizeof(T);
+
+  static inline __attribute__((always_inline)) const unaligned_vec& load(const T* p) {
+    return *reinterpret_cast<const unaligned_vec*>(p);
+  }
+
+  // Adds term to sum, keeping the low-order bits lost in error.
+  template <class V>
+  static inline __attribute__((always_inline)) void add(V& sum, V& error, const V& value) {
+    V term = value - error;
+    V next = sum + term;
+    error = (next - sum) - term;
+    sum = next;
+  }
+
+  // Folds the lanes and their corrections, then the tail, into one sum.
+  static inline __attribute__((always_inline)) T finish(const vec& sum, const vec& error, const T* x, const T* y,
+                                                         size_t begin, size_t k) {
+    T total = T(0);
+    T total_error = T(0);
+    for (size_t l = 0; l < LANES; ++l) {
+      add(total, total_error, sum[l]);
+      add(total, total_error, -error[l]);
+    }
+    for (size_t p = begin; p < k; ++p) {
+      add(total, total_error, x[p] * y[p]);
+    }
+    return total;
+  }
+
+  static inline __attribute__((always_inline)) void dot_rows(size_t m, size_t n, size_t k, const T* a, size_t lda,
+                                                              const T* bt, size_t ldb, T* c, size_t ldc) {
+    size_t body = k / LANES * LANES;
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+      const T* y0 = bt + j * ldb;
+      const T* y1 = y0 + ldb;
+      const T* y2 = y1 + ldb;
+      const T* y3 = y2 + ldb;
+      for (size_t i = 0; i < m; ++i) {
+        const T* x = a + i * lda;
+        T* out = c + i * ldc;
+        vec s0 = {}, e0 = {};
+        vec s1 = {}, e1 = {};
+        vec s2 = {}, e2 = {};
+        vec s3 = {}, e3 = {};
+        for (size_t p = 0; p < body; p += LANES) {
+          vec v = load(x + p);
+          add(s0, e0, v * load(y0 + p));
+          add(s1, e1, v * load(y1 + p));
+          add(s2, e2, v * load(y2 + p));
+          add(s3, e3, v * load(y3 + p));
+        }
+        out[j] = finish(s0, e0, x, y0, body, k);
+        out[j + 1] = finish(s1, e1, x, y1, body, k);
+        out[j + 2] = finish(s2, e2, x, y2, body, k);
+        out[j + 3] = finish(s3, e3, x, y3, body, k);
+      }
+    }
+    for (; j < n; ++j) {
+      const T* y = bt + j * ldb;
+      for (size_t i = 0; i < m; ++i) {
+        const T* x = a + i * lda;
+        T* out = c + i * ldc;
+        vec s = {};
+        vec e = {};
+        for (size_t p = 0; p < body; p += LANES) {
+          add(s, e, load(x + p) * load(y + p));
+        }
+        out[j] = finish(s, e, x, y, body, k);
+      }
+    }
+  }
+};
+
+#define MATRIX_MIXED_VARIANT(NAME, TARGET, BYTES)                                                                      \
+  template <class T>                                                                                                   \
+  struct mixed_##NAME {                                                                                                \
+    __attribute__((target(TARGET))) static void dot_rows(size_t m, size_t n, size_t k, const T* a, size_t lda,         \
+                                                         const T* bt, size_t ldb, T* c, size_t ldc) {                  \
+      mixed_body<T, BYTES>::dot_rows(m, n, k, a, lda, bt, ldb, c, ldc);                                                \
+    }                                                                                                                  \
+  };                                                                                                                   \
+  template <class T>                                                                                                   \
+  struct compensated_##NAME {                                                                                          \
+    __attribute__((target(TARGET))) static void dot_rows(size_t m, size_t n, size_t k, const T* a, size_t lda,         \
+                                                         const T* bt, size_t ldb, T* c, size_t ldc) {                  \
+      compensated_body<T, BYTES>::dot_rows(m, n, k, a, lda, bt, ldb, c, ldc);                                          \
+    }                                                                                                                  \
+  };
+
+MATRIX_MIXED_VARIANT(sse2, "sse2", 16)
+MATRIX_MIXED_VARIANT(avx2, "avx2", 32)
+MATRIX_MIXED_VARIANT(avx512, "avx512f", 64)
+
+#undef MATRIX_MIXED_VARIANT
+
+// Instruction sets for the 16-bit multiply-add kernel, written with the
+// <immintrin.h> intrinsics. Each helper carries the target it needs, so it
+// can only be inlined into code compiled for that target: the body below
+// has none of its own and lands in the entry points, which do. Vectors cross
+// the helpers by reference (see simd.h).
+struct madd_avx2 {
+  typedef __m256i vec;
+  // 16-bit elements per register.
+  static constexpr size_t STEP = 16;
+
+  __attribute__((target("avx2"))) static inline void load(vec& v, const std::int16_t* p) {
+    v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  __attribute__((target("avx2"))) static inline void load(vec& v, const std::int8_t* p) {
+    v = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+  }
+  // sum += the pairwise products of x and the elements at y, added in pairs.
+  template <class T>
+  __attribute__((target("avx2"))) static inline void madd(vec& sum, const vec& x, const T* y) {
+    vec w;
+    load(w, y);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, w));
+  }
+};
+
+struct madd_vnni {
+  typedef __m512i vec;
+  static constexpr size_t STEP = 32;
+
+  __attribute__((target("avx512f,avx512bw"))) static inline void load(vec& v, const std::int16_t* p) {
+    v = _mm512_loadu_si512(p);
+  }
+  __attribute__((target("avx512f,avx512bw"))) static inline void load(vec& v, const std::int8_t* p) {
+    v = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+  }
+  template <class T>
+  __attribute__((target("avx512f,avx512bw,avx512vnni"))) static inline void madd(vec& sum, const vec& x,
+                                                                                 const T* y) {
+    vec w;
+    load(w, y);
+    sum = _mm512_dpwssd_epi32(sum, x, w);
+  }
+};
+
+template <class Isa, class T>
+struct madd_body {
+  using vec = typename Isa::vec;
+  static constexpr size_t STEP = Isa::STEP;
+
+  // Adds the two halves of v until four lanes are left.
+  template <class V>
+  static inline __attribute__((always_inline)) std::int32_t reduce(const V& v) {
+    if constexpr (sizeof(V) == 16) {
+      return v[0] + v[1] + v[2] + v[3];
+    } else {
+      typedef std::int32_t half __attribute__((vector_size(sizeof(V) / 2)));
+      half low;
+      half high;
+      std::memcpy(&low, &v, sizeof(half));
+      std::memcpy(&high, reinterpret_cast<const char*>(&v) + sizeof(half), sizeof(half));
+      return reduce(low + high);
+    }
+  }
+
+  static inline __attribute__((always_inline)) std::int32_t tail(const T* x, const T* y, size_t begin, size_t k) {
+    std::int32_t sum = 0;
+    for (size_t p = begin; p < k; ++p) {
+      sum += static_cast<std::int32_t>(x[p]) * static_cast<std::int32_t>(y[p]);
+    }
+    return sum;
+  }
+
+  static inline __attribute__((always_inline)) void dot_rows(size_t m, size_t n, size_t k, const T* a, size_t lda,
+                                                              const T* bt, size_t ldb, std::int32_t* c, size_t ldc) {
+    size_t body = k / STEP * STEP;
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+      const T* y0 = bt + j * ldb;
+      const T* y1 = y0 + ldb;
+      const T* y2 = y1 + ldb;
+      const T* y3 = y2 + ldb;
+      for (size_t i = 0; i < m; ++i) {
+        const T* x = a + i * lda;
+        std::int32_t* out = c + i * ldc;
+        vec s0 = {};
+        vec s1 = {};
+        vec s2 = {};
+        vec s3 = {};
+        for (size_t p = 0; p < body; p += STEP) {
+          vec v;
+          Isa::load(v, x + p);
+          Isa::madd(s0, v, y0 + p);
+          Isa::madd(s1, v, y1 + p);
+          Isa::madd(s2, v, y2 + p);
+          Isa::madd(s3, v, y3 + p);
+        }
+        out[j] = reduce(s0) + tail(x, y0, body, k);
+        out[j + 1] = reduce(s1) + tail(x, y1, body, k);
+        out[j + 2] = reduce(s2) + tail(x, y2, body, k);
+        out[j + 3] = reduce(s3) + tail(x, y3, body, k);
+      }
+    }
+    for (; j < n; ++j) {
+      const T* y = bt + j * ldb;
+      for (size_t i = 0; i < m; ++i) {
+        const T* x = a + i * lda;
+        std::int32_t* out = c + i * ldc;
+        vec s = {};
+        for (size_t p = 0; p < body; p += STEP) {
+          vec v;
+          Isa::load(v, x + p);
+          Isa::madd(s, v, y + p);
+        }
+        out[j] = reduce(s) + tail(x, y, body, k);
+      }
+    }
+  }
+};
+
+template <class T>
+struct mixed_madd_avx2 {
+  __attribute__((target("avx2"))) static void dot_rows(size_t m, size_t n, size_t k, const T* a, size_t lda,
+                                                        const T* bt, size_t ldb, std::int32_t* c, size_t ldc) {
+    madd_body<madd_avx2, T>::dot_rows(m, n, k, a, lda, bt, ldb, c, ldc);
+  }
+};
+
+template <class T>
+struct mixed_madd_vnni {
+  __attribute__((target("avx512f,avx512bw,avx512vnni"))) static void dot_rows(
+      size_t m, size_t n, size_t k, const T* a, size_t lda, const T* bt, size_t ldb, std::int32_t* c, size_t ldc) {
+    madd_body<madd_vnni, T>::dot_rows(m, n, k, a, lda, bt, ldb, c, ldc);
+  }
+};
+
+#endif
+
+inline bool cpu_has_vnni() {
+#if MATRIX_SIMD_X86
+  static const bool vnni = cpu_simd_level() == simd_level::avx512 && __builtin_cpu_supports("avx512bw") &&
+                           __builtin_cpu_supports("avx512vnni");
+  return vnni;
+#else
+  return false;
+#endif
+}
+
+template <class T, class Acc>
+mixed_kernel<mixed_packed_t<T, Acc>, Acc> select_mixed_kernel(simd_level level) {
+  if constexpr (mixed_madd<T, Acc>) {
+#if MATRIX_SIMD_X86
+    if (cpu_has_vnni()) {
+      return &mixed_madd_vnni<T>::dot_rows;
+    }
+    if (level == simd_level::avx2 || level == simd_level::avx512) {
+      return &mixed_madd_avx2<T>::dot_rows;
+    }
+#endif
+    (void)level;
+    return &mixed_generic<T, Acc>::dot_rows;
+  } else {
+#if MATRIX_SIMD_X86
+    if constexpr (simd_vectorizable<Acc>) {
+      switch (level) {
+      case simd_level::avx512:
+        return &mixed_avx512<Acc>::dot_rows;
+      case simd_level::avx2:
+        return &mixed_avx2<Acc>::dot_rows;
+      case simd_level::sse2:
+        return &mixed_sse2<Acc>::dot_rows;
+      case simd_level::generic:
+        break;
+      }
+    }
+#endif
+    (void)level;
+    return &mixed_generic<Acc, Acc>::dot_rows;
+  }
+}
+
+template <class T>
+mixed_kernel<T, T> select_compensated_kernel(simd_level level) {
+#if MATRIX_SIMD_X86
+  switch (level) {
+  case simd_level::avx512:
+    return &compensated_avx512<T>::dot_rows;
+  case simd_level::avx2:
+    return &compensated_avx2<T>::dot_rows;
+  case simd_level::sse2:
+    return &compensated_sse2<T>::dot_rows;
+  case simd_level::generic:
+    break;
+  }
+#endif
+  (void)level;
+  return &compensated_generic<T>::dot_rows;
+}
+
+// Rows of x as a row-major array of U with leading dimension ld: the storage
+// itself for a row-major operand of element type U, otherwise a converted or
+// transposed copy in buffer.
+template <class U, class M>
+const U* mixed_rows(const M& x, std::unique_ptr<U[]>& buffer, size_t& ld) {
+  using T = std::remove_const_t<typename M::value_type>;
+  constexpr bool rows = std::is_same_v<layout_of_t<M>, row_major>;
+  if constexpr (rows && std::is_same_v<T, U>) {
+    ld = x.stride();
+    return x.data();
+  } else {
+    buffer.reset(new U[x.rows() * x.cols()]);
+    MATRIX_STATS_ALLOCATION(x.rows() * x.cols() * sizeof(U));
+    ld = x.cols();
+    if constexpr (rows) {
+      for (size_t i = 0; i < x.rows(); ++i) {
+        std::copy(x.data() + i * x.stride(), x.data() + i * x.stride() + x.cols(), buffer.get() + i * ld);
+      }
+    } else {
+      transpose_copy(x.cols(), x.rows(), x.data(), x.stride(), buffer.get(), ld);
+    }
+    return buffer.get();
+  }
+}
+
+// a * b with the given kernel, on operands laid out as rows of U, in tiles
+// on the thread pool. Consecutive tiles share a panel of columns of B, which
+// stays in cache.
+template <class Acc, class U, class L, class R>
+matrix<Acc> mixed_multiply(const L& a, const R& b, mixed_kernel<U, Acc> kernel) {
+  constexpr size_t TILE_ROWS = 16;
+  constexpr size_t TILE_COLS = 64;
+
+  size_t m = a.rows();
+  size_t n = b.cols();
+  size_t k = a.cols();
+  MATRIX_STATS_SCOPE(multiply);
+  MATRIX_STATS_FLOPS(2 * m * n * k);
+  matrix<Acc> c(m, n);
+  if (m == 0 || n == 0 || k == 0) {
+    return c;
+  }
+
+  std::unique_ptr<U[]> a_buffer;
+  std::unique_ptr<U[]> bt_buffer;
+  size_t lda;
+  size_t ldb;
+  const U* rows = mixed_rows(a, a_buffer, lda);
+  const U* cols = mixed_rows(b.transpose(), bt_buffer, ldb);
+
+  size_t row_tiles = (m + TILE_ROWS - 1) / TILE_ROWS;
+  size_t col_tiles = (n + TILE_COLS - 1) / TILE_COLS;
+  Acc* out = c.data();
+  size_t ldc = c.stride();
+  parallel_for(row_tiles * col_tiles, m * n * k, [&](size_t tile) {
+    size_t i0 = tile % row_tiles * TILE_ROWS;
+    size_t j0 = tile / row_tiles * TILE_COLS;
+    kernel(std::min(TILE_ROWS, m - i0), std::min(TILE_COLS, n - j0), k, rows + i0 * lda, lda, cols + j0 * ldb, ldb,
+           out + i0 * ldc + j0, ldc);
+  });
+  return c;
+}
+
+template <class X>
+using mixed_value_t = std::remove_const_t<typename std::remove_cvref_t<X>::value_type>;
+
+} // namespace matrix_detail
+
+// a * b with every element converted to Acc and every dot product summed in
+// Acc, e.g. multiply<std::int32_t> for int8_t or int16_t matrices and
+// multiply<double> for float ones.
+template <class Acc, class L, class R>
+  requires((matrix_detail::is_matrix_v<L> || matrix_detail::is_view_v<L>) &&
+           (matrix_detail::is_matrix_v<R> || matrix_detail::is_view_v<R>) &&
+           std::is_same_v<matrix_detail::mixed_value_t<L>, matrix_detail::mixed_value_t<R>> &&
+           std::is_arithmetic_v<matrix_detail::mixed_value_t<L>> && std::is_arithmetic_v<Acc>)
+matrix<Acc> multiply(const L& a, const R& b) {
+  using T = matrix_detail::mixed_value_t<L>;
+  static const matrix_detail::mixed_kernel<matrix_detail::mixed_packed_t<T, Acc>, Acc> kernel =
+      matrix_detail::select_mixed_kernel<T, Acc>(matrix_detail::cpu_simd_level());
+  return matrix_detail::mixed_multiply<Acc>(a, b, kernel);
+}
+
+// a * b for floating-point matrices, with every dot product summed with
+// Kahan's compensated summation.
+template <class L, class R>
+  requires((matrix_detail::is_matrix_v<L> || matrix_detail::is_view_v<L>) &&
+           (matrix_detail::is_matrix_v<R> || matrix_detail::is_view_v<R>) &&
+           std::is_same_v<matrix_detail::mixed_value_t<L>, matrix_detail::mixed_value_t<R>> &&
+           std::is_floating_point_v<matrix_detail::mixed_value_t<L>>)
+matrix<matrix_detail::mixed_value_t<L>> multiply_compensated(const L& a, const R& b) {
+  using T = matrix_detail::mixed_value_t<L>;
+  static const matrix_detail::mixed_kernel<T, T> kernel =
+      matrix_detail::select_compensated_kernel<T>(matrix_detail::cpu_simd_level());
+  return matrix_detail::mixed_multiply<T>(a, b, kernel);
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "gemm.h"
+#include "matrix-file.h"
+#include "matrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Out-of-core multiplication of matrices stored in .npy files (see
+// matrix-file.h), for products whose operands or result do not fit in
+// memory.
+//
+//   multiply_files<double>("a.npy", "b.npy", "c.npy", size_t(1) << 30);
+//
+// The result is computed one square tile of C at a time: the matching row
+// band of A and column band of B are streamed through in tiles of the same
+// size, each pair multiplied into the resident C tile with gemm_parallel, and
+// the finished tile written to its place in the output file. While one pair
+// of tiles is being multiplied, a reader thread is already reading the next,
+// so the disk and the cores are busy at the same time.
+//
+// The memory budget (in bytes) bounds everything held at once: the C tile
+// and two A and B tiles each. The tile side is the largest that fits; since
+// every element of A is read n / tile times and every element of B m / tile
+// times, a bigger budget means proportionally less I/O.
+//
+// Inputs must be row-major .npy files of T; byte order is converted.
+
+namespace matrix_detail {
+
+// Side of the square tiles used for a given memory budget: one C tile plus
+// double-buffered A and B tiles.
+template <class T>
+size_t out_of_core_tile(size_t memory_budget) {
+  size_t elements = memory_budget / sizeof(T) / 5;
+  size_t tile = static_cast<size_t>(std::sqrt(static_cast<double>(elements)));
+  return std::max<size_t>(tile, 1);
+}
+
+// Calls load(s) for s = 0, 1, ..., steps - 1 on one background thread,
+// staying at most two steps ahead of the consumer: the loads alternate
+// between two sets of buffers, and step s reuses those of step s - 2.
+template <class Load>
+class read_ahead {
+public:
+  read_ahead(size_t steps, Load& load) : _steps(steps), _load(load), _thread(&read_ahead::run, this) {}
+
+  read_ahead(const read_ahead&) = delete;
+  read_ahead& operator=(const read_ahead&) = delete;
+
+  ~read_ahead() {
+    {
+      std::lock_guard lock(_mutex);
+      _stop = true;
+    }
+    _changed.notify_all();
+    _thread.join();
+  }
+
+  // Waits until step s is loaded; rethrows the exception of a failed load.
+  void wait(size_t s) {
+    std::unique_lock lock(_mutex);
+    _changed.wait(lock, [&] { return _loaded > s || _error; });
+    if (_error) {
+      std::rethrow_exception(_error);
+    }
+  }
+
+  // Marks step s as processed, so that its buffers can be reloaded.
+  void release(size_t s) {
+    {
+      std::lock_guard lock(_mutex);
+      _released = s + 1;
+    }
+    _changed.notify_all();
+  }
+
+private:
+  void run() {
+    for (size_t s = 0; s < _steps; ++s) {
+      {
+        std::unique_lock lock(_mutex);
+        _changed.wait(lock, [&] { return _stop || s < _released + 2; });
+        if (_stop) {
+          return;
+        }
+      }
+      try {
+        _load(s);
+      } catch (...) {
+        std::lock_guard lock(_mutex);
+        _error = std::current_exception();
+        _changed.notify_all();
+        return;
+      }
+      {
+        std::lock_guard lock(_mutex);
+        _loaded = s + 1;
+      }
+      _changed.notify_all();
+    }
+  }
+
+  size_t _steps;
+  Load& _load;
+  std::mutex _mutex;
+  std::condition_variable _changed;
+  size_t _loaded = 0;
+  size_t _released = 0;
+  bool _stop = false;
+  std::exception_ptr _error;
+  std::thread _thread;
+};
+
+} // namespace matrix_detail
+
+// Writes the product of the matrices in files a and b to the file out.
+template <class T>
+void multiply_files(const std::filesystem::path& a, const std::filesystem::path& b, const std::filesystem::path& out,
+                    size_t memory_budget) {
+  matrix_detail::npy_reader left(a);
+  matrix_detail::npy_reader right(b);
+  left.header().check_type<T>();
+  right.header().check_type<T>();
+  if (left.cols() != right.rows()) {
+    throw std::runtime_error("matrix file: inner dimensions do not match");
+  }
+
+  size_t m = left.rows();
+  size_t n = right.cols();
+  size_t k = left.cols();
+  matrix_detail::npy_block_writer<T> result(out, m, n);
+  if (m == 0 || n == 0 || k == 0) {
+    result.close();
+    return;
+  }
+
+  size_t tile = matrix_detail::out_of_core_tile<T>(memory_budget);
+  size_t tm = std::min(tile, m);
+  size_t tn = std::min(tile, n);
+  size_t tk = std::min(tile, k);
+  size_t row_tiles = (m + tm - 1) / tm;
+  size_t col_tiles = (n + tn - 1) / tn;
+  size_t depth_tiles = (k + tk - 1) / tk;
+  size_t steps = row_tiles * col_tiles * depth_tiles;
+
+  std::unique_ptr<T[]> c_tile(new T[tm * tn]);
+  std::unique_ptr<T[]> a_tiles[2] = {std::unique_ptr<T[]>(new T[tm * tk]), std::unique_ptr<T[]>(new T[tm * tk])};
+  std::unique_ptr<T[]> b_tiles[2] = {std::unique_ptr<T[]>(new T[tk * tn]), std::unique_ptr<T[]>(new T[tk * tn])};
+
+  // Step s multiplies A tile (i, p) by B tile (p, j) into C tile (i, j),
+  // with p running fastest so every C tile is finished before the next.
+  struct step {
+    size_t row, col, depth, rows, cols, depths;
+  };
+  auto step_at = [&](size_t s) {
+    size_t i = s / (col_tiles * depth_tiles);
+    size_t j = s / depth_tiles % col_tiles;
+    size_t p = s % depth_tiles;
+    return step{i * tm, j * tn, p * tk, std::min(tm, m - i * tm), std::min(tn, n - j * tn), std::min(tk, k - p * tk)};
+  };
+  auto load = [&](size_t s) {
+    step t = step_at(s);
+    left.read_block(t.row, t.depth, t.rows, t.depths, a_tiles[s % 2].get(), t.depths);
+    right.read_block(t.depth, t.col, t.depths, t.cols, b_tiles[s % 2].get(), t.cols);
+  };
+
+  matrix_detail::read_ahead ahead(steps, load);
+  for (size_t s = 0; s < steps; ++s) {
+    ahead.wait(s);
+
+    step t = step_at(s);
+    if (t.depth == 0) {
+      std::fill_n(c_tile.get(), t.rows * t.cols, T(0));
+    }
+    matrix_detail::gemm_parallel(t.rows, t.cols, t.depths, a_tiles[s % 2].get(), t.depths, b_tiles[s % 2].get(),
+                                 t.cols, c_tile.get(), t.cols);
+    if (t.depth + t.depths == k) {
+      result.write_block(t.row, t.col, t.rows, t.cols, c_tile.get(), t.cols);
+    }
+    ahead.release(s);
+  }
+  result.close();
+}
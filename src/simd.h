@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+// Flat element-wise kernels over contiguous storage, used by the matrix
+// arithmetic operators.
+//
+// For 32- and 64-bit integers, float and double the kernels are compiled for
+// SSE2, AVX2 and AVX-512 and the best variant supported by the CPU is picked
+// once, on first use. Every other element type goes through a plain loop.
+// The output may alias either input as long as the pointers are equal.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_SIMD_X86 1
+#else
+#define MATRIX_SIMD_X86 0
+#endif
+
+namespace matrix_detail {
+
+enum class simd_level {
+  generic,
+  sse2,
+  avx2,
+  avx512,
+};
+
+inline simd_level detect_simd_level() {
+#if MATRIX_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return simd_level::avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return simd_level::avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return simd_level::sse2;
+  }
+#endif
+  return simd_level::generic;
+}
+
+inline simd_level cpu_simd_level() {
+  static const simd_level level = detect_simd_level();
+  return level;
+}
+
+// 32- and 64-bit integers (signed or not), float and double.
+template <class T>
+inline constexpr bool simd_vectorizable =
+    std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && (sizeof(T) == 4 || sizeof(T) == 8);
+
+template <class T>
+struct elementwise_kernels {
+  void (*add)(const T* a, const T* b, T* out, size_t n);
+  void (*sub)(const T* a, const T* b, T* out, size_t n);
+  void (*scale)(const T* a, T factor, T* out, size_t n);
+};
+
+#if MATRIX_SIMD_X86
+
+// Vector bodies are written once with GCC vector extensions and inlined into
+// the per-ISA entry points below, which is where the instruction set is
+// actually chosen. Vectors cross the helpers by reference only; passed or
+// returned by value, they would change the ABI of helpers compiled without
+// the target, which GCC warns about with -Wpsabi.
+template <class T, size_t Bytes>
+struct simd_body {
+  typedef T vec __attribute__((vector_size(Bytes)));
+  typedef T unaligned_vec __attribute__((vector_size(Bytes), aligned(alignof(T)), may_alias));
+  static constexpr size_t LANES = Bytes / sizeof(T);
+
+  static inline __attribute__((always_inline)) const unaligned_vec& load(const T* p) {
+    return *reinterpret_cast<const unaligned_vec*>(p);
+  }
+
+  static inline __attribute__((always_inline)) void store(T* p, const vec& v) {
+    *reinterpret_cast<unaligned_vec*>(p) = v;
+  }
+
+  static inline __attribute__((always_inline)) void add(const T* a, const T* b, T* out, size_t n) {
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+      store(out + i, load(a + i) + load(b + i));
+    }
+    for (; i < n; ++i) {
+      out[i] = a[i] + b[i];
+    }
+  }
+
+  static inline __attribute__((always_inline)) void sub(const T* a, const T* b, T* out, size_t n) {
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+      store(out + i, load(a + i) - load(b + i));
+    }
+    for (; i < n; ++i) {
+      out[i] = a[i] - b[i];
+    }
+  }
+
+  static inline __attribute__((always_inline)) void scale(const T* a, T factor, T* out, size_t n) {
+    vec f = {};
+    f += factor;
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+      store(out + i, load(a + i) * f);
+    }
+    for (; i < n; ++i) {
+      out[i] = a[i] * factor;
+    }
+  }
+};
+
+#define MATRIX_SIMD_VARIANT(NAME, TARGET, BYTES)                                                                       \
+  template <class T>                                                                                                   \
+  struct simd_##NAME {                                                                                                 \
+    __attribute__((target(TARGET))) static void add(const T* a, const T* b, T* out, size_t n) {                        \
+      simd_body<T, BYTES>::add(a, b, out, n);                                                                          \
+    }                                                                                                                  \
+    __attribute__((target(TARGET))) static void sub(const T* a, const T* b, T* out, size_t n) {                        \
+      simd_body<T, BYTES>::sub(a, b, out, n);                                                                          \
+    }                                                                                                                  \
+    __attribute__((target(TARGET))) static void scale(const T* a, T factor, T* out, size_t n) {                        \
+      simd_body<T, BYTES>::scale(a, factor, out, n);                                                                   \
+    }                                                                                                                  \
+  };
+
+MATRIX_SIMD_VARIANT(sse2, "sse2", 16)
+MATRIX_SIMD_VARIANT(avx2, "avx2", 32)
+MATRIX_SIMD_VARIANT(avx512, "avx512f", 64)
+
+#undef MATRIX_SIMD_VARIANT
+
+#endif
+
+template <class T>
+struct simd_generic {
+  static void add(const T* a, const T* b, T* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = a[i] + b[i];
+    }
+  }
+
+  static void sub(const T* a, const T* b, T* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = a[i] - b[i];
+    }
+  }
+
+  static void scale(const T* a, T factor, T* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = a[i] * factor;
+    }
+  }
+};
+
+template <template <class> class Variant, class T>
+constexpr elementwise_kernels<T> make_elementwise_kernels() {
+  return {&Variant<T>::add, &Variant<T>::sub, &Variant<T>::scale};
+}
+
+template <class T>
+elementwise_kernels<T> select_elementwise_kernels(simd_level level) {
+#if MATRIX_SIMD_X86
+  switch (level) {
+  case simd_level::avx512:
+    return make_elementwise_kernels<simd_avx512, T>();
+  case simd_level::avx2:
+    return make_elementwise_kernels<simd_avx2, T>();
+  case simd_level::sse2:
+    return make_elementwise_kernels<simd_sse2, T>();
+  case simd_level::generic:
+    break;
+  }
+#else
+  (void)level;
+#endif
+  return make_elementwise_kernels<simd_generic, T>();
+}
+
+template <class T>
+const elementwise_kernels<T>& dispatched_elementwise_kernels() {
+  static const elementwise_kernels<T> kernels = select_elementwise_kernels<T>(cpu_simd_level());
+  return kernels;
+}
+
+// Entry points used by matrix. Non-vectorizable types use the compound
+// assignment operators for in-place updates, so no temporaries are created.
+// Scale factors are taken by value, since they may refer to an element of
+// the matrix being scaled.
+
+template <class T>
+void elementwise_add(const T* a, const T* b, T* out, size_t n) {
+  if constexpr (simd_vectorizable<T>) {
+    dispatched_elementwise_kernels<T>().add(a, b, out, n);
+  } else {
+    simd_generic<T>::add(a, b, out, n);
+  }
+}
+
+template <class T>
+void elementwise_sub(const T* a, const T* b, T* out, size_t n) {
+  if constexpr (simd_vectorizable<T>) {
+    dispatched_elementwise_kernels<T>().sub(a, b, out, n);
+  } else {
+    simd_generic<T>::sub(a, b, out, n);
+  }
+}
+
+template <class T>
+void elementwise_scale(const T* a, T factor, T* out, size_t n) {
+  if constexpr (simd_vectorizable<T>) {
+    dispatched_elementwise_kernels<T>().scale(a, factor, out, n);
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = a[i] * factor;
+    }
+  }
+}
+
+template <class T>
+void elementwise_add_assign(T* a, const T* b, size_t n) {
+  if constexpr (simd_vectorizable<T>) {
+    dispatched_elementwise_kernels<T>().add(a, b, a, n);
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      a[i] += b[i];
+    }
+  }
+}
+
+template <class T>
+void elementwise_sub_assign(T* a, const T* b, size_t n) {
+  if constexpr (simd_vectorizable<T>) {
+    dispatched_elementwise_kernels<T>().sub(a, b, a, n);
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      a[i] -= b[i];
+    }
+  }
+}
+
+template <class T>
+void elementwise_scale_assign(T* a, T factor, size_t n) {
+  if constexpr (simd_vectorizable<T>) {
+    dispatched_elementwise_kernels<T>().scale(a, factor, a, n);
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      a[i] *= factor;
+    }
+  }
+}
+
+} // namespace matrix_detail
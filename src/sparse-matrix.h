@@ -0,0 +1,391 @@
+#pragma once
+
+#include "layout.h"
+#include "matrix.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Compressed sparse matrices.
+//
+// sparse_matrix<T, row_major> is CSR: for every row, offsets()[row] ..
+// offsets()[row + 1] index the column indices and values of its nonzeros,
+// sorted by column. sparse_matrix<T, col_major> is the same with rows and
+// columns swapped (CSC). Storage and the cost of every operation scale with
+// the number of nonzeros, not with rows() * cols().
+//
+//   sparse_entry<double> entries[] = {{0, 1, 2.0}, {2, 0, -1.0}};
+//   csr_matrix<double> a(3, 3, entries);
+//   matrix<double> c = a * dense;   // sparse x dense
+//   multiply(a, x, y);              // y = a * x
+
+template <class T>
+struct sparse_entry {
+  size_t row;
+  size_t col;
+  T value;
+};
+
+template <class T, class Layout = row_major>
+class sparse_matrix {
+  static constexpr bool by_rows = std::is_same_v<Layout, row_major>;
+
+public:
+  using value_type = T;
+  using layout_type = Layout;
+
+  sparse_matrix() = default;
+
+  // All zeros.
+  sparse_matrix(size_t rows, size_t cols) {
+    reset(rows, cols, 0);
+  }
+
+  // Keeps the elements of a dense matrix or view that differ from T().
+  template <class M>
+    requires(matrix_detail::is_matrix_v<M> || matrix_detail::is_view_v<M>)
+  explicit sparse_matrix(const M& dense);
+
+  // From (row, col, value) entries in any order; duplicates are summed.
+  // Throws std::out_of_range if an entry lies outside rows x cols.
+  sparse_matrix(size_t rows, size_t cols, std::span<const sparse_entry<T>> entries);
+
+  // Converts between CSR and CSC.
+  template <class Other>
+    requires(!std::is_same_v<Other, Layout>)
+  explicit sparse_matrix(const sparse_matrix<T, Other>& other);
+
+  sparse_matrix(const sparse_matrix& other) = default;
+
+  sparse_matrix(sparse_matrix&& other) noexcept
+      : _rows(std::exchange(other._rows, 0)), _cols(std::exchange(other._cols, 0)),
+        _nonzeros(std::exchange(other._nonzeros, 0)), _offsets(std::exchange(other._offsets, {})),
+        _indices(std::exchange(other._indices, {})), _values(std::exchange(other._values, {})) {}
+
+  sparse_matrix& operator=(const sparse_matrix& other) = default;
+
+  sparse_matrix& operator=(sparse_matrix&& other) noexcept {
+    if (this != &other) {
+      _rows = std::exchange(other._rows, 0);
+      _cols = std::exchange(other._cols, 0);
+      _nonzeros = std::exchange(other._nonzeros, 0);
+      _offsets = std::exchange(other._offsets, {});
+      _indices = std::exchange(other._indices, {});
+      _values = std::exchange(other._values, {});
+    }
+    return *this;
+  }
+
+  // Size
+
+  size_t rows() const {
+    return _rows;
+  }
+  size_t cols() const {
+    return _cols;
+  }
+  size_t nonzeros() const {
+    return _nonzeros;
+  }
+  bool empty() const {
+    return _rows == 0 || _cols == 0;
+  }
+
+  // Compressed storage: rows for CSR, columns for CSC.
+
+  size_t outer_size() const {
+    return by_rows ? _rows : _cols;
+  }
+  const size_t* offsets() const {
+    return _offsets.data();
+  }
+  const size_t* indices() const {
+    return _indices.data();
+  }
+  const T* values() const {
+    return _values.data();
+  }
+
+  // Elements access; a binary search within the row (or column).
+  T operator()(size_t row, size_t col) const {
+    size_t outer = by_rows ? row : col;
+    size_t inner = by_rows ? col : row;
+    const size_t* begin = _indices.data() + _offsets[outer];
+    const size_t* end = _indices.data() + _offsets[outer + 1];
+    const size_t* it = std::lower_bound(begin, end, inner);
+    return it != end && *it == inner ? _values[it - _indices.data()] : T();
+  }
+
+  matrix<T> to_dense() const {
+    matrix<T> m(_rows, _cols);
+    for (size_t outer = 0; outer < outer_size(); ++outer) {
+      for (size_t k = _offsets[outer]; k < _offsets[outer + 1]; ++k) {
+        if constexpr (by_rows) {
+          m(outer, _indices[k]) = _values[k];
+        } else {
+          m(_indices[k], outer) = _values[k];
+        }
+      }
+    }
+    return m;
+  }
+
+private:
+  template <class U, class Other>
+  friend class sparse_matrix;
+
+  // Sets the shape and allocates room for the given number of nonzeros, with
+  // all offsets zero.
+  void reset(size_t rows, size_t cols, size_t nonzeros) {
+    _rows = rows > 0 && cols > 0 ? rows : 0;
+    _cols = rows > 0 && cols > 0 ? cols : 0;
+    _nonzeros = nonzeros;
+    _offsets.assign(outer_size() + 1, 0);
+    _indices.assign(nonzeros, 0);
+    _values.assign(nonzeros, T());
+  }
+
+  size_t _rows = 0;
+  size_t _cols = 0;
+  size_t _nonzeros = 0;
+  std::vector<size_t> _offsets;
+  std::vector<size_t> _indices;
+  std::vector<T> _values;
+};
+
+template <class T>
+using csr_matrix = sparse_matrix<T, row_major>;
+
+template <class T>
+using csc_matrix = sparse_matrix<T, col_major>;
+
+template <class T, class Layout>
+template <class M>
+  requires(matrix_detail::is_matrix_v<M> || matrix_detail::is_view_v<M>)
+sparse_matrix<T, Layout>::sparse_matrix(const M& dense) {
+  size_t rows = dense.rows();
+  size_t cols = dense.cols();
+  size_t outer_count = by_rows ? rows : cols;
+  size_t inner_count = by_rows ? cols : rows;
+  auto at = [&](size_t outer, size_t inner) -> const T& {
+    return by_rows ? dense(outer, inner) : dense(inner, outer);
+  };
+
+  size_t nonzeros = 0;
+  for (size_t outer = 0; outer < outer_count; ++outer) {
+    for (size_t inner = 0; inner < inner_count; ++inner) {
+      nonzeros += !(at(outer, inner) == T());
+    }
+  }
+
+  reset(rows, cols, nonzeros);
+  size_t k = 0;
+  for (size_t outer = 0; outer < outer_size(); ++outer) {
+    for (size_t inner = 0; inner < inner_count; ++inner) {
+      if (!(at(outer, inner) == T())) {
+        _indices[k] = inner;
+        _values[k] = at(outer, inner);
+        ++k;
+      }
+    }
+    _offsets[outer + 1] = k;
+  }
+}
+
+template <class T, class Layout>
+sparse_matrix<T, Layout>::sparse_matrix(size_t rows, size_t cols, std::span<const sparse_entry<T>> entries) {
+  for (const sparse_entry<T>& e : entries) {
+    if (e.row >= rows || e.col >= cols) {
+      throw std::out_of_range("sparse_matrix: entry index out of range");
+    }
+  }
+  reset(rows, cols, 0);
+  if (empty() || entries.empty()) {
+    return;
+  }
+  auto outer_of = [](const sparse_entry<T>& e) { return by_rows ? e.row : e.col; };
+  auto inner_of = [](const sparse_entry<T>& e) { return by_rows ? e.col : e.row; };
+
+  // Bucket the entries by row (column) with a counting sort, then sort each
+  // bucket by column (row).
+  size_t n = entries.size();
+  std::vector<size_t> starts(outer_size() + 1);
+  for (const sparse_entry<T>& e : entries) {
+    ++starts[outer_of(e) + 1];
+  }
+  for (size_t outer = 0; outer < outer_size(); ++outer) {
+    starts[outer + 1] += starts[outer];
+  }
+  std::vector<sparse_entry<T>> sorted(n);
+  std::vector<size_t> cursor(starts.begin(), starts.end() - 1);
+  for (const sparse_entry<T>& e : entries) {
+    sorted[cursor[outer_of(e)]++] = e;
+  }
+
+  auto by_inner = [&](const sparse_entry<T>& a, const sparse_entry<T>& b) { return inner_of(a) < inner_of(b); };
+  size_t unique = 0;
+  for (size_t outer = 0; outer < outer_size(); ++outer) {
+    std::sort(sorted.begin() + starts[outer], sorted.begin() + starts[outer + 1], by_inner);
+    for (size_t k = starts[outer]; k < starts[outer + 1]; ++k) {
+      unique += k == starts[outer] || inner_of(sorted[k]) != inner_of(sorted[k - 1]);
+    }
+  }
+
+  reset(rows, cols, unique);
+  size_t k = 0;
+  for (size_t outer = 0; outer < outer_size(); ++outer) {
+    for (size_t s = starts[outer]; s < starts[outer + 1]; ++s) {
+      if (s > starts[outer] && inner_of(sorted[s]) == inner_of(sorted[s - 1])) {
+        _values[k - 1] += sorted[s].value;
+      } else {
+        _indices[k] = inner_of(sorted[s]);
+        _values[k] = sorted[s].value;
+        ++k;
+      }
+    }
+    _offsets[outer + 1] = k;
+  }
+}
+
+template <class T, class Layout>
+template <class Other>
+  requires(!std::is_same_v<Other, Layout>)
+sparse_matrix<T, Layout>::sparse_matrix(const sparse_matrix<T, Other>& other) {
+  // The inner indices of other are our outer ones: count them, then scatter
+  // every entry. Walking other in order keeps each new bucket sorted.
+  reset(other._rows, other._cols, other._nonzeros);
+  for (size_t k = 0; k < _nonzeros; ++k) {
+    ++_offsets[other._indices[k] + 1];
+  }
+  for (size_t outer = 0; outer < outer_size(); ++outer) {
+    _offsets[outer + 1] += _offsets[outer];
+  }
+  std::vector<size_t> cursor(_offsets.begin(), _offsets.end() - 1);
+  for (size_t other_outer = 0; other_outer < other.outer_size(); ++other_outer) {
+    for (size_t k = other._offsets[other_outer]; k < other._offsets[other_outer + 1]; ++k) {
+      size_t dst = cursor[other._indices[k]]++;
+      _indices[dst] = other_outer;
+      _values[dst] = other._values[k];
+    }
+  }
+}
+
+// Sparse matrix-vector multiply: y = a * x, with x of a.cols() elements and y
+// of a.rows() (std::invalid_argument is thrown otherwise). CSR rows are
+// independent dot products and run on the thread pool; CSC scatters columns
+// into y.
+template <class T, class Layout>
+void multiply(const sparse_matrix<T, Layout>& a, std::type_identity_t<std::span<const T>> x,
+              std::type_identity_t<std::span<T>> y) {
+  if (x.size() != a.cols() || y.size() != a.rows()) {
+    throw std::invalid_argument("sparse multiply: vector sizes do not match the matrix");
+  }
+  const size_t* offsets = a.offsets();
+  const size_t* indices = a.indices();
+  const T* values = a.values();
+
+  if constexpr (std::is_same_v<Layout, row_major>) {
+    matrix_detail::parallel_for(a.rows(), a.nonzeros(), [&](size_t row) {
+      T sum = T();
+      for (size_t k = offsets[row]; k < offsets[row + 1]; ++k) {
+        sum += values[k] * x[indices[k]];
+      }
+      y[row] = sum;
+    });
+  } else {
+    std::fill(y.begin(), y.begin() + a.rows(), T());
+    for (size_t col = 0; col < a.cols(); ++col) {
+      T xc = x[col];
+      for (size_t k = offsets[col]; k < offsets[col + 1]; ++k) {
+        y[indices[k]] += values[k] * xc;
+      }
+    }
+  }
+}
+
+namespace matrix_detail {
+
+// out.row(dst) += factor * b.row(src)
+template <class T, class M>
+void sparse_axpy_row(matrix<T>& out, size_t dst, const T& factor, const M& b, size_t src) {
+  T* out_row = out.row_begin(dst);
+  for (size_t j = 0; j < b.cols(); ++j) {
+    out_row[j] += factor * b(src, j);
+  }
+}
+
+template <class T, class Layout, class M>
+matrix<T> sparse_dense_product(const sparse_matrix<T, Layout>& a, const M& b) {
+  const size_t* offsets = a.offsets();
+  const size_t* indices = a.indices();
+  const T* values = a.values();
+  matrix<T> out(a.rows(), b.cols());
+
+  if constexpr (std::is_same_v<Layout, row_major>) {
+    parallel_for(a.rows(), a.nonzeros() * b.cols(), [&](size_t row) {
+      for (size_t k = offsets[row]; k < offsets[row + 1]; ++k) {
+        sparse_axpy_row(out, row, values[k], b, indices[k]);
+      }
+    });
+  } else {
+    for (size_t col = 0; col < a.cols(); ++col) {
+      for (size_t k = offsets[col]; k < offsets[col + 1]; ++k) {
+        sparse_axpy_row(out, indices[k], values[k], b, col);
+      }
+    }
+  }
+  return out;
+}
+
+template <class T, class Layout, class M>
+matrix<T> dense_sparse_product(const M& a, const sparse_matrix<T, Layout>& b) {
+  const size_t* offsets = b.offsets();
+  const size_t* indices = b.indices();
+  const T* values = b.values();
+  matrix<T> out(a.rows(), b.cols());
+
+  parallel_for(a.rows(), a.rows() * b.nonzeros(), [&](size_t row) {
+    T* out_row = out.row_begin(row);
+    if constexpr (std::is_same_v<Layout, row_major>) {
+      // Row i of the result combines the rows of b, weighted by row i of a.
+      for (size_t p = 0; p < b.rows(); ++p) {
+        const T& aip = a(row, p);
+        for (size_t k = offsets[p]; k < offsets[p + 1]; ++k) {
+          out_row[indices[k]] += aip * values[k];
+        }
+      }
+    } else {
+      // Each element is a sparse dot product with a column of b.
+      for (size_t col = 0; col < b.cols(); ++col) {
+        T sum = T();
+        for (size_t k = offsets[col]; k < offsets[col + 1]; ++k) {
+          sum += a(row, indices[k]) * values[k];
+        }
+        out_row[col] = sum;
+      }
+    }
+  });
+  return out;
+}
+
+} // namespace matrix_detail
+
+// Sparse x dense and dense x sparse products. Dense operands may be
+// matrices, views or expressions, which are evaluated first.
+template <class T, class Layout, class M>
+  requires(matrix_detail::matrix_operand<M> && std::is_same_v<matrix_detail::operand_value_t<M>, T>)
+matrix<T> operator*(const sparse_matrix<T, Layout>& a, M&& b) {
+  return matrix_detail::sparse_dense_product(a, matrix_detail::materialize(std::forward<M>(b)));
+}
+
+template <class T, class Layout, class M>
+  requires(matrix_detail::matrix_operand<M> && std::is_same_v<matrix_detail::operand_value_t<M>, T>)
+matrix<T> operator*(M&& a, const sparse_matrix<T, Layout>& b) {
+  return matrix_detail::dense_sparse_product(matrix_detail::materialize(std::forward<M>(a)), b);
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "matrix.h"
+
+#include <cstddef>
+#include <utility>
+
+// Matrix with dimensions fixed at compile time and inline storage.
+//
+// Meant for small transforms (3x3, 4x4, ...): nothing is allocated, every
+// operation is constexpr, and the product is fully unrolled. Dimension
+// mismatches are type errors:
+//
+//   constexpr static_matrix<int, 2, 3> a({{1, 2, 3}, {4, 5, 6}});
+//   constexpr static_matrix<int, 3, 2> b({{1, 0}, {0, 1}, {1, 1}});
+//   static_assert((a * b)(1, 1) == 11);
+//
+// view() exposes the storage as a matrix_view, so a static matrix can be an
+// operand of any dynamic matrix operation, and matrix<T>(s.view()) copies it
+// into a dynamic one. The explicit constructor goes the other way.
+
+template <class T, size_t Rows, size_t Cols>
+class static_matrix {
+  static_assert(Rows > 0 && Cols > 0, "static_matrix dimensions must be positive");
+
+public:
+  using value_type = T;
+
+  using reference = T&;
+  using const_reference = const T&;
+
+  using pointer = T*;
+  using const_pointer = const T*;
+
+  using iterator = pointer;
+  using const_iterator = const_pointer;
+
+  using row_iterator = pointer;
+  using const_row_iterator = const_pointer;
+
+  using col_iterator = ColIterator<T>;
+  using const_col_iterator = ColIterator<const T>;
+
+  constexpr static_matrix() = default;
+
+  constexpr static_matrix(const T (&init)[Rows][Cols]) {
+    for (size_t i = 0; i < Rows; ++i) {
+      for (size_t j = 0; j < Cols; ++j) {
+        _data[i * Cols + j] = init[i][j];
+      }
+    }
+  }
+
+  // Copies a dynamic matrix or view, which must be Rows x Cols.
+  template <class M>
+    requires(matrix_detail::is_matrix_v<M> || matrix_detail::is_view_v<M>)
+  explicit static_matrix(const M& m) {
+    for (size_t i = 0; i < Rows; ++i) {
+      for (size_t j = 0; j < Cols; ++j) {
+        _data[i * Cols + j] = m(i, j);
+      }
+    }
+  }
+
+  // Size
+
+  static constexpr size_t rows() {
+    return Rows;
+  }
+  static constexpr size_t cols() {
+    return Cols;
+  }
+  static constexpr size_t size() {
+    return Rows * Cols;
+  }
+  static constexpr bool empty() {
+    return false;
+  }
+  static constexpr size_t stride() {
+    return Cols;
+  }
+  static constexpr bool contiguous() {
+    return true;
+  }
+
+  // Elements access
+
+  constexpr reference operator()(size_t row, size_t col) {
+    return _data[row * Cols + col];
+  }
+  constexpr const_reference operator()(size_t row, size_t col) const {
+    return _data[row * Cols + col];
+  }
+
+  constexpr pointer data() {
+    return _data;
+  }
+  constexpr const_pointer data() const {
+    return _data;
+  }
+
+  matrix_view<T> view() {
+    return matrix_view<T>(_data, Rows, Cols, Cols);
+  }
+  const_matrix_view<T> view() const {
+    return const_matrix_view<T>(_data, Rows, Cols, Cols);
+  }
+
+  // Iterators
+
+  constexpr iterator begin() {
+    return _data;
+  }
+  constexpr const_iterator begin() const {
+    return _data;
+  }
+  constexpr iterator end() {
+    return _data + Rows * Cols;
+  }
+  constexpr const_iterator end() const {
+    return _data + Rows * Cols;
+  }
+
+  constexpr row_iterator row_begin(size_t row) {
+    return _data + row * Cols;
+  }
+  constexpr const_row_iterator row_begin(size_t row) const {
+    return _data + row * Cols;
+  }
+  constexpr row_iterator row_end(size_t row) {
+    return _data + (row + 1) * Cols;
+  }
+  constexpr const_row_iterator row_end(size_t row) const {
+    return _data + (row + 1) * Cols;
+  }
+
+  col_iterator col_begin(size_t col) {
+    return col_iterator(_data + col, Cols);
+  }
+  const_col_iterator col_begin(size_t col) const {
+    return const_col_iterator(_data + col, Cols);
+  }
+  col_iterator col_end(size_t col) {
+    return col_iterator(_data + Rows * Cols + col, Cols);
+  }
+  const_col_iterator col_end(size_t col) const {
+    return const_col_iterator(_data + Rows * Cols + col, Cols);
+  }
+
+  // Comparison
+
+  friend constexpr bool operator==(const static_matrix& left, const static_matrix& right) {
+    for (size_t i = 0; i < Rows * Cols; ++i) {
+      if (!(left._data[i] == right._data[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend constexpr bool operator!=(const static_matrix& left, const static_matrix& right) {
+    return !(left == right);
+  }
+
+  // Arithmetic operations
+
+  constexpr static_matrix& operator+=(const static_matrix& other) {
+    for (size_t i = 0; i < Rows * Cols; ++i) {
+      _data[i] += other._data[i];
+    }
+    return *this;
+  }
+  constexpr static_matrix& operator-=(const static_matrix& other) {
+    for (size_t i = 0; i < Rows * Cols; ++i) {
+      _data[i] -= other._data[i];
+    }
+    return *this;
+  }
+  constexpr static_matrix& operator*=(const_reference factor) {
+    T f = factor;
+    for (size_t i = 0; i < Rows * Cols; ++i) {
+      _data[i] *= f;
+    }
+    return *this;
+  }
+  constexpr static_matrix& operator*=(const static_matrix<T, Cols, Cols>& other) {
+    return *this = *this * other;
+  }
+
+  friend constexpr static_matrix operator+(static_matrix left, const static_matrix& right) {
+    return left += right;
+  }
+  friend constexpr static_matrix operator-(static_matrix left, const static_matrix& right) {
+    return left -= right;
+  }
+  friend constexpr static_matrix operator*(static_matrix left, const_reference factor) {
+    return left *= factor;
+  }
+  friend constexpr static_matrix operator*(const_reference factor, static_matrix right) {
+    return right *= factor;
+  }
+
+  template <size_t Other>
+  friend constexpr static_matrix<T, Rows, Other> operator*(const static_matrix& left,
+                                                          const static_matrix<T, Cols, Other>& right) {
+    return multiply(left, right, std::make_index_sequence<Rows * Other>());
+  }
+
+private:
+  // Element (I / Other, I % Other) of the product for every I, with the dot
+  // products expanded as folds so the whole kernel is straight-line code.
+  template <size_t Other, size_t... I>
+  static constexpr static_matrix<T, Rows, Other> multiply(const static_matrix& left,
+                                                          const static_matrix<T, Cols, Other>& right,
+                                                          std::index_sequence<I...>) {
+    static_matrix<T, Rows, Other> result;
+    ((result(I / Other, I % Other) = dot(left, right, I / Other, I % Other, std::make_index_sequence<Cols>())), ...);
+    return result;
+  }
+
+  template <size_t Other, size_t... P>
+  static constexpr T dot(const static_matrix& left, const static_matrix<T, Cols, Other>& right, size_t row, size_t col,
+                         std::index_sequence<P...>) {
+    return ((left(row, P) * right(P, col)) + ...);
+  }
+
+  T _data[Rows * Cols] = {};
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "gemm.h"
+#include "simd.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+// Strassen-Winograd multiplication for large square products.
+//
+// Off by default. After matrix_strassen::set_cutoff(n), products of square
+// matrices larger than n split into 2 x 2 quadrants and use Winograd's
+// variant of Strassen (7 multiplications and 15 additions instead of 8 and
+// 4), recursing until the quadrants are at most n wide, where the ordinary
+// gemm kernels take over. Odd sizes are handled by peeling off the last row
+// and column and fixing them up with thin gemm calls.
+//
+// The recursion follows the two-temporary schedule of Boyer, Dumas, Pernet
+// and Zhou: every level needs only two half-size scratch blocks, and the
+// scratch for all levels is allocated once up front. Intermediate sums are
+// formed with the SIMD element-wise kernels, row by row on the thread pool.
+//
+// The additions make the rounding error grow faster than for the ordinary
+// kernel, so this is meant for integer element types; for floating point
+// it is still available but trades accuracy for speed.
+
+namespace matrix_detail {
+
+struct strassen_settings {
+  inline static std::atomic<size_t> cutoff{0};
+};
+
+// Whether an n x n by n x n product of T should use strassen_multiply.
+template <class T>
+bool use_strassen(size_t n) {
+  size_t cutoff = strassen_settings::cutoff.load();
+  return gemm_packable<T> && cutoff != 0 && n > cutoff;
+}
+
+// Scratch elements needed by strassen_recurse for an n x n product.
+inline size_t strassen_workspace(size_t n, size_t cutoff) {
+  size_t total = 0;
+  while (n > cutoff) {
+    size_t half = n / 2;
+    total += 2 * half * half;
+    n = half;
+  }
+  return total;
+}
+
+// c = a + b and c = a - b for n x n blocks; c may be a or b.
+template <class T>
+void strassen_add(size_t n, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc) {
+  parallel_for(n, n * n, [&](size_t i) { elementwise_add(a + i * lda, b + i * ldb, c + i * ldc, n); });
+}
+
+template <class T>
+void strassen_sub(size_t n, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc) {
+  parallel_for(n, n * n, [&](size_t i) { elementwise_sub(a + i * lda, b + i * ldb, c + i * ldc, n); });
+}
+
+// C = A * B for n x n blocks, overwriting C. `work` points to at least
+// strassen_workspace(n, cutoff) elements.
+template <class T>
+void strassen_recurse(size_t n, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc, T* work,
+                      size_t cutoff) {
+  if (n <= cutoff) {
+    for (size_t i = 0; i < n; ++i) {
+      std::fill_n(c + i * ldc, n, T(0));
+    }
+    gemm_parallel(n, n, n, a, lda, b, ldb, c, ldc);
+    return;
+  }
+
+  // For odd n, the even core is multiplied recursively and the last row and
+  // column are peeled off:
+  //   C11 = A11 B11 + a12 b21,  [c12; c22] = A [b12; b22],  c21 = a21 B11 + a22 b21.
+  size_t even = n & ~size_t(1);
+  if (even != n) {
+    strassen_recurse(even, a, lda, b, ldb, c, ldc, work, cutoff);
+    gemm_parallel(even, even, 1, a + even, lda, b + even * ldb, ldb, c, ldc);
+    for (size_t i = 0; i < n; ++i) {
+      c[i * ldc + even] = T(0);
+    }
+    std::fill_n(c + even * ldc, even, T(0));
+    gemm_parallel(n, 1, n, a, lda, b + even, ldb, c + even, ldc);
+    gemm_parallel(1, even, n, a + even * lda, lda, b, ldb, c + even * ldc, ldc);
+    return;
+  }
+
+  size_t h = n / 2;
+  const T* a11 = a;
+  const T* a12 = a + h;
+  const T* a21 = a + h * lda;
+  const T* a22 = a + h * lda + h;
+  const T* b11 = b;
+  const T* b12 = b + h;
+  const T* b21 = b + h * ldb;
+  const T* b22 = b + h * ldb + h;
+  T* c11 = c;
+  T* c12 = c + h;
+  T* c21 = c + h * ldc;
+  T* c22 = c + h * ldc + h;
+  T* x = work;
+  T* y = work + h * h;
+  T* next = work + 2 * h * h;
+
+  strassen_sub(h, a11, lda, a21, lda, x, h);                       // S3 = A11 - A21
+  strassen_sub(h, b22, ldb, b12, ldb, y, h);                       // T3 = B22 - B12
+  strassen_recurse(h, x, h, y, h, c21, ldc, next, cutoff);         // P7 = S3 T3
+  strassen_add(h, a21, lda, a22, lda, x, h);                       // S1 = A21 + A22
+  strassen_sub(h, b12, ldb, b11, ldb, y, h);                       // T1 = B12 - B11
+  strassen_recurse(h, x, h, y, h, c22, ldc, next, cutoff);         // P5 = S1 T1
+  strassen_sub(h, x, h, a11, lda, x, h);                           // S2 = S1 - A11
+  strassen_sub(h, b22, ldb, y, h, y, h);                           // T2 = B22 - T1
+  strassen_recurse(h, x, h, y, h, c12, ldc, next, cutoff);         // P6 = S2 T2
+  strassen_sub(h, a12, lda, x, h, x, h);                           // S4 = A12 - S2
+  strassen_recurse(h, x, h, b22, ldb, c11, ldc, next, cutoff);     // P3 = S4 B22
+  strassen_recurse(h, a11, lda, b11, ldb, x, h, next, cutoff);     // P1 = A11 B11
+  strassen_add(h, x, h, c12, ldc, c12, ldc);                       // U2 = P1 + P6
+  strassen_add(h, c12, ldc, c21, ldc, c21, ldc);                   // U3 = U2 + P7
+  strassen_add(h, c12, ldc, c22, ldc, c12, ldc);                   // U4 = U2 + P5
+  strassen_add(h, c21, ldc, c22, ldc, c22, ldc);                   // U7 = U3 + P5
+  strassen_add(h, c12, ldc, c11, ldc, c12, ldc);                   // U5 = U4 + P3
+  strassen_sub(h, y, h, b21, ldb, y, h);                           // T4 = T2 - B21
+  strassen_recurse(h, a22, lda, y, h, c11, ldc, next, cutoff);     // P4 = A22 T4
+  strassen_sub(h, c21, ldc, c11, ldc, c21, ldc);                   // U6 = U3 - P4
+  strassen_recurse(h, a12, lda, b21, ldb, c11, ldc, next, cutoff); // P2 = A12 B21
+  strassen_add(h, x, h, c11, ldc, c11, ldc);                       // U1 = P1 + P2
+}
+
+// C = A * B for n x n row-major matrices, overwriting C, with the current
+// cutoff. C must not overlap A or B.
+template <class T>
+void strassen_multiply(size_t n, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc) {
+  size_t cutoff = std::max<size_t>(strassen_settings::cutoff.load(), 1);
+  gemm_buffer<T> work(std::max<size_t>(strassen_workspace(n, cutoff), 1));
+  strassen_recurse(n, a, lda, b, ldb, c, ldc, work.data(), cutoff);
+}
+
+} // namespace matrix_detail
+
+namespace matrix_strassen {
+
+// Square products of matrices larger than n x n use Strassen-Winograd,
+// recursing down to blocks of at most n x n. 0 (the default) disables it.
+// Values in the low hundreds to a few thousand are sensible; below that the
+// extra additions cost more than the multiplications they save.
+inline void set_cutoff(size_t n) {
+  matrix_detail::strassen_settings::cutoff.store(n);
+}
+
+inline size_t cutoff() {
+  return matrix_detail::strassen_settings::cutoff.load();
+}
+
+} // namespace matrix_strassen
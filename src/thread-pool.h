@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Opt-in multi-threading for the heavy matrix operations.
+//
+// By default everything runs on the calling thread. After
+// matrix_parallel::set_num_threads(n) with n > 1, operations whose amount of
+// work (multiply-adds for products, elements for element-wise operations)
+// reaches matrix_parallel::threshold() are split into tasks and run on a
+// persistent work-stealing pool of n - 1 workers plus the calling thread.
+//
+// A single call can also override these settings with an execution policy,
+// see execution-policy.h.
+//
+// Changing the number of threads while another thread is inside a matrix
+// operation is allowed; that operation finishes on the pool it started with.
+
+namespace matrix_detail {
+
+class thread_pool {
+public:
+  explicit thread_pool(size_t workers)
+      : _workers(workers), _threads(std::make_unique<std::thread[]>(workers)),
+        _deques(std::make_unique<range_deque[]>(workers + 1)) {
+    for (size_t i = 0; i < _workers; ++i) {
+      _threads[i] = std::thread(&thread_pool::worker_loop, this, i + 1);
+    }
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_all();
+    for (size_t i = 0; i < _workers; ++i) {
+      _threads[i].join();
+    }
+  }
+
+  // Number of threads taking part in parallel_for, including the caller.
+  size_t concurrency() const {
+    return _workers + 1;
+  }
+
+  // Calls body(i) for every i in [0, count) and returns once all calls have
+  // finished. Indices are dealt out to the threads in contiguous chunks; a
+  // thread that runs out of work steals from the front of another's chunk.
+  //
+  // If a call throws, the indices not started yet are skipped and the first
+  // exception is rethrown here after every thread has left body.
+  template <class F>
+  void parallel_for(size_t count, F& body) {
+    std::lock_guard submit(_submit_mutex);
+
+    _invoke = [](void* context, size_t index) { (*static_cast<F*>(context))(index); };
+    _context = &body;
+    _error = nullptr;
+    _failed.store(false);
+    _remaining.store(count);
+
+    size_t slots = concurrency();
+    for (size_t slot = 0; slot < slots; ++slot) {
+      std::lock_guard lock(_deques[slot].mutex);
+      _deques[slot].begin = count * slot / slots;
+      _deques[slot].end = count * (slot + 1) / slots;
+    }
+
+    {
+      std::lock_guard lock(_mutex);
+      ++_generation;
+    }
+    _wake.notify_all();
+
+    run_slot(0);
+
+    std::unique_lock lock(_mutex);
+    _done.wait(lock, [this] { return _remaining.load() == 0; });
+    if (_error) {
+      std::rethrow_exception(std::exchange(_error, nullptr));
+    }
+  }
+
+  // True on a thread that is currently executing a pool task; nested
+  // parallel sections run serially there.
+  static bool& in_task() {
+    static thread_local bool flag = false;
+    return flag;
+  }
+
+private:
+  // A work-stealing deque of task indices. Since the tasks of one job are
+  // the contiguous range [begin, end), the deque is just that range: the
+  // owner pops from the back and thieves take from the front.
+  struct alignas(64) range_deque {
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+
+    bool pop_back(size_t& index) {
+      std::lock_guard lock(mutex);
+      if (begin == end) {
+        return false;
+      }
+      index = --end;
+      return true;
+    }
+
+    bool steal_front(size_t& index) {
+      std::lock_guard lock(mutex);
+      if (begin == end) {
+        return false;
+      }
+      index = begin++;
+      return true;
+    }
+  };
+
+  void execute(size_t index) {
+    if (!_failed.load(std::memory_order_relaxed)) {
+      in_task() = true;
+      try {
+        _invoke(_context, index);
+      } catch (...) {
+        std::lock_guard lock(_mutex);
+        if (!_error) {
+          _error = std::current_exception();
+        }
+        _failed.store(true, std::memory_order_relaxed);
+      }
+      in_task() = false;
+    }
+
+    if (_remaining.fetch_sub(1) == 1) {
+      std::lock_guard lock(_mutex);
+      _done.notify_all();
+    }
+  }
+
+  void run_slot(size_t slot) {
+    size_t slots = concurrency();
+    size_t index;
+    while (true) {
+      if (_deques[slot].pop_back(index)) {
+        execute(index);
+        continue;
+      }
+      bool stolen = false;
+      for (size_t i = 1; i < slots && !stolen; ++i) {
+        stolen = _deques[(slot + i) % slots].steal_front(index);
+      }
+      if (!stolen) {
+        return;
+      }
+      execute(index);
+    }
+  }
+
+  void worker_loop(size_t slot) {
+    size_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock lock(_mutex);
+        _wake.wait(lock, [&] { return _stop || _generation != seen; });
+        if (_stop) {
+          return;
+        }
+        seen = _generation;
+      }
+      run_slot(slot);
+    }
+  }
+
+  size_t _workers;
+  std::unique_ptr<std::thread[]> _threads;
+  std::unique_ptr<range_deque[]> _deques;
+
+  std::mutex _submit_mutex;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  size_t _generation = 0;
+  bool _stop = false;
+
+  void (*_invoke)(void*, size_t) = nullptr;
+  void* _context = nullptr;
+  std::atomic<size_t> _remaining{0};
+  std::atomic<bool> _failed{false};
+  std::exception_ptr _error;
+};
+
+// How the calling thread runs the parallelizable parts of an operation:
+// split by the global settings, always serially, or always on the pool.
+enum class parallel_mode { automatic, serial, parallel };
+
+struct parallel_settings {
+  inline static std::atomic<size_t> threads{1};
+  inline static std::atomic<size_t> threshold{size_t(1) << 18};
+
+  static parallel_mode& mode() {
+    static thread_local parallel_mode current = parallel_mode::automatic;
+    return current;
+  }
+};
+
+// Sets the calling thread's parallel_mode for the lifetime of the object.
+class parallel_mode_scope {
+public:
+  explicit parallel_mode_scope(parallel_mode mode) : _saved(parallel_settings::mode()) {
+    parallel_settings::mode() = mode;
+  }
+
+  parallel_mode_scope(const parallel_mode_scope&) = delete;
+  parallel_mode_scope& operator=(const parallel_mode_scope&) = delete;
+
+  ~parallel_mode_scope() {
+    parallel_settings::mode() = _saved;
+  }
+
+private:
+  parallel_mode _saved;
+};
+
+// Threads taking part in a parallel section: the configured number, or all
+// hardware threads when parallelism was requested for a single call while
+// the global setting is serial.
+inline size_t parallel_threads() {
+  size_t threads = parallel_settings::threads.load();
+  if (threads == 1 && parallel_settings::mode() == parallel_mode::parallel) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return threads;
+}
+
+// The pool shared by all operations. Callers keep the returned pointer for
+// the duration of their parallel section, so a request for a different size
+// replaces the shared pool without destroying one that is still in use.
+inline std::shared_ptr<thread_pool> shared_thread_pool(size_t threads) {
+  static std::mutex mutex;
+  static std::shared_ptr<thread_pool> pool;
+
+  std::lock_guard lock(mutex);
+  if (!pool || pool->concurrency() != threads) {
+    pool = std::make_shared<thread_pool>(threads - 1);
+  }
+  return pool;
+}
+
+// Whether an operation doing `work` units of work should be split up.
+inline bool should_parallelize(size_t work) {
+  if (thread_pool::in_task()) {
+    return false;
+  }
+  switch (parallel_settings::mode()) {
+  case parallel_mode::serial:
+    return false;
+  case parallel_mode::parallel:
+    return true;
+  case parallel_mode::automatic:
+    break;
+  }
+  return parallel_settings::threads.load() > 1 && work >= parallel_settings::threshold.load();
+}
+
+// Calls body(i) for i in [0, count), in parallel when `work` is large enough.
+template <class F>
+void parallel_for(size_t count, size_t work, F&& body) {
+  if (count > 1 && should_parallelize(work)) {
+    std::shared_ptr<thread_pool> pool = shared_thread_pool(parallel_threads());
+    pool->parallel_for(count, body);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    body(i);
+  }
+}
+
+// Splits [0, n) into contiguous chunks and calls body(begin, end) for each.
+template <class F>
+void parallel_chunks(size_t n, F&& body) {
+  constexpr size_t GRAIN = 16384;
+
+  if (!should_parallelize(n)) {
+    body(size_t(0), n);
+    return;
+  }
+  size_t count = (n + GRAIN - 1) / GRAIN;
+  parallel_for(count, n, [&](size_t i) { body(i * GRAIN, std::min(n, (i + 1) * GRAIN)); });
+}
+
+} // namespace matrix_detail
+
+namespace matrix_parallel {
+
+// Sets the number of threads used by parallel operations (including the
+// calling one). 0 means std::thread::hardware_concurrency(); 1 disables
+// parallelism.
+inline void set_num_threads(size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  matrix_detail::parallel_settings::threads.store(threads);
+}
+
+inline size_t num_threads() {
+  return matrix_detail::parallel_settings::threads.load();
+}
+
+// Operations with less work than this always run serially.
+inline void set_threshold(size_t work) {
+  matrix_detail::parallel_settings::threshold.store(work);
+}
+
+inline size_t threshold() {
+  return matrix_detail::parallel_settings::threshold.load();
+}
+
+} // namespace matrix_parallel
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Transpose kernels.
+//
+// Both the out-of-place and the square in-place kernel are cache-oblivious:
+// they halve the longer side of the current block until it fits in
+// TRANSPOSE_BLOCK x TRANSPOSE_BLOCK, so at every level of the memory
+// hierarchy the source and destination tiles being worked on fit in cache
+// and every cache line (and page) fetched is fully used. Rectangular packed
+// matrices are transposed in place by following the cycles of the index
+// permutation, which needs one bit per element instead of a second buffer.
+
+namespace matrix_detail {
+
+inline constexpr size_t TRANSPOSE_BLOCK = 16;
+
+// dst(j, i) = src(i, j) for a rows x cols source. The destination may have a
+// wider element type, which every element is converted to.
+template <class T, class U>
+void transpose_block(size_t rows, size_t cols, const T* src, size_t src_stride, U* dst, size_t dst_stride) {
+  if (rows <= TRANSPOSE_BLOCK && cols <= TRANSPOSE_BLOCK) {
+    for (size_t i = 0; i < rows; ++i) {
+      for (size_t j = 0; j < cols; ++j) {
+        dst[j * dst_stride + i] = src[i * src_stride + j];
+      }
+    }
+  } else if (rows >= cols) {
+    size_t half = rows / 2;
+    transpose_block(half, cols, src, src_stride, dst, dst_stride);
+    transpose_block(rows - half, cols, src + half * src_stride, src_stride, dst + half, dst_stride);
+  } else {
+    size_t half = cols / 2;
+    transpose_block(rows, half, src, src_stride, dst, dst_stride);
+    transpose_block(rows, cols - half, src + half, src_stride, dst + half * dst_stride, dst_stride);
+  }
+}
+
+// Out-of-place transpose of a rows x cols source into a cols x rows
+// destination, split into bands of source rows on the thread pool.
+template <class T, class U>
+void transpose_copy(size_t rows, size_t cols, const T* src, size_t src_stride, U* dst, size_t dst_stride) {
+  constexpr size_t BAND = 16 * TRANSPOSE_BLOCK;
+
+  size_t bands = (rows + BAND - 1) / BAND;
+  parallel_for(bands, rows * cols, [&](size_t band) {
+    size_t begin = band * BAND;
+    size_t end = std::min(rows, begin + BAND);
+    transpose_block(end - begin, cols, src + begin * src_stride, src_stride, dst + begin, dst_stride);
+  });
+}
+
+// Swaps a(i, j) with b(j, i) for a rows x cols block a and a cols x rows
+// block b that do not overlap.
+template <class T>
+void transpose_swap(size_t rows, size_t cols, T* a, T* b, size_t stride) {
+  using std::swap;
+
+  if (rows <= TRANSPOSE_BLOCK && cols <= TRANSPOSE_BLOCK) {
+    for (size_t i = 0; i < rows; ++i) {
+      for (size_t j = 0; j < cols; ++j) {
+        swap(a[i * stride + j], b[j * stride + i]);
+      }
+    }
+  } else if (rows >= cols) {
+    size_t half = rows / 2;
+    transpose_swap(half, cols, a, b, stride);
+    transpose_swap(rows - half, cols, a + half * stride, b + half, stride);
+  } else {
+    size_t half = cols / 2;
+    transpose_swap(rows, half, a, b, stride);
+    transpose_swap(rows, cols - half, a + half, b + half * stride, stride);
+  }
+}
+
+// In-place transpose of an n x n block: the diagonal blocks are transposed
+// recursively and the off-diagonal ones swapped with each other.
+template <class T>
+void transpose_square(size_t n, T* a, size_t stride) {
+  using std::swap;
+
+  if (n <= TRANSPOSE_BLOCK) {
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = i + 1; j < n; ++j) {
+        swap(a[i * stride + j], a[j * stride + i]);
+      }
+    }
+    return;
+  }
+  size_t half = n / 2;
+  transpose_square(half, a, stride);
+  transpose_square(n - half, a + half * stride + half, stride);
+  transpose_swap(half, n - half, a + half, a + half * stride, stride);
+}
+
+// In-place transpose of a packed rows x cols matrix into a packed cols x rows
+// one. Element k = i * cols + j moves to j * rows + i, which is
+// k * rows mod (size - 1) for every k but the last; each cycle of that
+// permutation is rotated once, starting from its first unvisited element.
+template <class T>
+void transpose_cycles(size_t rows, size_t cols, T* a) {
+  size_t size = rows * cols;
+  if (rows <= 1 || cols <= 1) {
+    return;
+  }
+
+  size_t last = size - 1;
+  std::vector<unsigned long long> visited((size + 63) / 64);
+  auto test_and_set = [&](size_t k) {
+    unsigned long long bit = 1ULL << (k % 64);
+    bool seen = (visited[k / 64] & bit) != 0;
+    visited[k / 64] |= bit;
+    return seen;
+  };
+
+  for (size_t start = 1; start < last; ++start) {
+    if (test_and_set(start)) {
+      continue;
+    }
+    // Walk the cycle backwards: the element that belongs at k comes from
+    // k * cols mod last, the inverse of the forward move.
+    T carried = std::move(a[start]);
+    size_t k = start;
+    while (true) {
+      size_t from = k * cols % last;
+      if (from == start) {
+        break;
+      }
+      a[k] = std::move(a[from]);
+      test_and_set(from);
+      k = from;
+    }
+    a[k] = std::move(carried);
+  }
+}
+
+} // namespace matrix_detail
@@ -0,0 +1,146 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+class allocators_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+    element::reset_allocations();
+  }
+};
+
+template <class M>
+void fill_matrix(M& m) {
+  for (size_t i = 0; i < m.rows(); ++i) {
+    for (size_t j = 0; j < m.cols(); ++j) {
+      m(i, j) = elem(i, j);
+    }
+  }
+}
+
+bool aligned_to(const void* p, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(p) % alignment == 0;
+}
+
+} // namespace
+
+TEST_F(allocators_test, default_allocator_uses_class_operator_new) {
+  matrix<element, default_allocator<element>> a(4, 5);
+  expect_allocations(20);
+  EXPECT_EQ(20, element::allocations);
+}
+
+TEST_F(allocators_test, pool_matrix) {
+  pool_resource pool;
+  pool_allocator<double> alloc(pool);
+
+  matrix<double, pool_allocator<double>> a(10, 20, alloc);
+  matrix<double, pool_allocator<double>> b(10, 20, alloc);
+  fill_matrix(a);
+  fill_matrix(b);
+  EXPECT_TRUE(aligned_to(a.data(), pool_resource::ALIGNMENT));
+
+  matrix<double, pool_allocator<double>> c(a + b * 2.0, alloc);
+  EXPECT_EQ(alloc, c.get_allocator());
+  for (size_t i = 0; i < c.rows(); ++i) {
+    for (size_t j = 0; j < c.cols(); ++j) {
+      EXPECT_EQ(3.0 * elem(i, j), c(i, j));
+    }
+  }
+
+  // A freed block is handed out again for the next request of its class.
+  const double* data = c.data();
+  c = matrix<double, pool_allocator<double>>(alloc);
+  matrix<double, pool_allocator<double>> d(20, 10, alloc);
+  EXPECT_EQ(data, d.data());
+}
+
+TEST_F(allocators_test, pool_large_blocks) {
+  pool_resource pool;
+  pool_allocator<int> alloc(pool);
+
+  matrix<int, pool_allocator<int>> a(1000, 1000, alloc);
+  fill_matrix(a);
+  matrix<int, pool_allocator<int>> b = a;
+  EXPECT_TRUE(a == b);
+}
+
+TEST_F(allocators_test, shared_pool) {
+  matrix<float, pool_allocator<float>> a(3, 3);
+  EXPECT_EQ(&pool_resource::shared(), a.get_allocator().resource());
+}
+
+TEST_F(allocators_test, arena_matrix) {
+  arena_resource arena;
+  arena_allocator<int> alloc(arena);
+
+  {
+    matrix<int, arena_allocator<int>> a(8, 8, alloc);
+    matrix<int, arena_allocator<int>> b(8, 8, alloc);
+    fill_matrix(a);
+    fill_matrix(b);
+    EXPECT_TRUE(aligned_to(a.data(), arena_resource::ALIGNMENT));
+
+    matrix<int, arena_allocator<int>> c = a * b;
+    EXPECT_EQ(alloc, c.get_allocator());
+
+    matrix<int> expected(8, 8);
+    matrix<int> da(8, 8);
+    fill(da);
+    expected = da * da;
+    for (size_t i = 0; i < c.rows(); ++i) {
+      for (size_t j = 0; j < c.cols(); ++j) {
+        EXPECT_EQ(expected(i, j), c(i, j));
+      }
+    }
+  }
+
+  EXPECT_EQ(3 * 8 * 8 * sizeof(int), arena.allocated());
+  arena.release();
+  EXPECT_EQ(0, arena.allocated());
+}
+
+TEST_F(allocators_test, arena_assignment_keeps_allocator) {
+  arena_resource first;
+  arena_resource second;
+
+  matrix<int, arena_allocator<int>> a(4, 4, arena_allocator<int>(first));
+  matrix<int, arena_allocator<int>> b(2, 2, arena_allocator<int>(second));
+  fill_matrix(a);
+
+  b = a;
+  EXPECT_EQ(&second, b.get_allocator().resource());
+  EXPECT_TRUE(a == b);
+
+  matrix<int, arena_allocator<int>> c{arena_allocator<int>(second)};
+  c = std::move(a);
+  EXPECT_EQ(&second, c.get_allocator().resource());
+  EXPECT_TRUE(b == c);
+
+  matrix<int, arena_allocator<int>> d = std::move(b);
+  EXPECT_EQ(&second, d.get_allocator().resource());
+  EXPECT_TRUE(c == d);
+}
+
+TEST_F(allocators_test, mixed_allocators_in_expression) {
+  arena_resource arena;
+  matrix<int, arena_allocator<int>> a(3, 4, arena_allocator<int>(arena));
+  matrix<int> b(3, 4);
+  fill_matrix(a);
+  fill(b);
+
+  matrix<int> c = a + b;
+  matrix<int, arena_allocator<int>> d(a - b + b, arena_allocator<int>(arena));
+  for (size_t i = 0; i < c.rows(); ++i) {
+    for (size_t j = 0; j < c.cols(); ++j) {
+      EXPECT_EQ(2 * static_cast<int>(elem(i, j)), c(i, j));
+      EXPECT_EQ(a(i, j), d(i, j));
+    }
+  }
+}
@@ -0,0 +1,119 @@
+#include "batched.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+using batched_test = settings_test;
+
+template <class T, size_t Rows, size_t Cols>
+batched_matrix<T, Rows, Cols> make_batch(size_t count, size_t seed) {
+  batched_matrix<T, Rows, Cols> batch(count);
+  for (size_t l = 0; l < count; ++l) {
+    for (size_t i = 0; i < Rows; ++i) {
+      for (size_t j = 0; j < Cols; ++j) {
+        batch(l, i, j) = static_cast<T>((l * 5 + elem(i, j) + seed) % 17);
+      }
+    }
+  }
+  return batch;
+}
+
+// Checks every product of the batch against static_matrix.
+template <class T, size_t Rows, size_t Inner, size_t Cols>
+void check_products(size_t count) {
+  auto a = make_batch<T, Rows, Inner>(count, 1);
+  auto b = make_batch<T, Inner, Cols>(count, 2);
+  batched_matrix<T, Rows, Cols> c = a * b;
+  ASSERT_EQ(count, c.count());
+  for (size_t l = 0; l < count; ++l) {
+    ASSERT_EQ(a.get(l) * b.get(l), c.get(l)) << "matrix " << l;
+  }
+}
+
+} // namespace
+
+TEST(batched, layout) {
+  batched_matrix<double, 2, 3> a(5);
+  EXPECT_EQ(5, a.count());
+  EXPECT_EQ(2, a.rows());
+  EXPECT_EQ(3, a.cols());
+  EXPECT_EQ(8, a.group_size());
+  EXPECT_EQ(1, a.groups());
+  EXPECT_EQ(0, reinterpret_cast<std::uintptr_t>(a.data()) % 64);
+
+  static_matrix<double, 2, 3> m({{1, 2, 3}, {4, 5, 6}});
+  a.set(3, m);
+  EXPECT_EQ(m, a.get(3));
+  EXPECT_EQ((static_matrix<double, 2, 3>()), a.get(2));
+  EXPECT_EQ(6, a(3, 1, 2));
+  // Matrices of a group are interleaved element by element.
+  EXPECT_EQ(a.data() + 5 * 8 + 3, &a(3, 1, 2));
+  EXPECT_EQ(&a(3, 1, 2) + 1, &a(4, 1, 2));
+
+  batched_matrix<float, 2, 2> b(17);
+  EXPECT_EQ(16, b.group_size());
+  EXPECT_EQ(2, b.groups());
+  EXPECT_EQ(b.data() + 4 * 16, &b(16, 0, 0));
+}
+
+TEST(batched, copy_move_compare) {
+  auto a = make_batch<int, 3, 3>(21, 0);
+  batched_matrix<int, 3, 3> b = a;
+  EXPECT_EQ(a, b);
+  b(20, 2, 2) += 1;
+  EXPECT_NE(a, b);
+  EXPECT_NE(a, (batched_matrix<int, 3, 3>(20)));
+
+  batched_matrix<int, 3, 3> c = std::move(b);
+  EXPECT_TRUE(b.empty());
+  EXPECT_EQ(a(7, 1, 0), c(7, 1, 0));
+  b = c;
+  EXPECT_EQ(b, c);
+}
+
+TEST(batched, square_products) {
+  check_products<float, 2, 2, 2>(1000);
+  check_products<double, 3, 3, 3>(37);
+  check_products<int, 4, 4, 4>(100);
+  check_products<std::int64_t, 8, 8, 8>(19);
+}
+
+TEST(batched, rectangular_products) {
+  check_products<float, 2, 3, 5>(33);
+  check_products<double, 4, 1, 4>(9);
+  check_products<unsigned, 1, 6, 2>(64);
+}
+
+TEST(batched, generic_types) {
+  check_products<short, 4, 4, 4>(70);
+  check_products<std::uint8_t, 3, 2, 3>(130);
+}
+
+TEST(batched, empty_batch) {
+  batched_matrix<float, 4, 4> a;
+  EXPECT_TRUE(a.empty());
+  EXPECT_TRUE((a * a).empty());
+}
+
+TEST(batched, mismatched_counts) {
+  batched_matrix<float, 4, 4> a(17);
+  batched_matrix<float, 4, 4> b(40);
+  batched_matrix<float, 4, 4> out(40);
+  EXPECT_THROW(multiply(a, b, out), std::invalid_argument);
+  EXPECT_THROW(multiply(b, a, out), std::invalid_argument);
+  EXPECT_THROW(a * b, std::invalid_argument);
+}
+
+TEST_F(batched_test, parallel) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  check_products<float, 4, 4, 4>(5000);
+  check_products<double, 3, 5, 2>(3001);
+}
@@ -3,6 +3,8 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdint>
+
 namespace {
 
 class ctors_test : public ::testing::Test {
@@ -185,8 +187,148 @@ TEST_F(ctors_test, copy_assignment_empty) {
   expect_allocations(SIZE_B);
 }
 
+TEST_F(ctors_test, move_ctor) {
+  constexpr size_t ROWS = 40;
+  constexpr size_t COLS = 100;
+  constexpr size_t SIZE = ROWS * COLS;
+
+  matrix<element> a(ROWS, COLS);
+  fill(a);
+  const element* data = a.data();
+
+  matrix<element> b = std::move(a);
+
+  EXPECT_EQ(data, b.data());
+  EXPECT_EQ(ROWS, b.rows());
+  EXPECT_EQ(COLS, b.cols());
+  expect_empty(a);
+
+  expect_allocations(SIZE);
+}
+
+TEST_F(ctors_test, move_assignment) {
+  constexpr size_t ROWS_A = 40;
+  constexpr size_t COLS_A = 100;
+  constexpr size_t SIZE_A = ROWS_A * COLS_A;
+
+  constexpr size_t ROWS_B = 15;
+  constexpr size_t COLS_B = 15;
+  constexpr size_t SIZE_B = ROWS_B * COLS_B;
+
+  matrix<element> a(ROWS_A, COLS_A);
+  matrix<element> b(ROWS_B, COLS_B);
+  fill(a);
+  const element* data = a.data();
+
+  b = std::move(a);
+
+  EXPECT_EQ(data, b.data());
+  expect_empty(a);
+  for (size_t i = 0; i < ROWS_A; ++i) {
+    for (size_t j = 0; j < COLS_A; ++j) {
+      EXPECT_EQ(elem(i, j), b(i, j));
+    }
+  }
+
+  expect_allocations(SIZE_A + SIZE_B);
+}
+
+TEST_F(ctors_test, copy_assignment_same_size_reuses_buffer) {
+  constexpr size_t SIZE = 6;
+
+  matrix<element> a({
+      {1, 2, 3},
+      {4, 5, 6},
+  });
+  matrix<element> b(3, 2);
+  const element* data = b.data();
+
+  b = a;
+
+  EXPECT_EQ(data, b.data());
+  expect_equal(a, b);
+
+  expect_allocations(SIZE * 2);
+}
+
 // int main(int argc, char** argv) 
 // {
 //   testing::InitGoogleTest(&argc, argv);
 //   return RUN_ALL_TESTS();
 // }
+
+TEST_F(ctors_test, small_matrix_is_inline) {
+  matrix<element> a(4, 4);
+  fill(a);
+  matrix<element> b({
+      {1, 2, 3},
+      {4, 5, 6},
+  });
+  matrix<element> c = a;
+  matrix<element> d = a + c;
+  c = b;
+
+  EXPECT_NE(nullptr, a.data());
+  EXPECT_GE(a.data(), reinterpret_cast<const element*>(&a));
+  EXPECT_LT(a.data(), reinterpret_cast<const element*>(&a + 1));
+  expect_equal(b, c);
+  expect_allocations(0);
+}
+
+TEST_F(ctors_test, small_matrix_move) {
+  matrix<element> a(3, 5);
+  fill(a);
+  matrix<element> expected = a;
+
+  matrix<element> b = std::move(a);
+  expect_empty(a);
+  expect_equal(expected, b);
+  EXPECT_NE(expected.data(), b.data());
+
+  matrix<element> c(20, 20);
+  c = std::move(b);
+  expect_empty(b);
+  expect_equal(expected, c);
+
+  // Moving a heap matrix into one that was using its inline buffer.
+  matrix<element> big(20, 20);
+  fill(big);
+  const element* data = big.data();
+  c = std::move(big);
+  EXPECT_EQ(data, c.data());
+  expect_allocations(2 * 400);
+}
+
+TEST_F(ctors_test, small_empty_has_no_data) {
+  matrix<element> a(0, 3);
+  expect_empty(a);
+  matrix<element> b = a;
+  expect_empty(b);
+  matrix<element> c = std::move(a);
+  expect_empty(c);
+}
+
+TEST_F(ctors_test, small_padded_uses_allocator) {
+  matrix<double> a(2, 3, padded);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(a.data()) % 64);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(&a(1, 0)) % 64);
+}
+
+TEST_F(ctors_test, small_copy_assignment_keeps_storage_kind) {
+  // Both hold 16 doubles: a 4x4 packed matrix inline, two padded rows on the
+  // heap.
+  matrix<double> padded_matrix(2, 1, padded);
+  padded_matrix(1, 0) = 5;
+  matrix<double> a(4, 4);
+  a = padded_matrix;
+  EXPECT_EQ(5, a(1, 0));
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(&a(1, 0)) % 64);
+  EXPECT_FALSE(a.data() >= reinterpret_cast<const double*>(&a) && a.data() < reinterpret_cast<const double*>(&a + 1));
+
+  matrix<double> b(4, 4);
+  b(3, 3) = 7;
+  padded_matrix = b;
+  EXPECT_EQ(7, padded_matrix(3, 3));
+  EXPECT_GE(padded_matrix.data(), reinterpret_cast<const double*>(&padded_matrix));
+  EXPECT_LT(padded_matrix.data(), reinterpret_cast<const double*>(&padded_matrix + 1));
+}
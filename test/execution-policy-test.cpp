@@ -0,0 +1,124 @@
+#include "execution-policy.h"
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace {
+
+using execution_policy_test = settings_test;
+
+// Element type counting the additions that run as thread pool tasks.
+struct probe {
+  int value = 0;
+
+  inline static std::atomic<size_t> pooled{0};
+
+  friend probe operator+(const probe& left, const probe& right) {
+    if (matrix_detail::thread_pool::in_task()) {
+      ++pooled;
+    }
+    return {left.value + right.value};
+  }
+
+  probe& operator+=(const probe& other) {
+    return *this = *this + other;
+  }
+
+  friend bool operator==(const probe&, const probe&) = default;
+};
+
+// Checks every policy overload against the operators.
+template <class P>
+void check(const P& policy) {
+  matrix<int> a = make_matrix<int>(40, 30, 1);
+  matrix<int> b = make_matrix<int>(40, 30, 2);
+  matrix<int> c = make_matrix<int>(30, 20, 3);
+
+  expect_equal(a + b, add(policy, a, b));
+  expect_equal(a - b, subtract(policy, a, b));
+  expect_equal(a * 3, scale(policy, a, 3));
+  expect_equal(a * c, multiply(policy, a, c));
+  expect_equal(a + b * 2, add(policy, a, b * 2));
+  expect_equal(b.transpose() * a, multiply(policy, b.transpose(), a));
+
+  // An expiring operand's buffer holds the result.
+  matrix<int> owner = a;
+  const int* storage = owner.data();
+  matrix<int> sum = add(policy, std::move(owner), b);
+  EXPECT_EQ(storage, sum.data());
+
+  EXPECT_TRUE(equal(policy, a, matrix<int>(a)));
+  EXPECT_TRUE(equal(policy, a + b, add(policy, a, b)));
+  EXPECT_TRUE(equal(policy, col_major_matrix<int>(a), a));
+  EXPECT_TRUE(equal(policy, a.transpose(), col_major_matrix<int>(a).transpose()));
+  EXPECT_FALSE(equal(policy, a, b));
+  EXPECT_FALSE(equal(policy, a, a.block(0, 0, 40, 29)));
+  matrix<int> last = a;
+  last(39, 29) += 1;
+  EXPECT_FALSE(equal(policy, a, last));
+
+  matrix<int> d = a;
+  add_assign(policy, d, b);
+  sub_assign(policy, d, a * 2);
+  scale_assign(policy, d, 5);
+  add_assign(policy, d.block(0, 0, 10, 10), c.block(0, 0, 10, 10));
+  matrix<int> expected = (b - a) * 5;
+  expected.block(0, 0, 10, 10) += c.block(0, 0, 10, 10);
+  expect_equal(expected, d);
+}
+
+} // namespace
+
+TEST(execution_policy, library_policies) {
+  check(matrix_parallel::seq);
+  check(matrix_parallel::par);
+}
+
+#if MATRIX_STD_EXECUTION
+TEST(execution_policy, std_policies) {
+  check(std::execution::seq);
+  check(std::execution::par);
+  check(std::execution::par_unseq);
+  check(std::execution::unseq);
+}
+#endif
+
+TEST_F(execution_policy_test, overrides_global_settings) {
+  // 300 x 100 elements make two chunks of a flat element-wise pass.
+  matrix<probe> a(300, 100);
+  size_t size = a.size();
+
+  probe::pooled = 0;
+  matrix<probe> b = a + a;
+  EXPECT_EQ(0, probe::pooled);
+  b = add(matrix_parallel::par, a, a);
+  EXPECT_EQ(size, probe::pooled);
+
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  probe::pooled = 0;
+  b = add(matrix_parallel::seq, a, a);
+  EXPECT_EQ(0, probe::pooled);
+  b = a + a;
+  EXPECT_EQ(size, probe::pooled);
+  probe::pooled = 0;
+  add_assign(matrix_parallel::par, b, a);
+  EXPECT_EQ(size, probe::pooled);
+
+  // The override ends with the call.
+  EXPECT_EQ(matrix_detail::parallel_mode::automatic, matrix_detail::parallel_settings::mode());
+}
+
+TEST(execution_policy, large) {
+  matrix<double> a = make_matrix<double>(300, 200, 1);
+  matrix<double> b = make_matrix<double>(200, 300, 2);
+  matrix<double> product = multiply(matrix_parallel::par, a, b);
+  expect_equal(a * b, product);
+  EXPECT_TRUE(equal(matrix_parallel::par, product, a * b));
+  expect_equal(a * 2.0 + a, add(matrix_parallel::par, scale(matrix_parallel::par, a, 2.0), a));
+}
@@ -0,0 +1,161 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace {
+
+using gemm_test = settings_test;
+
+// Checks gemm, addmul and submul against the same update written with
+// temporaries, for an m x k by k x n product.
+template <class T>
+void check(size_t m, size_t n, size_t k) {
+  matrix<T> a = make_matrix<T>(m, k, 1);
+  matrix<T> b = make_matrix<T>(k, n, 2);
+  matrix<T> c = make_matrix<T>(m, n, 3);
+
+  matrix<T> d = c;
+  gemm(T(3), a, b, T(2), d);
+  expect_equal(a * b * T(3) + c * T(2), d);
+
+  d = c;
+  addmul(d, a, b);
+  expect_equal(c + a * b, d);
+
+  d = c;
+  submul(d, a, b);
+  expect_equal(c - a * b, d);
+}
+
+} // namespace
+
+TEST(gemm, sizes) {
+  for (size_t size : {1, 2, 5, 17, 40, 70}) {
+    check<int>(size, size, size);
+    check<double>(size, size + 3, size * 2);
+    check<unsigned>(size + 1, size, 3);
+  }
+  check<float>(130, 90, 300);
+  check<element>(9, 11, 13);
+}
+
+TEST(gemm, alpha_and_beta) {
+  matrix<double> a = make_matrix<double>(20, 30);
+  matrix<double> b = make_matrix<double>(30, 10);
+  matrix<double> c = make_matrix<double>(20, 10);
+
+  matrix<double> d = c;
+  gemm(1.0, a, b, 1.0, d);
+  expect_equal(c + a * b, d);
+
+  d = c;
+  gemm(0.0, a, b, -1.0, d);
+  expect_equal(c * -1.0, d);
+
+  // beta == 0 never reads C.
+  d = c;
+  d(3, 4) = std::numeric_limits<double>::quiet_NaN();
+  gemm(0.5, a, b, 0.0, d);
+  expect_equal(a * b * 0.5, d);
+
+  d(0, 0) = std::numeric_limits<double>::quiet_NaN();
+  gemm(0.0, a, b, 0.0, d);
+  expect_equal(matrix<double>(20, 10), d);
+}
+
+TEST(gemm, views_and_expressions) {
+  matrix<int> a = make_matrix<int>(30, 20);
+  matrix<int> b = make_matrix<int>(20, 25);
+  matrix<int> c = make_matrix<int>(40, 40);
+
+  // Operands are transposed views and expressions, the destination a block.
+  matrix<int> expected = c;
+  expected.block(5, 10, 25, 30) += matrix<int>(b.transpose() * a.transpose() * 2);
+  gemm(2, b.transpose(), a.transpose(), 1, c.block(5, 10, 25, 30));
+  expect_equal(expected, c);
+
+  matrix<int> x = make_matrix<int>(20, 20, 4);
+  matrix<int> y = x;
+  addmul(y, x + x, x.transpose());
+  expect_equal(x + (x + x) * x.transpose(), y);
+}
+
+TEST(gemm, destination_aliases_operand) {
+  matrix<int> a = make_matrix<int>(12, 12, 1);
+  matrix<int> b = make_matrix<int>(12, 12, 2);
+
+  matrix<int> c = a;
+  addmul(c, c, b);
+  expect_equal(a + a * b, c);
+
+  c = a;
+  submul(c, b, c);
+  expect_equal(a - b * a, c);
+
+  c = a;
+  gemm(2, c, c.transpose(), 3, c);
+  expect_equal(a * a.transpose() * 2 + a * 3, c);
+
+  // A block of C as the operand.
+  c = a;
+  matrix<int> block(c.block(0, 0, 12, 6));
+  addmul(c.block(0, 6, 12, 6), c.block(0, 0, 12, 6), b.block(0, 0, 6, 6));
+  expect_equal(matrix<int>(a.block(0, 6, 12, 6)) + block * b.block(0, 0, 6, 6), c.block(0, 6, 12, 6));
+}
+
+TEST(gemm, pool_allocated_operands) {
+  using pool_matrix = matrix<double, pool_allocator<double>>;
+  pool_resource pool;
+  pool_allocator<double> alloc(pool);
+  matrix<double> a = make_matrix<double>(15, 15, 1);
+  matrix<double> b = make_matrix<double>(15, 15, 2);
+  pool_matrix pa(a.block(0, 0, 15, 15), alloc);
+  pool_matrix pb(b.block(0, 0, 15, 15), alloc);
+  auto copy = [](const auto& m) { return matrix<double>(m.block(0, 0, m.rows(), m.cols())); };
+
+  pool_matrix c = pa;
+  addmul(c, pa, pb);
+  expect_equal(a + a * b, copy(c));
+
+  c = pa;
+  submul(c, pb, pa);
+  expect_equal(a - b * a, copy(c));
+
+  // Aliased operands are copied out before C is written.
+  c = pa;
+  gemm(2.0, c, pb, 3.0, c);
+  expect_equal(a * b * 2.0 + a * 3.0, copy(c));
+
+  c = pa;
+  addmul(c, pb, c);
+  expect_equal(a + b * a, copy(c));
+
+  col_major_matrix<double, pool_allocator<double>> cc(pa, alloc);
+  addmul(cc, cc, pb);
+  expect_equal(a + a * b, copy(cc));
+}
+
+TEST(gemm, no_temporaries) {
+  matrix<element> a(8, 8);
+  matrix<element> b(8, 8);
+  matrix<element> c(8, 8);
+  fill(a);
+  fill(b);
+  element::reset_allocations();
+  addmul(c, a, b);
+  submul(c, a, b);
+  gemm(element(2), a, b, element(1), c);
+  expect_allocations(0);
+}
+
+TEST_F(gemm_test, parallel) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  check<int>(100, 90, 80);
+  check<double>(150, 200, 70);
+}
@@ -0,0 +1,124 @@
+#include "gemv.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace {
+
+using gemv_test = settings_test;
+
+// x as an n x 1 matrix, whose storage is also the span passed to multiply.
+template <class T>
+matrix<T> make_vector(size_t n) {
+  return make_matrix<T>(n, 1, 5);
+}
+
+template <class T>
+std::span<const T> span_of(const matrix<T>& v) {
+  return {v.data(), v.size()};
+}
+
+// Checks y = A x and y = A^T x against the general product.
+template <class T, class M>
+void check(const M& a) {
+  matrix<T> x = make_vector<T>(a.cols());
+  matrix<T> y(a.rows(), 1);
+  multiply(a, span_of(x), std::span<T>(y.data(), y.size()));
+  expect_equal(matrix<T>(a) * x, y);
+
+  matrix<T> xt = make_vector<T>(a.rows());
+  matrix<T> yt(a.cols(), 1);
+  multiply_transposed(a, span_of(xt), std::span<T>(yt.data(), yt.size()));
+  expect_equal(matrix<T>(a.transpose()) * xt, yt);
+}
+
+template <class T>
+void check_sizes() {
+  for (size_t rows : {1, 3, 4, 5, 17, 64, 100}) {
+    for (size_t cols : {1, 2, 7, 8, 33, 130}) {
+      check<T>(make_matrix<T>(rows, cols));
+    }
+  }
+}
+
+} // namespace
+
+TEST(gemv, sizes) {
+  check_sizes<int>();
+  check_sizes<std::int64_t>();
+  check_sizes<float>();
+  check_sizes<double>();
+  check_sizes<unsigned short>();
+  check_sizes<element>();
+}
+
+TEST(gemv, views) {
+  matrix<double> a = make_matrix<double>(40, 30);
+  check<double>(a.block(0, 0, 40, 30));
+  check<double>(a.block(3, 5, 20, 17));
+  check<double>(a.transpose());
+  check<double>(a.block(1, 2, 30, 9).transpose());
+  check<double>(a.row(7));
+  check<double>(a.col(4));
+
+  matrix<int> padded_matrix(13, 9, padded);
+  fill(padded_matrix);
+  check<int>(padded_matrix);
+  check<int>(static_cast<const matrix<int>&>(padded_matrix).block(2, 1, 11, 8));
+}
+
+TEST(gemv, large) {
+  // Longer than one block of y in the row update kernel.
+  check<float>(make_matrix<float>(3, 2500));
+  check<float>(make_matrix<float>(2500, 3));
+}
+
+TEST(gemv, plain_arrays) {
+  matrix<int> a({{1, 2, 3}, {4, 5, 6}});
+  int x[] = {1, 0, -1};
+  int y[2];
+  multiply(a, x, y);
+  EXPECT_EQ(-2, y[0]);
+  EXPECT_EQ(-2, y[1]);
+
+  int xt[] = {1, 1};
+  int yt[3];
+  multiply_transposed(a, xt, yt);
+  EXPECT_EQ(5, yt[0]);
+  EXPECT_EQ(7, yt[1]);
+  EXPECT_EQ(9, yt[2]);
+}
+
+TEST(gemv, empty) {
+  multiply(matrix<int>(3, 0), std::span<const int>(), std::span<int>());
+  multiply(matrix<int>(), std::span<const int>(), std::span<int>());
+  multiply_transposed(matrix<int>(), std::span<const int>(), std::span<int>());
+}
+
+TEST(gemv, mismatched_sizes) {
+  matrix<int> a(2, 3);
+  int x2[2] = {};
+  int x3[3] = {};
+  int y2[2];
+  int y3[3];
+  EXPECT_THROW(multiply(a, x2, y2), std::invalid_argument);
+  EXPECT_THROW(multiply(a, x3, y3), std::invalid_argument);
+  EXPECT_THROW(multiply_transposed(a, x3, y3), std::invalid_argument);
+  EXPECT_THROW(multiply_transposed(a, x2, y2), std::invalid_argument);
+
+  // A 3x0 matrix is empty, so it takes an empty y.
+  int y[3] = {1, 2, 3};
+  EXPECT_THROW(multiply(matrix<int>(3, 0), std::span<const int>(), y), std::invalid_argument);
+  EXPECT_EQ(1, y[0]);
+}
+
+TEST_F(gemv_test, parallel) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  check<int>(make_matrix<int>(1000, 300));
+  check<double>(make_matrix<double>(300, 3000));
+}
@@ -0,0 +1,256 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+
+namespace {
+
+using layout_test = settings_test;
+
+// Checks every product of an m x k and a k x n operand, each stored either
+// way, against the row-major product.
+template <class T>
+void check_products(size_t m, size_t n, size_t k) {
+  matrix<T> a = make_matrix<T>(m, k, 1);
+  matrix<T> b = make_matrix<T>(k, n, 2);
+  col_major_matrix<T> ca = a;
+  col_major_matrix<T> cb = b;
+  matrix<T> expected = a * b;
+
+  col_major_matrix<T> c = ca * cb;
+  expect_equal(expected, c);
+  expect_equal(expected, ca * b);
+  expect_equal(expected, a * cb);
+  expect_equal(expected, ca.transpose().transpose() * cb);
+  expect_equal(matrix<T>(expected.transpose()), cb.transpose() * ca.transpose());
+}
+
+} // namespace
+
+static_assert(std::is_same_v<col_major_matrix<int>::layout_type, col_major>);
+static_assert(std::is_same_v<col_major_matrix<int>::col_iterator, int*>);
+static_assert(std::is_same_v<col_major_matrix<int>::const_col_iterator, const int*>);
+static_assert(std::is_same_v<col_major_matrix<int>::row_iterator, ColIterator<int>>);
+static_assert(std::is_same_v<decltype(std::declval<col_major_matrix<int>&>().transpose()), matrix_view<int>>);
+
+TEST(layout, storage_order) {
+  col_major_matrix<int> m = make_matrix<int>(3, 4);
+  EXPECT_EQ(3, m.stride());
+  EXPECT_TRUE(m.contiguous());
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 4; ++j) {
+      EXPECT_EQ(m(i, j), m.data()[j * 3 + i]);
+    }
+  }
+
+  // Columns are contiguous, rows strided.
+  EXPECT_EQ(&m(0, 2), m.col_begin(2));
+  EXPECT_EQ(&m(0, 3) + 3, m.col_end(3));
+  EXPECT_EQ(4, m.row_end(1) - m.row_begin(1));
+  EXPECT_TRUE(std::equal(m.row_begin(1), m.row_end(1), m.transpose().col_begin(1)));
+  EXPECT_EQ(&m(2, 1), &m.row_begin(2)[1]);
+
+  int init[2][3] = {{1, 2, 3}, {4, 5, 6}};
+  col_major_matrix<int> from_array(init);
+  EXPECT_EQ(2, from_array.stride());
+  EXPECT_EQ(6, from_array(1, 2));
+  EXPECT_EQ(4, from_array.data()[1]);
+}
+
+TEST(layout, padded) {
+  col_major_matrix<float> m(5, 3, padded);
+  EXPECT_EQ(matrix_detail::padded_stride<float>(5), m.stride());
+  EXPECT_FALSE(m.contiguous());
+  m(4, 2) = 1.5f;
+  EXPECT_EQ(1.5f, m.data()[2 * m.stride() + 4]);
+
+  col_major_matrix<float> twice = m + m;
+  EXPECT_EQ(3.0f, twice(4, 2));
+  m *= 4.0f;
+  EXPECT_EQ(6.0f, m(4, 2));
+  EXPECT_TRUE(m == m);
+}
+
+TEST(layout, conversion) {
+  matrix<int> r = make_matrix<int>(6, 9);
+  col_major_matrix<int> c = r;
+  expect_equal(r, c);
+  EXPECT_EQ(6, c.stride());
+
+  matrix<int> back = c;
+  EXPECT_TRUE(back == r);
+
+  // The storage of either is the other layout's storage of the transpose,
+  // viewed without copying.
+  EXPECT_EQ(c.data(), c.transpose().data());
+  expect_equal(matrix<int>(r.transpose()), c.transpose());
+  col_major_matrix<int> from_view = r.block(1, 2, 4, 5);
+  expect_equal(matrix<int>(r.block(1, 2, 4, 5)), from_view);
+}
+
+TEST(layout, elementwise) {
+  matrix<int> a = make_matrix<int>(7, 5, 1);
+  matrix<int> b = make_matrix<int>(7, 5, 2);
+  col_major_matrix<int> ca = a;
+  col_major_matrix<int> cb = b;
+
+  col_major_matrix<int> c = ca + cb * 2 - ca;
+  expect_equal(b * 2, c);
+  expect_equal(a + b, ca + b);
+  expect_equal(a - b, a - cb);
+
+  col_major_matrix<int> mixed = a + cb;
+  expect_equal(a + b, mixed);
+
+  c = ca;
+  c += cb;
+  c -= b;
+  c += a.transpose().transpose();
+  c *= 3;
+  expect_equal((a + a) * 3, c);
+
+  // A 5 x 7 expression reshapes the 7 x 5 buffer.
+  c = a.transpose() + b.transpose();
+  EXPECT_EQ(5, c.rows());
+  EXPECT_EQ(5, c.stride());
+  expect_equal(matrix<int>(a.transpose()) + b.transpose(), c);
+
+  // An expiring operand's buffer is reused.
+  col_major_matrix<int> owner = ca;
+  const int* storage = owner.data();
+  col_major_matrix<int> sum = std::move(owner) + cb;
+  EXPECT_EQ(storage, sum.data());
+  expect_equal(a + b, sum);
+
+  EXPECT_TRUE(ca == col_major_matrix<int>(a));
+  EXPECT_TRUE(ca != cb);
+}
+
+TEST(layout, aliasing) {
+  matrix<int> a = make_matrix<int>(6, 6);
+  col_major_matrix<int> c = a;
+  c = c.transpose() + c;
+  expect_equal(matrix<int>(a.transpose()) + a, c);
+
+  c = a;
+  c += c.transpose();
+  expect_equal(matrix<int>(a.transpose()) + a, c);
+}
+
+TEST(layout, views) {
+  matrix<int> a = make_matrix<int>(8, 6);
+  col_major_matrix<int> c = a;
+
+  matrix_view<int, col_major> block = c.block(2, 1, 4, 3);
+  EXPECT_EQ(&c(2, 1), block.data());
+  EXPECT_EQ(8, block.stride());
+  expect_equal(matrix<int>(a.block(2, 1, 4, 3)), block);
+  expect_equal(matrix<int>(a.row(3)), c.row(3));
+  expect_equal(matrix<int>(a.col(5)), c.col(5));
+
+  // Writes through column-major views.
+  c.block(0, 0, 2, 3) = a.block(6, 3, 2, 3);
+  a.block(0, 0, 2, 3) = a.block(6, 3, 2, 3);
+  c.block(4, 2, 3, 3) += c.block(0, 0, 3, 3);
+  a.block(4, 2, 3, 3) += a.block(0, 0, 3, 3);
+  c.col(1) *= 5;
+  a.col(1) *= 5;
+  expect_equal(a, c);
+}
+
+TEST_F(layout_test, products) {
+  for (size_t size : {1, 2, 5, 17, 40, 70}) {
+    check_products<int>(size, size, size);
+    check_products<double>(size, size + 3, size * 2);
+  }
+  check_products<float>(130, 90, 300);
+
+  // Square products of two column-major matrices go through Strassen.
+  matrix_strassen::set_cutoff(16);
+  check_products<double>(64, 64, 64);
+  matrix_strassen::set_cutoff(0);
+
+  col_major_matrix<int> m = make_matrix<int>(9, 9);
+  matrix<int> r = m;
+  m *= m;
+  expect_equal(r * r, m);
+}
+
+TEST(layout, gemm) {
+  matrix<double> a = make_matrix<double>(20, 30, 1);
+  matrix<double> b = make_matrix<double>(30, 10, 2);
+  matrix<double> c = make_matrix<double>(20, 10, 3);
+  col_major_matrix<double> cc = c;
+
+  gemm(2.0, a, col_major_matrix<double>(b), 3.0, cc);
+  expect_equal(a * b * 2.0 + c * 3.0, cc);
+
+  cc = c;
+  addmul(cc, col_major_matrix<double>(a), b);
+  expect_equal(c + a * b, cc);
+
+  cc = c;
+  submul(cc, a, b);
+  expect_equal(c - a * b, cc);
+
+  // Into a column-major block, from its own matrix.
+  cc = c;
+  matrix<double> expected = c;
+  addmul(expected.block(0, 0, 10, 10), expected.block(10, 0, 10, 10), c.block(0, 0, 10, 10));
+  addmul(cc.block(0, 0, 10, 10), cc.block(10, 0, 10, 10), c.block(0, 0, 10, 10));
+  expect_equal(expected, cc);
+}
+
+TEST(layout, transpose_in_place) {
+  matrix<int> a = make_matrix<int>(5, 8);
+  matrix<int> expected = a.transpose();
+
+  col_major_matrix<int> c = a;
+  c.transpose_in_place();
+  EXPECT_EQ(8, c.rows());
+  EXPECT_EQ(8, c.stride());
+  expect_equal(expected, c);
+
+  col_major_matrix<int> square = make_matrix<int>(6, 6);
+  matrix<int> square_expected = square.transpose();
+  square.transpose_in_place();
+  expect_equal(square_expected, square);
+
+  col_major_matrix<int> p(5, 8, padded);
+  for (size_t i = 0; i < 5; ++i) {
+    for (size_t j = 0; j < 8; ++j) {
+      p(i, j) = a(i, j);
+    }
+  }
+  p.transpose_in_place();
+  expect_equal(expected, p);
+}
+
+TEST(layout, text) {
+  matrix<int> a = make_matrix<int>(3, 4);
+  std::ostringstream row_text;
+  std::ostringstream col_text;
+  row_text << a;
+  col_text << col_major_matrix<int>(a);
+  EXPECT_EQ(row_text.str(), col_text.str());
+
+  col_major_matrix<int> c;
+  std::istringstream in(row_text.str());
+  in >> c;
+  expect_equal(a, c);
+}
+
+TEST_F(layout_test, parallel) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  check_products<int>(100, 90, 80);
+  matrix<double> a = make_matrix<double>(150, 70, 1);
+  col_major_matrix<double> c = a;
+  expect_equal(a * 2.0 + a, c * 2.0 + a);
+}
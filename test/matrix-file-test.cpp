@@ -0,0 +1,214 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+class matrix_file_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+    _path = std::filesystem::temp_directory_path() /
+            ("matrix-file-test-" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + ".npy");
+  }
+
+  void TearDown() override {
+    std::filesystem::remove(_path);
+  }
+
+  const std::filesystem::path& path() const {
+    return _path;
+  }
+
+  // Writes a file with the given header dict followed by raw element bytes.
+  void write_npy(const std::string& dict, const void* data, size_t bytes) const {
+    std::string header = dict;
+    while ((10 + header.size() + 1) % 64 != 0) {
+      header += ' ';
+    }
+    header += '\n';
+    std::ofstream out(_path, std::ios::binary);
+    out.write("\x93NUMPY\x01\x00", 8);
+    out.put(static_cast<char>(header.size() & 0xff));
+    out.put(static_cast<char>(header.size() >> 8));
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+  }
+
+private:
+  std::filesystem::path _path;
+};
+
+std::string read_file(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+TEST_F(matrix_file_test, header_layout) {
+  make_matrix<int>(3, 4).save(path());
+  std::string file = read_file(path());
+
+  ASSERT_EQ(128 + 12 * sizeof(int), file.size());
+  EXPECT_EQ(std::string("\x93NUMPY\x01\x00", 8), file.substr(0, 8));
+  EXPECT_EQ(128 - 10, static_cast<unsigned char>(file[8]) | static_cast<unsigned char>(file[9]) << 8);
+  EXPECT_EQ("{'descr': '<i4', 'fortran_order': False, 'shape': (3, 4), }", file.substr(10, 59));
+  EXPECT_EQ('\n', file[127]);
+}
+
+TEST_F(matrix_file_test, round_trip) {
+  matrix<int> a = make_matrix<int>(17, 9);
+  a.save(path());
+  expect_equal(a, matrix<int>::load(path()));
+
+  matrix<double> b = make_matrix<double>(5, 31);
+  b(2, 3) = -0.125;
+  b.save(path());
+  expect_equal(b, matrix<double>::load(path()));
+
+  matrix<std::uint8_t> c(2, 3);
+  c(1, 2) = 255;
+  c.save(path());
+  expect_equal(c, matrix<std::uint8_t>::load(path()));
+
+  matrix<long long> empty;
+  empty.save(path());
+  expect_empty(matrix<long long>::load(path()));
+}
+
+TEST_F(matrix_file_test, padded_is_written_packed) {
+  matrix<int> a(6, 5, padded);
+  fill(a);
+  a.save(path());
+  EXPECT_EQ(128 + 30 * sizeof(int), std::filesystem::file_size(path()));
+  matrix<int> b = matrix<int>::load(path());
+  EXPECT_TRUE(b.contiguous());
+  expect_equal(a, b);
+}
+
+TEST_F(matrix_file_test, fortran_order_and_byte_order) {
+  // A 2 x 3 matrix stored column by column.
+  int columns[] = {1, 4, 2, 5, 3, 6};
+  write_npy("{'descr': '<i4', 'fortran_order': True, 'shape': (2, 3), }", columns, sizeof(columns));
+  expect_equal(matrix<int>({{1, 2, 3}, {4, 5, 6}}), matrix<int>::load(path()));
+
+  unsigned char big[] = {0, 0, 0, 1, 0, 0, 1, 0, 0xff, 0xff, 0xff, 0xfe};
+  write_npy("{'descr': '>i4', 'fortran_order': False, 'shape': (1, 3), }", big, sizeof(big));
+  expect_equal(matrix<int>({{1, 256, -2}}), matrix<int>::load(path()));
+}
+
+TEST_F(matrix_file_test, column_major_round_trip) {
+  col_major_matrix<int> a(6, 5, padded);
+  for (size_t i = 0; i < 6; ++i) {
+    for (size_t j = 0; j < 5; ++j) {
+      a(i, j) = static_cast<int>(elem(i, j));
+    }
+  }
+  a.save(path());
+  EXPECT_NE(std::string::npos, read_file(path()).find("'fortran_order': True, 'shape': (6, 5)"));
+  matrix<int> expected = a;
+  expect_equal(expected, col_major_matrix<int>::load(path()));
+  expect_equal(expected, matrix<int>::load(path()));
+  EXPECT_EQ(a(4, 3), (mapped_matrix<int, col_major>(path())(4, 3)));
+
+  make_matrix<int>(3, 7).save(path());
+  col_major_matrix<int> b = col_major_matrix<int>::load(path());
+  EXPECT_EQ(3, b.stride());
+  expect_equal(make_matrix<int>(3, 7), b);
+}
+
+TEST_F(matrix_file_test, errors) {
+  make_matrix<int>(2, 2).save(path());
+  EXPECT_THROW(matrix<double>::load(path()), std::runtime_error);
+  EXPECT_THROW(matrix<unsigned>::load(path()), std::runtime_error);
+  EXPECT_THROW((mapped_matrix<long long>(path())), std::runtime_error);
+  EXPECT_THROW((mapped_matrix<int, col_major>(path())), std::runtime_error);
+
+  int three[] = {1, 2, 3};
+  write_npy("{'descr': '<i4', 'fortran_order': False, 'shape': (3,), }", three, sizeof(three));
+  EXPECT_THROW(matrix<int>::load(path()), std::runtime_error);
+
+  write_npy("{'descr': '<i4', 'fortran_order': False, 'shape': (2, 2), }", three, sizeof(three));
+  EXPECT_THROW(matrix<int>::load(path()), std::runtime_error);
+  EXPECT_THROW((mapped_matrix<int>(path())), std::runtime_error);
+
+  // rows * cols wraps around to 0.
+  write_npy("{'descr': '<i4', 'fortran_order': False, 'shape': (8589934592, 2147483648), }", three, 0);
+  EXPECT_THROW(matrix<int>::load(path()), std::runtime_error);
+  EXPECT_THROW((mapped_matrix<int>(path())), std::runtime_error);
+
+  write_npy("{'descr': '<i4', 'fortran_order': False, 'shape': (4611686018427387904, 2), }", three, 0);
+  EXPECT_THROW(matrix<int>::load(path()), std::runtime_error);
+  EXPECT_THROW((mapped_matrix<int>(path())), std::runtime_error);
+
+  std::ofstream(path()) << "not a matrix";
+  EXPECT_THROW(matrix<int>::load(path()), std::runtime_error);
+  EXPECT_THROW((mapped_matrix<int>(path())), std::runtime_error);
+
+  EXPECT_THROW(matrix<int>::load(path().string() + ".missing"), std::runtime_error);
+}
+
+TEST_F(matrix_file_test, mapped_matrix_reads_file_in_place) {
+  matrix<long long> a = make_matrix<long long>(40, 13);
+  a.save(path());
+
+  mapped_matrix<long long> m(path());
+  EXPECT_EQ(40, m.rows());
+  EXPECT_EQ(13, m.cols());
+  EXPECT_EQ(13, m.stride());
+  EXPECT_EQ(0, reinterpret_cast<std::uintptr_t>(m.data()) % 64);
+  EXPECT_EQ(a(7, 5), m(7, 5));
+  EXPECT_TRUE(std::equal(a.begin(), a.end(), m.begin(), m.end()));
+  EXPECT_TRUE(std::equal(a.row_begin(3), a.row_end(3), m.row_begin(3), m.row_end(3)));
+  EXPECT_TRUE(std::equal(a.col_begin(11), a.col_end(11), m.col_begin(11), m.col_end(11)));
+
+  // The view is an operand like any other.
+  expect_equal(a + a, m.view() + a);
+  expect_equal(a.transpose() * a, m.view().transpose() * m.view());
+
+  mapped_matrix<long long> moved = std::move(m);
+  EXPECT_EQ(a(39, 12), moved(39, 12));
+  EXPECT_TRUE(m.empty());
+
+  mapped_matrix<long long>& self = moved;
+  moved = std::move(self);
+  EXPECT_EQ(a(39, 12), moved(39, 12));
+}
+
+TEST_F(matrix_file_test, temp_names_are_unique) {
+  EXPECT_NE(matrix_detail::npy_temp_path(path()), matrix_detail::npy_temp_path(path()));
+}
+
+TEST_F(matrix_file_test, save_over_mapped_file) {
+  matrix<int> a = make_matrix<int>(300, 200);
+  a.save(path());
+  mapped_matrix<int> m(path());
+
+  matrix<int> b = make_matrix<int>(3, 5);
+  b.save(path());
+  EXPECT_FALSE(temp_file_left(path()));
+  expect_equal(b, matrix<int>::load(path()));
+  EXPECT_EQ(300, m.rows());
+  EXPECT_TRUE(std::equal(a.begin(), a.end(), m.begin(), m.end()));
+}
+
+TEST_F(matrix_file_test, mapped_column_major) {
+  int columns[] = {1, 4, 2, 5, 3, 6};
+  write_npy("{'descr': '<i4', 'fortran_order': True, 'shape': (2, 3), }", columns, sizeof(columns));
+
+  mapped_matrix<int, col_major> m(path());
+  EXPECT_EQ(2, m.rows());
+  EXPECT_EQ(3, m.cols());
+  EXPECT_EQ(5, m(1, 1));
+  EXPECT_EQ(3, m(0, 2));
+  expect_equal(matrix<int>({{1, 2, 3}, {4, 5, 6}}), matrix<int>(m.view()));
+}
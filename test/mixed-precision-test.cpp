@@ -0,0 +1,145 @@
+#include "mixed-precision.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+using mixed_precision_test = settings_test;
+
+template <class Acc, class M>
+matrix<Acc> widen(const M& m) {
+  matrix<Acc> w(m.rows(), m.cols());
+  for (size_t i = 0; i < m.rows(); ++i) {
+    for (size_t j = 0; j < m.cols(); ++j) {
+      w(i, j) = static_cast<Acc>(m(i, j));
+    }
+  }
+  return w;
+}
+
+// Checks multiply<Acc> against the product of the widened operands.
+template <class Acc, class L, class R>
+void check(const L& a, const R& b) {
+  expect_equal(widen<Acc>(a) * widen<Acc>(b), multiply<Acc>(a, b));
+}
+
+template <class T, class Acc>
+void check_sizes(int range) {
+  for (size_t m : {1, 3, 16, 21}) {
+    for (size_t n : {1, 4, 7, 70}) {
+      for (size_t k : {1, 15, 32, 100}) {
+        check<Acc>(make_matrix<T>(m, k, 1, -range, range), make_matrix<T>(k, n, 2, -range, range));
+      }
+    }
+  }
+}
+
+} // namespace
+
+TEST(mixed_precision, int8) {
+  check_sizes<std::int8_t, std::int32_t>(127);
+  // Every product is 127 * 127 or -128 * -128, far outside int8_t.
+  matrix<std::int8_t> a(5, 1000);
+  matrix<std::int8_t> b(1000, 3);
+  for (size_t p = 0; p < 1000; ++p) {
+    for (size_t i = 0; i < 5; ++i) {
+      a(i, p) = p % 2 ? 127 : -128;
+    }
+    for (size_t j = 0; j < 3; ++j) {
+      b(p, j) = p % 2 ? 127 : -128;
+    }
+  }
+  matrix<std::int32_t> c = multiply<std::int32_t>(a, b);
+  EXPECT_EQ(500 * 127 * 127 + 500 * 128 * 128, c(4, 2));
+  check<std::int32_t>(a, b);
+}
+
+TEST(mixed_precision, int16) {
+  check_sizes<std::int16_t, std::int32_t>(1000);
+  check_sizes<std::int16_t, std::int64_t>(30000);
+}
+
+TEST(mixed_precision, widening) {
+  check_sizes<std::uint8_t, std::uint32_t>(100);
+  check_sizes<int, std::int64_t>(1000);
+  check_sizes<float, double>(10);
+  check_sizes<std::int8_t, float>(100);
+  check_sizes<int, int>(50);
+}
+
+TEST(mixed_precision, double_accumulator) {
+  // 0.1f summed 100000 times drifts far from 10000 in float.
+  matrix<float> a(1, 100000);
+  matrix<float> b(100000, 1);
+  for (size_t p = 0; p < 100000; ++p) {
+    a(0, p) = 0.1f;
+    b(p, 0) = 1.0f;
+  }
+  double expected = 100000 * static_cast<double>(0.1f);
+  EXPECT_NEAR(expected, multiply<double>(a, b)(0, 0), expected * 1e-12);
+}
+
+TEST(mixed_precision, compensated) {
+  matrix<float> a(3, 100000);
+  matrix<float> b(100000, 2);
+  for (size_t p = 0; p < 100000; ++p) {
+    for (size_t i = 0; i < 3; ++i) {
+      a(i, p) = 0.1f * static_cast<float>(i + 1);
+    }
+    b(p, 0) = 1.0f;
+    b(p, 1) = p % 2 ? 1.0f / 3 : 1.0f;
+  }
+  matrix<double> reference = widen<double>(a) * widen<double>(b);
+  matrix<float> c = multiply_compensated(a, b);
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 2; ++j) {
+      EXPECT_NEAR(reference(i, j), c(i, j), std::abs(reference(i, j)) * 1e-6) << i << ", " << j;
+    }
+  }
+
+  // Exact on small integers, for every size and both element types.
+  for (size_t size : {1, 5, 17, 40}) {
+    matrix<double> x = make_matrix<double>(size, size + 3, 1, -10, 10);
+    matrix<double> y = make_matrix<double>(size + 3, size, 2, -10, 10);
+    expect_equal(x * y, multiply_compensated(x, y));
+    matrix<float> xf = make_matrix<float>(size, size * 2, 1, -10, 10);
+    matrix<float> yf = make_matrix<float>(size * 2, 9, 2, -10, 10);
+    expect_equal(xf * yf, multiply_compensated(xf, yf));
+  }
+}
+
+TEST(mixed_precision, views) {
+  matrix<std::int8_t> a = make_matrix<std::int8_t>(40, 50, 1, -127, 127);
+  matrix<std::int8_t> b = make_matrix<std::int8_t>(50, 40, 2, -127, 127);
+  check<std::int32_t>(a.transpose(), b.transpose());
+  check<std::int32_t>(a.block(3, 5, 20, 33), b.block(1, 2, 33, 17));
+  check<std::int32_t>(a.transpose(), a);
+  check<std::int32_t>(b, b.transpose());
+  check<std::int32_t>(a.row(4), b.col(7));
+
+  matrix<std::int16_t> padded_matrix(13, 70, padded);
+  fill(padded_matrix);
+  check<std::int32_t>(padded_matrix, padded_matrix.transpose());
+
+  matrix<float> f = make_matrix<float>(30, 30, 0, -10, 10);
+  expect_equal(f.transpose() * f, multiply_compensated(f.transpose(), f));
+}
+
+TEST(mixed_precision, empty) {
+  expect_empty(multiply<std::int32_t>(matrix<std::int8_t>(), matrix<std::int8_t>()));
+  expect_empty(multiply<double>(matrix<float>(3, 0), matrix<float>(0, 4)));
+  expect_empty(multiply_compensated(matrix<float>(), matrix<float>()));
+}
+
+TEST_F(mixed_precision_test, parallel) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  check<std::int32_t>(make_matrix<std::int8_t>(100, 90, 1, -127, 127),
+                      make_matrix<std::int8_t>(90, 150, 2, -127, 127));
+  check<double>(make_matrix<float>(70, 60, 1, -10, 10), make_matrix<float>(60, 200, 2, -10, 10));
+}
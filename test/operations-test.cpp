@@ -461,3 +461,255 @@ TEST_F(operations_test, mul_scalar_return_value) {
 
   expect_allocations(a.size() + b.size());
 }
+
+TEST_F(operations_test, mul_non_square) {
+  const matrix<element> a({
+      {1, 2, 3},
+      {4, 5, 6},
+  });
+  const matrix<element> b({
+      {1, 0, 2, 1},
+      {0, 1, 3, 1},
+      {1, 1, 0, 1},
+  });
+  const matrix<element> c({
+      { 4,  5,  8,  6},
+      {10, 11, 23, 15},
+  });
+
+  expect_equal(c, a * b);
+
+  matrix<element> d = a;
+  d *= b;
+  expect_equal(c, d);
+}
+
+namespace {
+
+template <class T>
+matrix<T> naive_mul(const matrix<T>& a, const matrix<T>& b) {
+  matrix<T> c(a.rows(), b.cols());
+  for (size_t i = 0; i < a.rows(); ++i) {
+    for (size_t j = 0; j < b.cols(); ++j) {
+      T sum = 0;
+      for (size_t k = 0; k < a.cols(); ++k) {
+        sum += a(i, k) * b(k, j);
+      }
+      c(i, j) = sum;
+    }
+  }
+  return c;
+}
+
+template <class T>
+void expect_mul_matches_naive(size_t m, size_t k, size_t n) {
+  matrix<T> a(m, k);
+  matrix<T> b(k, n);
+  for (size_t i = 0; i < m; ++i) {
+    for (size_t j = 0; j < k; ++j) {
+      a(i, j) = static_cast<T>((i * 7 + j * 3) % 11);
+    }
+  }
+  for (size_t i = 0; i < k; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      b(i, j) = static_cast<T>((i * 5 + j * 13) % 9);
+    }
+  }
+  expect_equal(naive_mul(a, b), a * b);
+}
+
+} // namespace
+
+TEST_F(operations_test, mul_large) {
+  expect_mul_matches_naive<int>(130, 70, 150);
+  expect_mul_matches_naive<int64_t>(97, 301, 33);
+  expect_mul_matches_naive<double>(300, 257, 129);
+  expect_mul_matches_naive<float>(17, 600, 45);
+  expect_mul_matches_naive<element>(40, 50, 60);
+}
+
+namespace {
+
+template <class T>
+void expect_elementwise_matches_scalar(size_t rows, size_t cols) {
+  matrix<T> a(rows, cols);
+  matrix<T> b(rows, cols);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      a(i, j) = static_cast<T>(i * 31 + j * 3);
+      b(i, j) = static_cast<T>(i + j * 5);
+    }
+  }
+
+  matrix<T> sum = a + b;
+  matrix<T> diff = a - b;
+  matrix<T> scaled = a * T(3);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      EXPECT_EQ(static_cast<T>(a(i, j) + b(i, j)), sum(i, j));
+      EXPECT_EQ(static_cast<T>(a(i, j) - b(i, j)), diff(i, j));
+      EXPECT_EQ(static_cast<T>(a(i, j) * T(3)), scaled(i, j));
+    }
+  }
+
+  matrix<T> c = a;
+  c += b;
+  expect_equal(sum, c);
+  c = a;
+  c -= b;
+  expect_equal(diff, c);
+  c = a;
+  c *= T(3);
+  expect_equal(scaled, c);
+}
+
+} // namespace
+
+TEST_F(operations_test, elementwise_vectorized_types) {
+  for (size_t cols = 1; cols <= 37; cols += 6) {
+    expect_elementwise_matches_scalar<int32_t>(3, cols);
+    expect_elementwise_matches_scalar<int64_t>(3, cols);
+    expect_elementwise_matches_scalar<uint32_t>(3, cols);
+    expect_elementwise_matches_scalar<float>(3, cols);
+    expect_elementwise_matches_scalar<double>(3, cols);
+    expect_elementwise_matches_scalar<short>(3, cols);
+  }
+}
+
+TEST_F(operations_test, chained_add_sub_allocates_once) {
+  const matrix<element> a({
+      {1, 2, 3},
+      {4, 5, 6},
+  });
+  const matrix<element> b({
+      {10, 20, 30},
+      {40, 50, 60},
+  });
+  const matrix<element> c({
+      {100, 200, 300},
+      {400, 500, 600},
+  });
+  const matrix<element> expected({
+      {111, 222, 333},
+      {444, 555, 666},
+  });
+
+  size_t expected_allocations = a.size() + b.size() + c.size() + expected.size();
+
+  matrix<element> d = a + b + c;
+  expect_allocations(expected_allocations += d.size());
+
+  matrix<element> e = c + (a + b);
+  expect_allocations(expected_allocations += e.size());
+
+  matrix<element> f = (d - c) - (e - expected);
+  expect_allocations(expected_allocations += f.size() * 2);
+
+  matrix<element> g = (f * 2) * 5;
+  expect_allocations(expected_allocations += g.size());
+
+  expect_equal(expected, d);
+  expect_equal(expected, e);
+  expect_equal(f, a + b);
+  expect_equal(g, (a + b) * 10);
+}
+
+TEST_F(operations_test, mul_rvalue_result) {
+  const matrix<element> a({
+      {1, 2},
+      {3, 4},
+  });
+  const matrix<element> b({
+      {1, 0},
+      {0, 1},
+  });
+
+  size_t expected_allocations = a.size() + b.size();
+
+  matrix<element> c = a * b + a;
+  expect_allocations(expected_allocations += c.size());
+
+  expect_equal(c, a * 2);
+}
+
+TEST_F(operations_test, fused_expression_allocates_once) {
+  const matrix<element> a({
+      {1, 2, 3},
+      {4, 5, 6},
+  });
+  const matrix<element> b({
+      {10, 20, 30},
+      {40, 50, 60},
+  });
+  const matrix<element> c({
+      {1, 1, 1},
+      {2, 2, 2},
+  });
+  const matrix<element> expected({
+      { 9, 20, 31},
+      {40, 51, 62},
+  });
+
+  size_t expected_allocations = a.size() + b.size() + c.size() + expected.size();
+
+  matrix<element> d = a + b - c * 2;
+  expect_allocations(expected_allocations += d.size());
+  expect_equal(expected, d);
+
+  d = 2 * c + a - (a - b);
+  expect_allocations(expected_allocations);
+  expect_equal(b + c * 2, d);
+}
+
+TEST_F(operations_test, expression_aliasing) {
+  matrix<element> a({
+      {1, 2, 3},
+      {4, 5, 6},
+  });
+  const matrix<element> b({
+      {10, 20, 30},
+      {40, 50, 60},
+  });
+
+  a = a + b;
+  expect_equal(matrix<element>({{11, 22, 33}, {44, 55, 66}}), a);
+
+  a = b - a * 2 + a;
+  expect_equal(matrix<element>({{-1ULL, -2ULL, -3ULL}, {-4ULL, -5ULL, -6ULL}}), a);
+
+  a = b;
+  a += a * 2 + b;
+  expect_equal(b * 4, a);
+
+  a -= a - b;
+  expect_equal(b, a);
+
+  a *= a(1, 2);
+  expect_equal(b * 60, a);
+}
+
+TEST_F(operations_test, expression_product) {
+  const matrix<element> a({
+      {1, 2},
+      {3, 4},
+  });
+  const matrix<element> id({
+      {1, 0},
+      {0, 1},
+  });
+
+  expect_equal(a * 2, (a + a) * id);
+  expect_equal(a * 3, id * (a * 3));
+  expect_equal(a * 4, (a + a) * (id * 2));
+}
+
+TEST_F(operations_test, expression_owning_operands) {
+  const matrix<element> a({
+      {1, 2},
+      {3, 4},
+  });
+
+  auto e = matrix<element>(a) + matrix<element>(a) * 2;
+  matrix<element> b = e;
+  expect_equal(a * 3, b);
+}
@@ -0,0 +1,88 @@
+#include "matrix.h"
+#include "out-of-core.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+class out_of_core_test : public settings_test {
+protected:
+  void TearDown() override {
+    for (const char* name : {"a", "b", "c"}) {
+      std::filesystem::remove(path(name));
+    }
+    settings_test::TearDown();
+  }
+
+  std::filesystem::path path(const std::string& name) const {
+    return std::filesystem::temp_directory_path() /
+           ("out-of-core-test-" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + "-" + name + ".npy");
+  }
+
+  template <class T>
+  void check(size_t m, size_t k, size_t n, size_t budget) {
+    matrix<T> a(m, k);
+    matrix<T> b(k, n);
+    fill(a);
+    fill(b);
+    a.save(path("a"));
+    b.save(path("b"));
+    multiply_files<T>(path("a"), path("b"), path("c"), budget);
+    expect_equal(a * b, matrix<T>::load(path("c")));
+  }
+};
+
+} // namespace
+
+TEST(out_of_core, tile_size) {
+  EXPECT_EQ(16, matrix_detail::out_of_core_tile<int>(5 * 16 * 16 * sizeof(int)));
+  EXPECT_EQ(1, matrix_detail::out_of_core_tile<double>(0));
+}
+
+TEST_F(out_of_core_test, matches_in_memory_product) {
+  // Tiles of 8 leave partial tiles along every dimension.
+  check<long long>(37, 29, 43, 5 * 8 * 8 * sizeof(long long));
+  check<int>(20, 50, 3, 5 * 8 * 8 * sizeof(int));
+  check<double>(16, 16, 16, 5 * 8 * 8 * sizeof(double));
+}
+
+TEST_F(out_of_core_test, budget_larger_than_matrices) {
+  check<int>(30, 40, 50, size_t(1) << 24);
+}
+
+TEST_F(out_of_core_test, single_element_tiles) {
+  check<int>(5, 3, 4, 1);
+}
+
+TEST_F(out_of_core_test, empty_inner_dimension) {
+  check<int>(4, 0, 3, 1024);
+}
+
+TEST_F(out_of_core_test, parallel) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  check<unsigned>(70, 65, 90, 5 * 32 * 32 * sizeof(unsigned));
+}
+
+TEST_F(out_of_core_test, errors) {
+  matrix<int>(3, 4).save(path("a"));
+  matrix<int>(5, 2).save(path("b"));
+  EXPECT_THROW(multiply_files<int>(path("a"), path("b"), path("c"), 1024), std::runtime_error);
+  EXPECT_THROW(multiply_files<double>(path("a"), path("a"), path("c"), 1024), std::runtime_error);
+}
+
+TEST_F(out_of_core_test, output_replaces_an_input) {
+  matrix<int> a(23, 23);
+  fill(a);
+  a.save(path("a"));
+  multiply_files<int>(path("a"), path("a"), path("a"), 5 * 8 * 8 * sizeof(int));
+  expect_equal(a * a, matrix<int>::load(path("a")));
+  EXPECT_FALSE(temp_file_left(path("a")));
+}
@@ -0,0 +1,136 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+class parallel_test : public settings_test {
+protected:
+  void SetUp() override {
+    settings_test::SetUp();
+    element::reset_allocations();
+    matrix_parallel::set_num_threads(4);
+    matrix_parallel::set_threshold(1);
+  }
+};
+
+template <class T>
+matrix<T> serial_mul(const matrix<T>& a, const matrix<T>& b) {
+  size_t threads = matrix_parallel::num_threads();
+  matrix_parallel::set_num_threads(1);
+  matrix<T> c = a * b;
+  matrix_parallel::set_num_threads(threads);
+  return c;
+}
+
+} // namespace
+
+TEST_F(parallel_test, pool_runs_every_index_once) {
+  matrix_detail::thread_pool pool(3);
+  EXPECT_EQ(4, pool.concurrency());
+
+  for (size_t count : {0, 1, 3, 4, 17, 1000}) {
+    std::atomic<size_t>* hits = new std::atomic<size_t>[count + 1]();
+    auto body = [&](size_t i) { hits[i].fetch_add(1); };
+    pool.parallel_for(count, body);
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(1, hits[i].load()) << "  where i = " << i;
+    }
+    EXPECT_EQ(0, hits[count].load());
+    delete[] hits;
+  }
+}
+
+TEST_F(parallel_test, pool_rethrows_task_exceptions) {
+  matrix_detail::thread_pool pool(3);
+
+  for (size_t failing : {0, 1, 50, 99}) {
+    std::atomic<size_t> started = 0;
+    auto body = [&](size_t i) {
+      started.fetch_add(1);
+      if (i == failing) {
+        throw std::runtime_error("task failed");
+      }
+    };
+    EXPECT_THROW(pool.parallel_for(100, body), std::runtime_error);
+    EXPECT_LE(1, started.load());
+  }
+
+  auto always = [](size_t) { throw std::runtime_error("task failed"); };
+  EXPECT_THROW(pool.parallel_for(100, always), std::runtime_error);
+
+  std::atomic<size_t> total = 0;
+  auto body = [&](size_t) { total.fetch_add(1); };
+  pool.parallel_for(100, body);
+  EXPECT_EQ(100, total.load());
+}
+
+TEST_F(parallel_test, resizing_keeps_running_pool_alive) {
+  std::shared_ptr<matrix_detail::thread_pool> pool = matrix_detail::shared_thread_pool(4);
+  std::shared_ptr<matrix_detail::thread_pool> other = matrix_detail::shared_thread_pool(3);
+  EXPECT_NE(pool, other);
+  EXPECT_EQ(4, pool->concurrency());
+
+  std::atomic<size_t> total = 0;
+  auto body = [&](size_t) { total.fetch_add(1); };
+  pool->parallel_for(100, body);
+  EXPECT_EQ(100, total.load());
+}
+
+TEST_F(parallel_test, nested_sections_run_serially) {
+  std::atomic<size_t> total = 0;
+  matrix_detail::parallel_for(8, 1000, [&](size_t) {
+    EXPECT_TRUE(matrix_detail::thread_pool::in_task());
+    matrix_detail::parallel_for(8, 1000, [&](size_t) { total.fetch_add(1); });
+  });
+  EXPECT_EQ(64, total.load());
+}
+
+TEST_F(parallel_test, mul_square) {
+  matrix<double> a = make_matrix<double>(150, 150, 1);
+  matrix<double> b = make_matrix<double>(150, 150, 2);
+  expect_equal(serial_mul(a, b), a * b);
+}
+
+TEST_F(parallel_test, mul_tall_skinny) {
+  matrix<int> a = make_matrix<int>(1000, 40, 3);
+  matrix<int> b = make_matrix<int>(40, 3, 4);
+  expect_equal(serial_mul(a, b), a * b);
+}
+
+TEST_F(parallel_test, mul_short_wide) {
+  matrix<int64_t> a = make_matrix<int64_t>(5, 70, 5);
+  matrix<int64_t> b = make_matrix<int64_t>(70, 900, 6);
+  expect_equal(serial_mul(a, b), a * b);
+}
+
+TEST_F(parallel_test, mul_generic_element) {
+  matrix<element> a = make_matrix<element>(60, 30, 7);
+  matrix<element> b = make_matrix<element>(30, 50, 8);
+  expect_equal(serial_mul(a, b), a * b);
+}
+
+TEST_F(parallel_test, elementwise) {
+  matrix<float> a = make_matrix<float>(300, 200, 9);
+  matrix<float> b = make_matrix<float>(300, 200, 10);
+
+  matrix<float> sum = a + b;
+  matrix<float> diff = a - b;
+  matrix<float> scaled = a * 2.0f;
+  for (size_t i = 0; i < a.rows(); ++i) {
+    for (size_t j = 0; j < a.cols(); ++j) {
+      EXPECT_EQ(a(i, j) + b(i, j), sum(i, j));
+      EXPECT_EQ(a(i, j) - b(i, j), diff(i, j));
+      EXPECT_EQ(a(i, j) * 2.0f, scaled(i, j));
+    }
+  }
+
+  a += b;
+  expect_equal(sum, a);
+}
@@ -0,0 +1,180 @@
+#include "sparse-matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace {
+
+// Roughly one element in seven is nonzero.
+template <class T>
+matrix<T> make_sparse_dense(size_t rows, size_t cols, size_t seed = 0) {
+  matrix<T> m(rows, cols);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      if ((i * 31 + j * 17 + seed) % 7 == 0) {
+        m(i, j) = static_cast<T>((i + 2 * j + seed) % 9 + 1);
+      }
+    }
+  }
+  return m;
+}
+
+template <class T>
+matrix<T> make_dense(size_t rows, size_t cols) {
+  matrix<T> m(rows, cols);
+  fill(m);
+  return m;
+}
+
+template <class Sparse>
+void check_storage(const Sparse& s, const matrix<typename Sparse::value_type>& dense) {
+  EXPECT_EQ(dense.rows(), s.rows());
+  EXPECT_EQ(dense.cols(), s.cols());
+  size_t nonzeros = 0;
+  for (size_t i = 0; i < dense.rows(); ++i) {
+    for (size_t j = 0; j < dense.cols(); ++j) {
+      nonzeros += dense(i, j) != 0;
+      EXPECT_EQ(dense(i, j), s(i, j)) << "  where i = " << i << ", j = " << j;
+    }
+  }
+  EXPECT_EQ(nonzeros, s.nonzeros());
+  for (size_t outer = 0; outer < s.outer_size(); ++outer) {
+    for (size_t k = s.offsets()[outer] + 1; k < s.offsets()[outer + 1]; ++k) {
+      EXPECT_LT(s.indices()[k - 1], s.indices()[k]);
+    }
+  }
+  expect_equal(dense, s.to_dense());
+}
+
+using sparse_test = settings_test;
+
+} // namespace
+
+TEST_F(sparse_test, from_dense) {
+  matrix<int> dense = make_sparse_dense<int>(13, 29);
+  check_storage(csr_matrix<int>(dense), dense);
+  check_storage(csc_matrix<int>(dense), dense);
+  check_storage(csr_matrix<int>(dense.block(2, 3, 5, 7)), matrix<int>(dense.block(2, 3, 5, 7)));
+}
+
+TEST_F(sparse_test, zeros) {
+  csr_matrix<int> s(4, 6);
+  EXPECT_EQ(0, s.nonzeros());
+  check_storage(s, matrix<int>(4, 6));
+
+  csc_matrix<int> empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(0, empty.to_dense().size());
+}
+
+TEST_F(sparse_test, from_entries) {
+  sparse_entry<int> entries[] = {
+      {2, 1, 5}, {0, 3, 1}, {2, 0, 4}, {0, 3, 2}, {1, 2, -3}, {2, 1, 1},
+  };
+  matrix<int> expected({
+      {0, 0, 0, 3},
+      {0, 0, -3, 0},
+      {4, 6, 0, 0},
+  });
+  check_storage(csr_matrix<int>(3, 4, entries), expected);
+  check_storage(csc_matrix<int>(3, 4, entries), expected);
+}
+
+TEST_F(sparse_test, from_entries_out_of_range) {
+  sparse_entry<int> bad_row[] = {{0, 0, 1}, {3, 1, 2}};
+  sparse_entry<int> bad_col[] = {{2, 4, 1}};
+  EXPECT_THROW((csr_matrix<int>(3, 4, bad_row)), std::out_of_range);
+  EXPECT_THROW((csc_matrix<int>(3, 4, bad_row)), std::out_of_range);
+  EXPECT_THROW((csr_matrix<int>(3, 4, bad_col)), std::out_of_range);
+  EXPECT_THROW((csc_matrix<int>(3, 4, bad_col)), std::out_of_range);
+  EXPECT_THROW((csr_matrix<int>(0, 4, bad_col)), std::out_of_range);
+}
+
+TEST_F(sparse_test, convert_layout) {
+  matrix<int> dense = make_sparse_dense<int>(17, 11, 3);
+  csr_matrix<int> csr(dense);
+  csc_matrix<int> csc(csr);
+  check_storage(csc, dense);
+  check_storage(csr_matrix<int>(csc), dense);
+}
+
+TEST_F(sparse_test, copy_and_move) {
+  matrix<int> dense = make_sparse_dense<int>(9, 9);
+  csr_matrix<int> a(dense);
+  csr_matrix<int> b = a;
+  check_storage(b, dense);
+  csr_matrix<int> c = std::move(a);
+  check_storage(c, dense);
+  EXPECT_TRUE(a.empty());
+  a = c;
+  check_storage(a, dense);
+}
+
+TEST_F(sparse_test, matrix_vector) {
+  matrix<double> dense = make_sparse_dense<double>(40, 25);
+  double x[25];
+  for (size_t j = 0; j < 25; ++j) {
+    x[j] = double(j % 4) - 1.5;
+  }
+  double expected[40];
+  for (size_t i = 0; i < 40; ++i) {
+    expected[i] = 0;
+    for (size_t j = 0; j < 25; ++j) {
+      expected[i] += dense(i, j) * x[j];
+    }
+  }
+
+  double y[40];
+  multiply(csr_matrix<double>(dense), x, y);
+  for (size_t i = 0; i < 40; ++i) {
+    EXPECT_DOUBLE_EQ(expected[i], y[i]);
+  }
+  multiply(csc_matrix<double>(dense), x, y);
+  for (size_t i = 0; i < 40; ++i) {
+    EXPECT_DOUBLE_EQ(expected[i], y[i]);
+  }
+}
+
+TEST_F(sparse_test, matrix_vector_mismatched_sizes) {
+  matrix<double> dense = make_sparse_dense<double>(4, 3);
+  double x3[3] = {};
+  double x4[4] = {};
+  double y3[3];
+  double y4[4];
+  EXPECT_THROW(multiply(csr_matrix<double>(dense), x4, y4), std::invalid_argument);
+  EXPECT_THROW(multiply(csr_matrix<double>(dense), x3, y3), std::invalid_argument);
+  EXPECT_THROW(multiply(csc_matrix<double>(dense), x4, y4), std::invalid_argument);
+  EXPECT_THROW(multiply(csc_matrix<double>(dense), x3, y3), std::invalid_argument);
+}
+
+TEST_F(sparse_test, sparse_dense_products) {
+  matrix<long long> a = make_sparse_dense<long long>(23, 31);
+  matrix<long long> b = make_dense<long long>(31, 19);
+  matrix<long long> c = make_dense<long long>(19, 23);
+
+  expect_equal(a * b, csr_matrix<long long>(a) * b);
+  expect_equal(a * b, csc_matrix<long long>(a) * b);
+  expect_equal(c * a, c * csr_matrix<long long>(a));
+  expect_equal(c * a, c * csc_matrix<long long>(a));
+
+  // Views and expressions as the dense side.
+  expect_equal(a * (b + b), csr_matrix<long long>(a) * (b + b));
+  expect_equal(c.block(1, 0, 5, 23) * a, c.block(1, 0, 5, 23) * csc_matrix<long long>(a));
+  matrix<long long> d = make_dense<long long>(23, 19);
+  expect_equal(d.transpose() * a, d.transpose() * csr_matrix<long long>(a));
+}
+
+TEST_F(sparse_test, parallel_products) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+
+  matrix<double> a = make_sparse_dense<double>(150, 120);
+  matrix<double> b = make_dense<double>(120, 70);
+  matrix<double> c = make_dense<double>(90, 150);
+  expect_equal(a * b, csr_matrix<double>(a) * b);
+  expect_equal(c * a, c * csr_matrix<double>(a));
+  expect_equal(c * a, c * csc_matrix<double>(a));
+}
@@ -0,0 +1,118 @@
+#include "static-matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <type_traits>
+
+namespace {
+
+constexpr static_matrix<int, 2, 3> a({
+    {1, 2, 3},
+    {4, 5, 6},
+});
+
+constexpr static_matrix<int, 3, 2> b({
+    {1, 0},
+    {0, 1},
+    {1, 1},
+});
+
+template <class T, size_t Rows, size_t Cols>
+static_matrix<T, Rows, Cols> make_static() {
+  static_matrix<T, Rows, Cols> m;
+  for (size_t i = 0; i < Rows; ++i) {
+    for (size_t j = 0; j < Cols; ++j) {
+      m(i, j) = elem(i, j);
+    }
+  }
+  return m;
+}
+
+template <class A, class B>
+concept multipliable = requires(const A& a, const B& b) { a * b; };
+
+} // namespace
+
+TEST(static_matrix, constexpr_construction) {
+  static_assert(a.rows() == 2 && a.cols() == 3 && a.size() == 6);
+  static_assert(a(1, 2) == 6);
+
+  constexpr static_matrix<int, 2, 2> zero;
+  static_assert(zero(0, 0) == 0 && zero(1, 1) == 0);
+}
+
+TEST(static_matrix, constexpr_arithmetic) {
+  constexpr auto sum = a + a;
+  static_assert(sum(1, 1) == 10);
+  static_assert(a - a == static_matrix<int, 2, 3>());
+  static_assert((a * 3)(0, 2) == 9);
+  static_assert((3 * a)(0, 2) == 9);
+
+  constexpr static_matrix<int, 2, 2> product = a * b;
+  static_assert(product == static_matrix<int, 2, 2>({{4, 5}, {10, 11}}));
+}
+
+TEST(static_matrix, dimensions_checked_at_compile_time) {
+  static_assert(multipliable<static_matrix<int, 2, 3>, static_matrix<int, 3, 4>>);
+  static_assert(!multipliable<static_matrix<int, 2, 3>, static_matrix<int, 2, 3>>);
+  static_assert(std::is_same_v<decltype(a * b), static_matrix<int, 2, 2>>);
+}
+
+TEST(static_matrix, no_allocations) {
+  element::reset_allocations();
+  auto x = make_static<element, 4, 4>();
+  auto y = make_static<element, 4, 4>();
+  auto z = x * y + x - y * element(2);
+  z *= x;
+  EXPECT_EQ(0, element::allocations);
+}
+
+TEST(static_matrix, matches_dynamic) {
+  auto x = make_static<double, 4, 3>();
+  auto y = make_static<double, 3, 5>();
+  matrix<double> dx(x.view());
+  matrix<double> dy(y.view());
+
+  expect_equal(dx * dy, matrix<double>((x * y).view()));
+  expect_equal(dx + dx * 2.0, matrix<double>((x + x * 2.0).view()));
+
+  auto s = make_static<double, 4, 4>();
+  auto t = s;
+  t *= s;
+  expect_equal(matrix<double>(s.view()) * matrix<double>(s.view()), matrix<double>(t.view()));
+}
+
+TEST(static_matrix, interop) {
+  auto x = make_static<int, 3, 3>();
+  matrix<int> d(3, 3);
+  fill(d);
+
+  // Static matrices take part in dynamic operations through their view.
+  expect_equal(d + d, d + x.view());
+  expect_equal(d * d, x.view() * d);
+
+  d += x.view();
+  static_matrix<int, 3, 3> back(d);
+  EXPECT_TRUE(back == x + x);
+
+  static_matrix<int, 2, 2> corner(d.block(1, 1, 2, 2));
+  EXPECT_EQ(d(2, 2), corner(1, 1));
+}
+
+TEST(static_matrix, iterators) {
+  auto x = make_static<int, 3, 4>();
+  size_t i = 0;
+  for (auto it = x.col_begin(2); it != x.col_end(2); ++it, ++i) {
+    EXPECT_EQ(elem(i, 2), *it);
+  }
+  EXPECT_EQ(3, i);
+
+  size_t j = 0;
+  for (auto it = x.row_begin(1); it != x.row_end(1); ++it, ++j) {
+    EXPECT_EQ(elem(1, j), *it);
+  }
+  EXPECT_EQ(4, j);
+  EXPECT_EQ(12, x.end() - x.begin());
+}
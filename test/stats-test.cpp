@@ -0,0 +1,142 @@
+#include "matrix.h"
+#include "mixed-precision.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+class stats_test : public settings_test {
+protected:
+  void SetUp() override {
+    settings_test::SetUp();
+    if (!matrix_stats::enabled) {
+      GTEST_SKIP() << "built without MATRIX_ENABLE_STATS";
+    }
+    matrix_stats::reset();
+  }
+};
+
+using op = matrix_stats::op;
+
+} // namespace
+
+TEST(stats, disabled_counters_stay_zero) {
+  if (matrix_stats::enabled) {
+    GTEST_SKIP() << "built with MATRIX_ENABLE_STATS";
+  }
+  matrix<int> a(40, 40);
+  matrix<int> b = a * a;
+  EXPECT_EQ(0, matrix_stats::get(op::multiply).calls);
+  std::ostringstream out;
+  matrix_stats::report(out);
+  EXPECT_EQ("", out.str());
+}
+
+TEST_F(stats_test, construct_copy_move) {
+  matrix<int> a(40, 50);
+  EXPECT_EQ(1, matrix_stats::get(op::construct).calls);
+  EXPECT_EQ(1, matrix_stats::get(op::construct).allocations);
+  EXPECT_EQ(40 * 50 * sizeof(int), matrix_stats::get(op::construct).bytes_allocated);
+
+  matrix<int> b = a;
+  EXPECT_EQ(1, matrix_stats::get(op::copy).calls);
+  EXPECT_EQ(1, matrix_stats::get(op::copy).allocations);
+  EXPECT_EQ(40 * 50 * sizeof(int), matrix_stats::get(op::copy).bytes_copied);
+
+  b = a;
+  EXPECT_EQ(2, matrix_stats::get(op::copy).calls);
+  EXPECT_EQ(1, matrix_stats::get(op::copy).allocations);
+  EXPECT_EQ(2 * 40 * 50 * sizeof(int), matrix_stats::get(op::copy).bytes_copied);
+
+  matrix<int> c = std::move(b);
+  EXPECT_EQ(1, matrix_stats::get(op::move).calls);
+  EXPECT_EQ(0, matrix_stats::get(op::move).allocations);
+
+  // Small matrices live in the inline buffer and allocate nothing.
+  matrix<int> small(2, 2);
+  EXPECT_EQ(2, matrix_stats::get(op::construct).calls);
+  EXPECT_EQ(1, matrix_stats::get(op::construct).allocations);
+}
+
+TEST_F(stats_test, arithmetic_flops) {
+  matrix<double> a(30, 20);
+  matrix<double> b(20, 10);
+  matrix_stats::reset();
+
+  matrix<double> c = a * b;
+  matrix_stats::op_stats product = matrix_stats::get(op::multiply);
+  EXPECT_EQ(1, product.calls);
+  EXPECT_EQ(2 * 30 * 20 * 10, product.flops);
+  EXPECT_EQ(1, product.allocations);
+
+  c *= 2.0;
+  EXPECT_EQ(30 * 10, matrix_stats::get(op::scale).flops);
+  c += c;
+  c -= c * 3.0;
+  EXPECT_EQ(30 * 10, matrix_stats::get(op::add_assign).flops);
+  EXPECT_EQ(2 * 30 * 10, matrix_stats::get(op::sub_assign).flops);
+
+  // One pass, one allocation, three operations per element.
+  matrix<double> d = a + a * 2.0 - a;
+  matrix_stats::op_stats evaluate = matrix_stats::get(op::evaluate);
+  EXPECT_EQ(1, evaluate.calls);
+  EXPECT_EQ(1, evaluate.allocations);
+  EXPECT_EQ(3 * 30 * 20, evaluate.flops);
+
+  EXPECT_TRUE(d == d);
+  EXPECT_EQ(1, matrix_stats::get(op::compare).calls);
+}
+
+TEST_F(stats_test, temporaries_are_visible) {
+  matrix<long long> a(64, 64);
+  matrix_stats::reset();
+  a *= a;
+  // The product allocates its result and packed panels; the result is then
+  // moved in.
+  EXPECT_EQ(3, matrix_stats::get(op::multiply).allocations);
+  EXPECT_EQ(1, matrix_stats::get(op::move).calls);
+}
+
+TEST_F(stats_test, scratch_buffers) {
+  // Packed panels of both operands, besides the result.
+  matrix<long long> a(64, 64);
+  matrix_stats::reset();
+  matrix<long long> b = a * a;
+  EXPECT_EQ(3, matrix_stats::get(op::multiply).allocations);
+
+  // The Strassen workspace for both levels; the leaves are too small to pack.
+  matrix_strassen::set_cutoff(16);
+  matrix_stats::reset();
+  b = a * a;
+  EXPECT_EQ(2, matrix_stats::get(op::multiply).allocations);
+  EXPECT_EQ((64 * 64 + 2 * 32 * 32 + 2 * 16 * 16) * sizeof(long long),
+            matrix_stats::get(op::multiply).bytes_allocated);
+
+  // Both operands are converted to double.
+  matrix<float> f(8, 8);
+  matrix_stats::reset();
+  matrix<double> d = multiply<double>(f, f);
+  EXPECT_EQ(3, matrix_stats::get(op::multiply).allocations);
+  EXPECT_EQ(3 * 8 * 8 * sizeof(double), matrix_stats::get(op::multiply).bytes_allocated);
+}
+
+TEST_F(stats_test, view_copies_and_report) {
+  matrix<int> a(16, 16);
+  matrix<int> b(a.block(0, 0, 8, 8));
+  EXPECT_EQ(8 * 8 * sizeof(int), matrix_stats::get(op::evaluate).bytes_copied);
+  a.transpose_in_place();
+  EXPECT_EQ(1, matrix_stats::get(op::transpose).calls);
+
+  std::ostringstream out;
+  matrix_stats::report(out);
+  EXPECT_NE(std::string::npos, out.str().find("transpose: calls=1 "));
+  EXPECT_EQ(std::string::npos, out.str().find("multiply"));
+
+  matrix_stats::reset();
+  EXPECT_EQ(0, matrix_stats::get(op::evaluate).calls);
+}
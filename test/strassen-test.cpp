@@ -0,0 +1,98 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+
+namespace {
+
+class strassen_test : public settings_test {
+protected:
+  void SetUp() override {
+    settings_test::SetUp();
+    element::reset_allocations();
+  }
+};
+
+template <class T>
+matrix<T> classic_mul(const matrix<T>& a, const matrix<T>& b) {
+  size_t cutoff = matrix_strassen::cutoff();
+  matrix_strassen::set_cutoff(0);
+  matrix<T> c = a * b;
+  matrix_strassen::set_cutoff(cutoff);
+  return c;
+}
+
+} // namespace
+
+TEST_F(strassen_test, disabled_by_default) {
+  EXPECT_EQ(0, matrix_strassen::cutoff());
+  EXPECT_FALSE(matrix_detail::use_strassen<int>(4096));
+}
+
+TEST_F(strassen_test, workspace) {
+  EXPECT_EQ(0, matrix_detail::strassen_workspace(64, 64));
+  EXPECT_EQ(2 * 32 * 32, matrix_detail::strassen_workspace(64, 32));
+  EXPECT_EQ(2 * 32 * 32 + 2 * 16 * 16, matrix_detail::strassen_workspace(64, 16));
+  EXPECT_EQ(2 * 32 * 32 + 2 * 16 * 16, matrix_detail::strassen_workspace(65, 16));
+}
+
+TEST_F(strassen_test, matches_classic_product) {
+  matrix_strassen::set_cutoff(8);
+  // Powers of two, odd sizes peeled at the top and at inner levels, and
+  // sizes at and just above the cutoff.
+  for (size_t n : {1, 8, 9, 16, 31, 64, 65, 100, 127, 130}) {
+    matrix<int> a = make_matrix<int>(n, n, 1, -6, 6);
+    matrix<int> b = make_matrix<int>(n, n, 5, -6, 6);
+    expect_equal(classic_mul(a, b), a * b);
+  }
+}
+
+TEST_F(strassen_test, integer_types) {
+  matrix_strassen::set_cutoff(16);
+  matrix<long long> a = make_matrix<long long>(150, 150, 2, -6, 6);
+  matrix<long long> b = make_matrix<long long>(150, 150, 9, -6, 6);
+  expect_equal(classic_mul(a, b), a * b);
+
+  matrix<unsigned> c = make_matrix<unsigned>(97, 97, 3, -6, 6);
+  matrix<unsigned> d = make_matrix<unsigned>(97, 97, 4, -6, 6);
+  expect_equal(classic_mul(c, d), c * d);
+}
+
+TEST_F(strassen_test, compound_and_padded) {
+  matrix_strassen::set_cutoff(16);
+  matrix<int> a(70, 70, padded);
+  matrix<int> b(70, 70, padded);
+  for (size_t i = 0; i < 70; ++i) {
+    for (size_t j = 0; j < 70; ++j) {
+      a(i, j) = static_cast<int>(elem(i, j) % 17);
+      b(i, j) = static_cast<int>(elem(j, i) % 11);
+    }
+  }
+  matrix<int> expected = classic_mul(a, b);
+  a *= b;
+  expect_equal(expected, a);
+}
+
+TEST_F(strassen_test, parallel) {
+  matrix_strassen::set_cutoff(32);
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  matrix<int> a = make_matrix<int>(203, 203, 6, -6, 6);
+  matrix<int> b = make_matrix<int>(203, 203, 7, -6, 6);
+  expect_equal(classic_mul(a, b), a * b);
+}
+
+TEST_F(strassen_test, non_square_and_non_arithmetic_unaffected) {
+  matrix_strassen::set_cutoff(2);
+  matrix<int> a(40, 30);
+  matrix<int> b(30, 40);
+  fill(a);
+  fill(b);
+  expect_equal(classic_mul(a, b), a * b);
+
+  matrix<element> c(8, 8);
+  fill(c);
+  expect_equal(classic_mul(c, c), c * c);
+}
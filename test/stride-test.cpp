@@ -0,0 +1,131 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+template <class T>
+matrix<T> make_padded(size_t rows, size_t cols) {
+  matrix<T> m(rows, cols, padded);
+  fill(m);
+  return m;
+}
+
+template <class T>
+matrix<T> make_packed(size_t rows, size_t cols) {
+  matrix<T> m(rows, cols);
+  fill(m);
+  return m;
+}
+
+} // namespace
+
+TEST(stride, packed_by_default) {
+  matrix<int> m(3, 5);
+  EXPECT_EQ(5, m.stride());
+  EXPECT_TRUE(m.contiguous());
+}
+
+TEST(stride, padded_rows_are_cache_line_aligned) {
+  matrix<double> m(7, 5, padded);
+  EXPECT_EQ(8, m.stride());
+  EXPECT_FALSE(m.contiguous());
+  for (size_t i = 0; i < m.rows(); ++i) {
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(&m(i, 0)) % 64) << "  where i = " << i;
+  }
+}
+
+TEST(stride, padded_stride_avoids_4k_multiples) {
+  // 512 doubles per row would place every row 4 KiB apart.
+  matrix<double> m(4, 512, padded);
+  EXPECT_EQ(520, m.stride());
+  EXPECT_NE(0, m.stride() * sizeof(double) % 4096);
+}
+
+TEST(stride, padded_empty) {
+  matrix<int> m(0, 5, padded);
+  expect_empty(m);
+}
+
+TEST(stride, padded_iteration) {
+  matrix<int> m = make_padded<int>(4, 3);
+  for (size_t i = 0; i < m.rows(); ++i) {
+    size_t j = 0;
+    for (auto it = m.row_begin(i); it != m.row_end(i); ++it, ++j) {
+      EXPECT_EQ(elem(i, j), *it);
+    }
+    EXPECT_EQ(m.cols(), j);
+  }
+  for (size_t j = 0; j < m.cols(); ++j) {
+    size_t i = 0;
+    for (auto it = m.col_begin(j); it != m.col_end(j); ++it, ++i) {
+      EXPECT_EQ(elem(i, j), *it);
+    }
+    EXPECT_EQ(m.rows(), i);
+  }
+}
+
+TEST(stride, padded_copy_and_move) {
+  matrix<int> a = make_padded<int>(5, 6);
+  matrix<int> b = a;
+  EXPECT_EQ(a.stride(), b.stride());
+  expect_equal(a, b);
+
+  matrix<int> c = std::move(b);
+  EXPECT_EQ(a.stride(), c.stride());
+  expect_equal(a, c);
+}
+
+TEST(stride, equality_ignores_padding) {
+  matrix<int> a = make_padded<int>(5, 6);
+  matrix<int> b = make_packed<int>(5, 6);
+  EXPECT_TRUE(a == b);
+  b(4, 5) += 1;
+  EXPECT_TRUE(a != b);
+}
+
+TEST(stride, mixed_layout_arithmetic) {
+  matrix<double> a = make_padded<double>(9, 13);
+  matrix<double> b = make_packed<double>(9, 13);
+
+  matrix<double> sum = a + b * 2.0;
+  EXPECT_TRUE(sum.contiguous());
+  for (size_t i = 0; i < sum.rows(); ++i) {
+    for (size_t j = 0; j < sum.cols(); ++j) {
+      EXPECT_EQ(3.0 * elem(i, j), sum(i, j));
+    }
+  }
+
+  a += b;
+  a -= b * 3.0;
+  a *= -1.0;
+  EXPECT_FALSE(a.contiguous());
+  for (size_t i = 0; i < a.rows(); ++i) {
+    for (size_t j = 0; j < a.cols(); ++j) {
+      EXPECT_EQ(double(elem(i, j)), a(i, j));
+    }
+  }
+}
+
+TEST(stride, assignment_into_padded_keeps_stride) {
+  matrix<int> a = make_padded<int>(6, 6);
+  size_t stride = a.stride();
+  const int* data = a.data();
+
+  matrix<int> b = make_packed<int>(6, 6);
+  a = b + b;
+  EXPECT_EQ(stride, a.stride());
+  EXPECT_EQ(data, a.data());
+  expect_equal(a, b * 2);
+}
+
+TEST(stride, padded_multiply) {
+  matrix<double> a = make_padded<double>(37, 45);
+  matrix<double> b = make_padded<double>(45, 29);
+  matrix<double> expected = make_packed<double>(37, 45) * make_packed<double>(45, 29);
+  expect_equal(expected, a * b);
+}
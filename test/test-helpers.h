@@ -4,6 +4,9 @@
 
 #include <gtest/gtest.h>
 
+#include <filesystem>
+#include <string>
+
 struct element {
   void* operator new[](size_t count) {
     allocations += count / sizeof(element);
@@ -79,6 +82,58 @@ void fill(matrix<T>& a) {
   }
 }
 
+// Fills a with small integers in [low, high], in a pattern picked by seed.
+// Products of such matrices are exact in every element type.
+template <class M>
+void fill(M& a, size_t seed, int low = 0, int high = 12) {
+  size_t period = static_cast<size_t>(high - low + 1);
+  for (size_t i = 0; i < a.rows(); ++i) {
+    for (size_t j = 0; j < a.cols(); ++j) {
+      a(i, j) = static_cast<typename M::value_type>(low + static_cast<int>((i * 7 + j * 3 + seed) % period));
+    }
+  }
+}
+
+template <class T>
+matrix<T> make_matrix(size_t rows, size_t cols, size_t seed = 0, int low = 0, int high = 12) {
+  matrix<T> m(rows, cols);
+  fill(m, seed, low, high);
+  return m;
+}
+
+// Restores the global thread pool and Strassen settings changed by a test.
+class settings_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+    _threads = matrix_parallel::num_threads();
+    _threshold = matrix_parallel::threshold();
+    _cutoff = matrix_strassen::cutoff();
+  }
+
+  void TearDown() override {
+    matrix_parallel::set_num_threads(_threads);
+    matrix_parallel::set_threshold(_threshold);
+    matrix_strassen::set_cutoff(_cutoff);
+  }
+
+private:
+  size_t _threads = 1;
+  size_t _threshold = 0;
+  size_t _cutoff = 0;
+};
+
+// True if a temporary file of a save to path is still next to it.
+inline bool temp_file_left(const std::filesystem::path& path) {
+  std::string prefix = path.filename().string() + ".";
+  for (const auto& entry : std::filesystem::directory_iterator(path.parent_path())) {
+    std::string name = entry.path().filename().string();
+    if (name.starts_with(prefix) && name.ends_with(".tmp")) {
+      return true;
+    }
+  }
+  return false;
+}
+
 template <class T>
 void expect_empty(const matrix<T>& m) {
   EXPECT_EQ(0, m.rows());
@@ -89,7 +144,7 @@ void expect_empty(const matrix<T>& m) {
 }
 
 template <class T>
-void expect_equal(const matrix<T>& expected, const matrix<T>& actual) {
+void expect_equal(const matrix<T>& expected, const std::type_identity_t<matrix<T>>& actual) {
   EXPECT_EQ(expected.rows(), actual.rows());
   EXPECT_EQ(expected.cols(), actual.cols());
   EXPECT_EQ(expected.size(), actual.size());
@@ -102,3 +157,9 @@ void expect_equal(const matrix<T>& expected, const matrix<T>& actual) {
     }
   }
 }
+
+template <class E>
+  requires matrix_detail::is_expression_v<E>
+void expect_equal(const E& expected, const matrix<typename E::value_type>& actual) {
+  expect_equal(matrix<typename E::value_type>(expected), actual);
+}
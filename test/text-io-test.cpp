@@ -0,0 +1,117 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace {
+
+template <class T>
+matrix<T> make_filled(size_t rows, size_t cols) {
+  matrix<T> m(rows, cols);
+  fill(m);
+  return m;
+}
+
+template <class T>
+std::string to_text(const matrix<T>& m, text_format format = {}) {
+  std::ostringstream out;
+  write_text(out, m, format);
+  return out.str();
+}
+
+} // namespace
+
+TEST(text_io, write) {
+  matrix<int> m({{1, -2, 3}, {40, 5, 600}});
+  std::ostringstream out;
+  std::ostream& result = out << m;
+  EXPECT_EQ(&out, &result);
+  EXPECT_EQ("1 -2 3\n40 5 600\n", out.str());
+
+  EXPECT_EQ("1,-2,3\n40,5,600\n", to_text(m, text_format::csv()));
+  EXPECT_EQ("1\t-2\t3\n40\t5\t600\n", to_text(m, text_format::tsv()));
+  EXPECT_EQ("", to_text(matrix<int>()));
+}
+
+TEST(text_io, write_views_and_other_types) {
+  matrix<int> m({{1, 2, 3}, {4, 5, 6}});
+  std::ostringstream out;
+  out << m.block(0, 1, 2, 2) << m.transpose();
+  EXPECT_EQ("2 3\n5 6\n1 4\n2 5\n3 6\n", out.str());
+
+  matrix<element> e(1, 2);
+  e(0, 1) = 7;
+  std::ostringstream element_out;
+  element_out << e;
+  EXPECT_EQ("0 7\n", element_out.str());
+}
+
+TEST(text_io, floating_point_round_trips) {
+  matrix<double> m({{0.1, -1.0 / 3.0, 1e300}, {5e-324, 2.5, -0.0}});
+  std::stringstream text;
+  text << m;
+  EXPECT_EQ("0.1 -0.3333333333333333 1e+300\n5e-324 2.5 -0\n", text.str());
+
+  matrix<double> read;
+  text >> read;
+  EXPECT_FALSE(text.fail());
+  expect_equal(m, read);
+}
+
+TEST(text_io, round_trip) {
+  matrix<long long> a = make_filled<long long>(37, 23);
+  a(3, 4) = std::numeric_limits<long long>::min();
+  for (text_format format : {text_format(), text_format::csv(), text_format::tsv()}) {
+    std::istringstream in(to_text(a, format));
+    matrix<long long> b;
+    read_text(in, b, format);
+    EXPECT_FALSE(in.fail());
+    expect_equal(a, b);
+  }
+
+  matrix<float> f = make_filled<float>(4, 5);
+  f(1, 1) = 1.0f / 7.0f;
+  std::istringstream in(to_text(f));
+  matrix<float> g;
+  in >> g;
+  expect_equal(f, g);
+}
+
+TEST(text_io, consecutive_matrices) {
+  std::istringstream in("\n\n1 2\n3 4\n\n5\n6\n7\n");
+  matrix<int> a;
+  matrix<int> b;
+  in >> a >> b;
+  EXPECT_FALSE(in.fail());
+  EXPECT_TRUE(in.eof());
+  expect_equal(matrix<int>({{1, 2}, {3, 4}}), a);
+  expect_equal(matrix<int>({{5}, {6}, {7}}), b);
+
+  in >> a;
+  EXPECT_TRUE(in.fail());
+  expect_equal(matrix<int>({{1, 2}, {3, 4}}), a);
+}
+
+TEST(text_io, lenient_whitespace) {
+  std::istringstream in("1, 2 ,3\r\n+4,\t5,6");
+  matrix<int> m;
+  read_text(in, m, text_format::csv());
+  EXPECT_FALSE(in.fail());
+  expect_equal(matrix<int>({{1, 2, 3}, {4, 5, 6}}), m);
+}
+
+TEST(text_io, malformed_input) {
+  matrix<int> original({{9}});
+  for (const char* text : {"1 2\n3\n", "1 x\n", "1.5\n", "99999999999999999999\n", ""}) {
+    std::istringstream in(text);
+    matrix<int> m = original;
+    in >> m;
+    EXPECT_TRUE(in.fail()) << "  where text = " << text;
+    expect_equal(original, m);
+  }
+}
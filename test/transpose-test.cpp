@@ -0,0 +1,215 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <utility>
+
+namespace {
+
+template <class T>
+matrix<T> transposed_copy(const matrix<T>& m) {
+  matrix<T> t(m.cols(), m.rows());
+  for (size_t i = 0; i < m.rows(); ++i) {
+    for (size_t j = 0; j < m.cols(); ++j) {
+      t(j, i) = m(i, j);
+    }
+  }
+  return t;
+}
+
+template <class T>
+void check_products(size_t m, size_t k, size_t n) {
+  matrix<T> a = make_matrix<T>(m, k, 1);
+  matrix<T> b = make_matrix<T>(k, n, 2);
+  matrix<T> at = transposed_copy(a);
+  matrix<T> bt = transposed_copy(b);
+  matrix<T> expected = a * b;
+
+  expect_equal(expected, at.transpose() * b);
+  expect_equal(expected, a * bt.transpose());
+  expect_equal(expected, at.transpose() * bt.transpose());
+  expect_equal(expected, at.block(0, 0, k, m).transpose() * b.block(0, 0, k, n));
+}
+
+using transpose_test = settings_test;
+
+} // namespace
+
+TEST_F(transpose_test, view_shape_and_access) {
+  matrix<int> m = make_matrix<int>(3, 5);
+  const_matrix_view<int, col_major> t = std::as_const(m).transpose();
+  EXPECT_EQ(5, t.rows());
+  EXPECT_EQ(3, t.cols());
+  EXPECT_EQ(m.data(), t.data());
+  EXPECT_TRUE(t.contiguous());
+  for (size_t i = 0; i < t.rows(); ++i) {
+    for (size_t j = 0; j < t.cols(); ++j) {
+      EXPECT_EQ(m(j, i), t(i, j));
+    }
+  }
+
+  m.transpose()(4, 1) = -1;
+  EXPECT_EQ(-1, m(1, 4));
+
+  const_matrix_view<int> back = t.transpose();
+  EXPECT_EQ(3, back.rows());
+  EXPECT_EQ(&m(1, 4), &back(1, 4));
+}
+
+TEST_F(transpose_test, view_iteration) {
+  matrix<int> m = make_matrix<int>(4, 3);
+  auto t = m.transpose();
+
+  // Rows of the transpose are columns of m, and vice versa.
+  size_t j = 0;
+  for (auto it = t.row_begin(1); it != t.row_end(1); ++it, ++j) {
+    EXPECT_EQ(m(j, 1), *it);
+  }
+  EXPECT_EQ(4, j);
+
+  size_t i = 0;
+  for (auto it = t.col_begin(2); it != t.col_end(2); ++it, ++i) {
+    EXPECT_EQ(m(2, i), *it);
+  }
+  EXPECT_EQ(3, i);
+}
+
+TEST_F(transpose_test, transposed_block) {
+  matrix<int> m = make_matrix<int>(6, 6);
+  auto t = m.block(1, 2, 3, 4).transpose().block(1, 0, 2, 2);
+  EXPECT_EQ(2, t.rows());
+  EXPECT_EQ(2, t.cols());
+  EXPECT_EQ(m(1, 3), t(0, 0));
+  EXPECT_EQ(m(2, 3), t(0, 1));
+  EXPECT_EQ(m(1, 4), t(1, 0));
+}
+
+TEST_F(transpose_test, materialize) {
+  matrix<int> m = make_matrix<int>(7, 4);
+  expect_equal(transposed_copy(m), matrix<int>(m.transpose()));
+}
+
+TEST_F(transpose_test, elementwise_operands) {
+  matrix<int> m = make_matrix<int>(5, 5);
+  matrix<int> t = transposed_copy(m);
+  expect_equal(t + m, m.transpose() + m);
+  expect_equal(m - t * 2, m - 2 * m.transpose());
+}
+
+TEST_F(transpose_test, assign_own_transpose) {
+  matrix<int> m = make_matrix<int>(5, 5);
+  matrix<int> t = transposed_copy(m);
+  matrix<int> expected = m + t;
+
+  m += m.transpose();
+  expect_equal(expected, m);
+
+  m = make_matrix<int>(5, 5);
+  m = m.transpose();
+  expect_equal(t, m);
+
+  m = make_matrix<int>(5, 5);
+  m.block(0, 0, 5, 5) = m.transpose();
+  expect_equal(t, m);
+}
+
+TEST_F(transpose_test, gram_matrix) {
+  matrix<double> x = make_matrix<double>(50, 20);
+  matrix<double> gram = x.transpose() * x;
+  EXPECT_EQ(20, gram.rows());
+  EXPECT_EQ(20, gram.cols());
+  expect_equal(transposed_copy(x) * x, gram);
+  expect_equal(x * transposed_copy(x), x * x.transpose());
+}
+
+TEST_F(transpose_test, small_products) {
+  check_products<int>(3, 4, 5);
+  check_products<element>(3, 4, 5);
+  check_products<element>(33, 47, 29);
+}
+
+TEST_F(transpose_test, packed_products) {
+  check_products<double>(37, 45, 29);
+  check_products<float>(100, 300, 70);
+  check_products<long long>(64, 64, 64);
+}
+
+TEST_F(transpose_test, parallel_products) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  check_products<double>(70, 90, 130);
+}
+
+TEST_F(transpose_test, materialize_large) {
+  matrix<int> m = make_matrix<int>(300, 517);
+  matrix<int> t = m.transpose();
+  expect_equal(transposed_copy(m), t);
+
+  matrix<int> padded_t(517, 300, padded);
+  padded_t.block(0, 0, 517, 300) = m.transpose();
+  expect_equal(transposed_copy(m), padded_t);
+}
+
+TEST_F(transpose_test, materialize_parallel) {
+  matrix_parallel::set_num_threads(4);
+  matrix_parallel::set_threshold(1);
+  matrix<double> m = make_matrix<double>(700, 333);
+  expect_equal(transposed_copy(m), matrix<double>(m.transpose()));
+}
+
+TEST_F(transpose_test, in_place_square) {
+  for (size_t n : {0, 1, 2, 15, 16, 17, 100}) {
+    matrix<int> m = make_matrix<int>(n, n);
+    matrix<int> expected = transposed_copy(m);
+    const int* data = m.data();
+    m.transpose_in_place();
+    EXPECT_EQ(data, m.data());
+    expect_equal(expected, m);
+  }
+
+  matrix<element> e = make_matrix<element>(40, 40);
+  matrix<element> expected = transposed_copy(e);
+  element::reset_allocations();
+  e.transpose_in_place();
+  expect_allocations(0);
+  expect_equal(expected, e);
+}
+
+TEST_F(transpose_test, in_place_square_padded) {
+  matrix<double> m(37, 37, padded);
+  fill(m);
+  matrix<double> expected = transposed_copy(m);
+  size_t stride = m.stride();
+  m.transpose_in_place();
+  EXPECT_EQ(stride, m.stride());
+  expect_equal(expected, m);
+}
+
+TEST_F(transpose_test, in_place_rectangular) {
+  for (auto [rows, cols] : {std::pair<size_t, size_t>{1, 7}, {7, 1}, {2, 3}, {3, 2}, {13, 57}, {100, 64}}) {
+    matrix<int> m = make_matrix<int>(rows, cols);
+    matrix<int> expected = transposed_copy(m);
+    const int* data = m.data();
+    m.transpose_in_place();
+    EXPECT_EQ(data, m.data());
+    EXPECT_EQ(rows, m.stride());
+    expect_equal(expected, m);
+  }
+
+  matrix<element> e = make_matrix<element>(23, 9);
+  matrix<element> expected = transposed_copy(e);
+  element::reset_allocations();
+  e.transpose_in_place();
+  expect_allocations(0);
+  expect_equal(expected, e);
+}
+
+TEST_F(transpose_test, in_place_rectangular_padded) {
+  matrix<int> m(5, 9, padded);
+  fill(m);
+  matrix<int> expected = transposed_copy(m);
+  m.transpose_in_place();
+  expect_equal(expected, m);
+}
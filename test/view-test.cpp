@@ -0,0 +1,210 @@
+#include "matrix.h"
+#include "test-helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <utility>
+
+namespace {
+
+class view_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+    element::reset_allocations();
+  }
+};
+
+template <class T>
+matrix<T> make_filled(size_t rows, size_t cols) {
+  matrix<T> m(rows, cols);
+  fill(m);
+  return m;
+}
+
+// Copies a block out element by element, the way it had to be done before
+// views existed.
+template <class T>
+matrix<T> copy_block(const matrix<T>& m, size_t row, size_t col, size_t rows, size_t cols) {
+  matrix<T> b(rows, cols);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      b(i, j) = m(row + i, col + j);
+    }
+  }
+  return b;
+}
+
+} // namespace
+
+TEST_F(view_test, block_shape_and_access) {
+  matrix<element> m = make_filled<element>(5, 7);
+  element::reset_allocations();
+
+  matrix_view<element> b = m.block(1, 2, 3, 4);
+  EXPECT_EQ(3, b.rows());
+  EXPECT_EQ(4, b.cols());
+  EXPECT_EQ(12, b.size());
+  EXPECT_EQ(7, b.stride());
+  EXPECT_FALSE(b.contiguous());
+  EXPECT_EQ(&m(1, 2), b.data());
+  for (size_t i = 0; i < b.rows(); ++i) {
+    for (size_t j = 0; j < b.cols(); ++j) {
+      EXPECT_EQ(elem(i + 1, j + 2), b(i, j));
+    }
+  }
+  expect_allocations(0);
+}
+
+TEST_F(view_test, writes_go_to_matrix) {
+  matrix<int> m = make_filled<int>(4, 4);
+  m.block(1, 1, 2, 2)(1, 0) = -1;
+  m.row(0)(0, 3) = -2;
+  m.col(2)(3, 0) = -3;
+  EXPECT_EQ(-1, m(2, 1));
+  EXPECT_EQ(-2, m(0, 3));
+  EXPECT_EQ(-3, m(3, 2));
+}
+
+TEST_F(view_test, row_and_col) {
+  matrix<int> m = make_filled<int>(3, 4);
+  const_matrix_view<int> r = std::as_const(m).row(1);
+  EXPECT_EQ(1, r.rows());
+  EXPECT_EQ(4, r.cols());
+  EXPECT_TRUE(r.contiguous());
+
+  const_matrix_view<int> c = std::as_const(m).col(2);
+  EXPECT_EQ(3, c.rows());
+  EXPECT_EQ(1, c.cols());
+
+  size_t i = 0;
+  for (auto it = c.col_begin(0); it != c.col_end(0); ++it, ++i) {
+    EXPECT_EQ(elem(i, 2), *it);
+  }
+  EXPECT_EQ(3, i);
+
+  size_t j = 0;
+  for (auto it = r.row_begin(0); it != r.row_end(0); ++it, ++j) {
+    EXPECT_EQ(elem(1, j), *it);
+  }
+  EXPECT_EQ(4, j);
+}
+
+TEST_F(view_test, nested_blocks) {
+  matrix<int> m = make_filled<int>(8, 8);
+  matrix_view<int> inner = m.block(2, 2, 5, 5).block(1, 1, 2, 3);
+  const_matrix_view<int> c = inner;
+  EXPECT_EQ(&m(3, 3), c.data());
+  EXPECT_EQ(8, c.stride());
+  expect_equal(copy_block(m, 3, 3, 2, 3), matrix<int>(c));
+}
+
+TEST_F(view_test, empty_view) {
+  matrix<int> m = make_filled<int>(3, 3);
+  matrix_view<int> v = m.block(1, 1, 0, 2);
+  EXPECT_TRUE(v.empty());
+  EXPECT_EQ(nullptr, v.data());
+  expect_empty(matrix<int>(v));
+}
+
+TEST_F(view_test, arithmetic_operands) {
+  matrix<double> m = make_filled<double>(6, 6);
+  matrix<double> a = copy_block(m, 0, 0, 3, 3);
+  matrix<double> b = copy_block(m, 3, 3, 3, 3);
+
+  expect_equal(a + b, m.block(0, 0, 3, 3) + m.block(3, 3, 3, 3));
+  expect_equal(a - b * 2.0, m.block(0, 0, 3, 3) - 2.0 * m.block(3, 3, 3, 3));
+  expect_equal(a + a, a + m.block(0, 0, 3, 3));
+  expect_equal(a * b, m.block(0, 0, 3, 3) * m.block(3, 3, 3, 3));
+  expect_equal(a * b, a * m.block(3, 3, 3, 3));
+  expect_equal(a * (b + b), m.block(0, 0, 3, 3) * (b + m.block(3, 3, 3, 3)));
+}
+
+TEST_F(view_test, row_times_col) {
+  matrix<long long> m = make_filled<long long>(5, 5);
+  matrix<long long> dot = m.row(1) * m.col(3);
+  long long expected = 0;
+  for (size_t k = 0; k < 5; ++k) {
+    expected += m(1, k) * m(k, 3);
+  }
+  EXPECT_EQ(1, dot.rows());
+  EXPECT_EQ(1, dot.cols());
+  EXPECT_EQ(expected, dot(0, 0));
+}
+
+TEST_F(view_test, matrix_compound_with_view) {
+  matrix<int> m = make_filled<int>(6, 4);
+  matrix<int> a = copy_block(m, 2, 0, 3, 4);
+  matrix<int> expected = a + copy_block(m, 0, 0, 3, 4);
+
+  a += m.block(0, 0, 3, 4);
+  expect_equal(expected, a);
+  a -= m.block(0, 0, 3, 4);
+  expect_equal(copy_block(m, 2, 0, 3, 4), a);
+}
+
+TEST_F(view_test, assign_through_view) {
+  matrix<int> m(4, 6);
+  matrix<int> src = make_filled<int>(2, 3);
+  m.block(1, 2, 2, 3) = src;
+  expect_equal(src, copy_block(m, 1, 2, 2, 3));
+  EXPECT_EQ(0, m(0, 2));
+  EXPECT_EQ(0, m(1, 1));
+  EXPECT_EQ(0, m(1, 5));
+
+  m.block(1, 2, 2, 3) += src * 2;
+  expect_equal(src * 3, copy_block(m, 1, 2, 2, 3));
+
+  m.block(1, 2, 2, 3) *= 2;
+  expect_equal(src * 6, copy_block(m, 1, 2, 2, 3));
+
+  // Copy-assigning a view copies elements, it does not rebind.
+  matrix_view<int> dst = m.block(0, 0, 1, 3);
+  dst = m.block(1, 2, 1, 3);
+  EXPECT_EQ(&m(0, 0), dst.data());
+  EXPECT_EQ(src(0, 1) * 6, m(0, 1));
+}
+
+TEST_F(view_test, overlapping_blocks) {
+  matrix<int> m = make_filled<int>(5, 5);
+  matrix<int> original = m;
+
+  // The source starts one row and column after the destination, so a naive
+  // in-place pass would read already updated elements.
+  m.block(0, 0, 3, 3) += m.block(1, 1, 3, 3);
+  expect_equal(copy_block(original, 0, 0, 3, 3) + copy_block(original, 1, 1, 3, 3), copy_block(m, 0, 0, 3, 3));
+
+  m = original;
+  m.block(1, 1, 3, 3) = m.block(0, 0, 3, 3) * 2;
+  expect_equal(copy_block(original, 0, 0, 3, 3) * 2, copy_block(m, 1, 1, 3, 3));
+
+  m = original;
+  matrix<int> shifted = copy_block(original, 1, 0, 4, 5);
+  m.block(0, 0, 4, 5) = m.block(1, 0, 4, 5);
+  expect_equal(shifted, copy_block(m, 0, 0, 4, 5));
+}
+
+TEST_F(view_test, matrix_assigned_from_own_block) {
+  matrix<int> m = make_filled<int>(4, 4);
+  matrix<int> expected = copy_block(m, 2, 0, 2, 4) + copy_block(m, 2, 0, 2, 4);
+
+  // Same number of elements, so the buffer would be reused for the result.
+  matrix<int> n(8, 2);
+  n = make_filled<int>(4, 4);
+  n = n.block(2, 0, 2, 4) + n.block(2, 0, 2, 4);
+  expect_equal(expected, n);
+
+  m = m.block(2, 0, 2, 4);
+  expect_equal(copy_block(make_filled<int>(4, 4), 2, 0, 2, 4), m);
+}
+
+TEST(regions_overlap, strided) {
+  int buffer[16];
+  // Blocks of a 4 x 4 matrix.
+  EXPECT_FALSE(matrix_detail::regions_overlap(buffer, 2, 2, 4, buffer + 2, 2, 2, 4));
+  EXPECT_FALSE(matrix_detail::regions_overlap(buffer + 2, 2, 2, 4, buffer + 4, 2, 2, 4));
+  EXPECT_TRUE(matrix_detail::regions_overlap(buffer + 2, 2, 2, 4, buffer + 5, 1, 2, 4));
+  EXPECT_TRUE(matrix_detail::regions_overlap(buffer, 3, 3, 4, buffer + 5, 3, 3, 4));
+  EXPECT_FALSE(matrix_detail::regions_overlap(buffer, 2, 4, 4, buffer + 8, 2, 4, 4));
+  EXPECT_TRUE(matrix_detail::regions_overlap(buffer + 8, 2, 4, 4, buffer, 3, 4, 4));
+}